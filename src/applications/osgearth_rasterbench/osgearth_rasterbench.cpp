@@ -0,0 +1,304 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2008-2012 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <cmath>
+#include <iostream>
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <osgEarth/Registry>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarthFeatures/FeatureListSource>
+#include <osgEarthSymbology/Geometry>
+#include <osgEarthSymbology/Style>
+#include <osgEarthDrivers/agglite/AGGLiteOptions>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+using namespace osgEarth::Drivers;
+
+/**
+ * Headless benchmark for the AGG-Lite rasterizer. Builds a synthetic road
+ * network in memory and times rendering the tiles that cover it at several
+ * levels of detail, with and without the shared feature index.
+ */
+
+namespace
+{
+    // Deterministic jitter so every run rasterizes the same network.
+    double jitter( unsigned seed )
+    {
+        seed = (seed << 13) ^ seed;
+        seed = seed * (seed * seed * 15731u + 789221u) + 1376312589u;
+        return (double)(seed & 0x7fffffff) / (double)0x7fffffff - 0.5;
+    }
+
+    // A grid of streets, each a polyline with many vertices.
+    FeatureListSource* createRoadNetwork( const GeoExtent& extent, unsigned numRoads, unsigned numVertices )
+    {
+        FeatureListSource* source = new FeatureListSource( extent );
+
+        double width  = extent.width();
+        double height = extent.height();
+        double wiggle = 0.25 * osg::minimum(width, height) / (double)osg::maximum(numRoads, 1u);
+        unsigned seed = 1;
+
+        for( unsigned r = 0; r < numRoads; ++r )
+        {
+            double t = ((double)r + 0.5) / (double)numRoads;
+
+            // east-west street:
+            LineString* ew = new LineString();
+            for( unsigned v = 0; v < numVertices; ++v )
+            {
+                double s = (double)v / (double)(numVertices-1);
+                ew->push_back( osg::Vec3d(
+                    extent.xMin() + s*width,
+                    extent.yMin() + t*height + wiggle*jitter(seed++),
+                    0.0) );
+            }
+            source->insertFeature( new Feature(ew, extent.getSRS()) );
+
+            // north-south street:
+            LineString* ns = new LineString();
+            for( unsigned v = 0; v < numVertices; ++v )
+            {
+                double s = (double)v / (double)(numVertices-1);
+                ns->push_back( osg::Vec3d(
+                    extent.xMin() + t*width + wiggle*jitter(seed++),
+                    extent.yMin() + s*height,
+                    0.0) );
+            }
+            source->insertFeature( new Feature(ns, extent.getSRS()) );
+        }
+
+        return source;
+    }
+
+    // Collects up to maxTiles keys at the given LOD, centered on the extent.
+    void getTileKeys( const Profile* profile, const GeoExtent& extent, unsigned lod, unsigned maxTiles, std::vector<TileKey>& out_keys )
+    {
+        GeoExtent local = extent.transform( profile->getSRS() );
+        TileKey ll = profile->createTileKey( local.xMin(), local.yMin(), lod );
+        TileKey ur = profile->createTileKey( local.xMax(), local.yMax(), lod );
+        if ( !ll.valid() || !ur.valid() )
+            return;
+
+        unsigned xMin = osg::minimum(ll.getTileX(), ur.getTileX()), xMax = osg::maximum(ll.getTileX(), ur.getTileX());
+        unsigned yMin = osg::minimum(ll.getTileY(), ur.getTileY()), yMax = osg::maximum(ll.getTileY(), ur.getTileY());
+
+        // trim to a centered block if the level has too many tiles:
+        if ( maxTiles > 0 )
+        {
+            unsigned side = osg::maximum( 1u, (unsigned)sqrt((double)maxTiles) );
+            if ( xMax-xMin+1 > side ) { xMin = (xMin+xMax)/2 - side/2; xMax = xMin + side - 1; }
+            if ( yMax-yMin+1 > side ) { yMin = (yMin+yMax)/2 - side/2; yMax = yMin + side - 1; }
+        }
+
+        for( unsigned y = yMin; y <= yMax; ++y )
+            for( unsigned x = xMin; x <= xMax; ++x )
+                out_keys.push_back( TileKey(lod, x, y, profile) );
+    }
+
+    struct RenderTile
+    {
+        void init( TileSource* source, const TileKey& key, unsigned* rendered )
+        {
+            _source   = source;
+            _key      = key;
+            _rendered = rendered;
+        }
+
+        void execute()
+        {
+            osg::ref_ptr<osg::Image> image = _source->createImage( _key );
+            *_rendered = image.valid() ? 1 : 0;
+        }
+
+        TileSource* _source;
+        TileKey     _key;
+        unsigned*   _rendered;
+    };
+
+    // Renders every key and returns the elapsed time in seconds.
+    double renderTiles( TileSource* source, const std::vector<TileKey>& keys, TaskService* service, unsigned& out_rendered )
+    {
+        std::vector<unsigned> rendered( keys.size(), 0 );
+        out_rendered = 0;
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        if ( !service )
+        {
+            for( unsigned i = 0; i < keys.size(); ++i )
+            {
+                RenderTile tile;
+                tile.init( source, keys[i], &rendered[i] );
+                tile.execute();
+            }
+        }
+        else if ( keys.size() > 0 )
+        {
+            std::vector< osg::ref_ptr< ParallelTask<RenderTile> > > tasks( keys.size() );
+            Threading::MultiEvent semaphore( (int)keys.size() );
+
+            for( unsigned i = 0; i < keys.size(); ++i )
+            {
+                tasks[i] = new ParallelTask<RenderTile>( &semaphore );
+                tasks[i]->init( source, keys[i], &rendered[i] );
+                service->add( tasks[i].get() );
+            }
+
+            semaphore.wait();
+        }
+
+        double elapsed = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+
+        for( unsigned i = 0; i < rendered.size(); ++i )
+            out_rendered += rendered[i];
+
+        return elapsed;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help",              "Display this information");
+    arguments.getApplicationUsage()->addCommandLineOption("--roads <num>",             "Number of streets in each direction (default 200)");
+    arguments.getApplicationUsage()->addCommandLineOption("--vertices <num>",          "Number of vertices per street (default 200)");
+    arguments.getApplicationUsage()->addCommandLineOption("--extent <w s e n>",        "Geographic extent of the network (default -77.2 38.8 -76.9 39.0)");
+    arguments.getApplicationUsage()->addCommandLineOption("--min-level <num>",         "First level of detail to render (default 10)");
+    arguments.getApplicationUsage()->addCommandLineOption("--max-level <num>",         "Last level of detail to render (default 16)");
+    arguments.getApplicationUsage()->addCommandLineOption("--max-tiles <num>",         "Maximum tiles rendered per level; 0 for all (default 256)");
+    arguments.getApplicationUsage()->addCommandLineOption("--threads <num>",           "Number of rendering threads (default: number of processors)");
+    arguments.getApplicationUsage()->addCommandLineOption("--width <num>",             "Road width in pixels (default 2)");
+    arguments.getApplicationUsage()->addCommandLineOption("--mercator",                "Render in the global mercator profile instead of global geodetic");
+    arguments.getApplicationUsage()->addCommandLineOption("--no-index",                "Only time rendering without the shared feature index");
+    arguments.getApplicationUsage()->addCommandLineOption("--index-only",              "Only time rendering with the shared feature index");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        std::cout << arguments.getApplicationUsage()->getCommandLineUsage() << std::endl;
+        arguments.getApplicationUsage()->write(std::cout, arguments.getApplicationUsage()->getCommandLineOptions());
+        return 1;
+    }
+
+    unsigned numRoads    = 200;
+    unsigned numVertices = 200;
+    unsigned minLevel    = 10;
+    unsigned maxLevel    = 16;
+    unsigned maxTiles    = 256;
+    int      numThreads  = OpenThreads::GetNumberOfProcessors();
+    float    roadWidth   = 2.0f;
+    double   west = -77.2, south = 38.8, east = -76.9, north = 39.0;
+
+    arguments.read("--roads", numRoads);
+    arguments.read("--vertices", numVertices);
+    arguments.read("--extent", west, south, east, north);
+    arguments.read("--min-level", minLevel);
+    arguments.read("--max-level", maxLevel);
+    arguments.read("--max-tiles", maxTiles);
+    arguments.read("--threads", numThreads);
+    arguments.read("--width", roadWidth);
+
+    bool useMercator = arguments.read("--mercator");
+    bool runPlain    = !arguments.read("--index-only");
+    bool runIndexed  = !arguments.read("--no-index");
+
+    numRoads    = osg::maximum( numRoads, 1u );
+    numVertices = osg::maximum( numVertices, 2u );
+    numThreads  = osg::maximum( numThreads, 1 );
+
+    const Profile* profile = useMercator ?
+        Registry::instance()->getGlobalMercatorProfile() :
+        Registry::instance()->getGlobalGeodeticProfile();
+
+    GeoExtent extent( SpatialReference::create("wgs84"), west, south, east, north );
+
+    osg::ref_ptr<FeatureListSource> roads = createRoadNetwork( extent, numRoads, numVertices );
+
+    Style style;
+    LineSymbol* line = style.getOrCreateSymbol<LineSymbol>();
+    line->stroke()->color() = Color::Yellow;
+    line->stroke()->width() = roadWidth;
+
+    std::cout << "Roads:    " << 2*numRoads << " streets, " << 2*numRoads*numVertices << " vertices" << std::endl
+              << "Profile:  " << profile->toString() << std::endl
+              << "Threads:  " << numThreads << std::endl;
+
+    osg::ref_ptr<TaskService> service;
+    if ( numThreads > 1 )
+        service = new TaskService( "osgearth_rasterbench", numThreads );
+
+    for( int pass = 0; pass < 2; ++pass )
+    {
+        bool indexed = pass == 1;
+        if ( (indexed && !runIndexed) || (!indexed && !runPlain) )
+            continue;
+
+        AGGLiteOptions options;
+        options.L2CacheSize()  = 0;
+        options.featureIndex() = indexed;
+        options.styles()       = new StyleSheet();
+        options.styles()->addStyle( style );
+
+        osg::ref_ptr<TileSource> source = TileSourceFactory::create( options );
+        FeatureTileSource* featureTileSource = dynamic_cast<FeatureTileSource*>( source.get() );
+        if ( !featureTileSource )
+        {
+            std::cout << "Failed to load the agglite driver" << std::endl;
+            return -1;
+        }
+
+        featureTileSource->setFeatureSource( roads.get() );
+        featureTileSource->initialize( 0L, profile );
+
+        std::cout << std::endl << (indexed ? "With feature index:" : "Without feature index:") << std::endl;
+
+        // render one tile first so that one-time setup (such as building the
+        // index) is reported separately from the per-level timings:
+        std::vector<TileKey> warmup;
+        getTileKeys( profile, extent, minLevel, 1, warmup );
+        unsigned rendered;
+        double setupTime = renderTiles( source.get(), warmup, 0L, rendered );
+        std::cout << "    first tile:  " << setupTime << " s" << std::endl;
+
+        for( unsigned lod = minLevel; lod <= maxLevel; ++lod )
+        {
+            std::vector<TileKey> keys;
+            getTileKeys( profile, extent, lod, maxTiles, keys );
+
+            double elapsed = renderTiles( source.get(), keys, service.get(), rendered );
+
+            std::cout << "    level " << lod << ": "
+                << keys.size() << " tiles (" << rendered << " rendered) in " << elapsed << " s";
+            if ( keys.size() > 0 )
+                std::cout << ", " << 1000.0*elapsed/(double)keys.size() << " ms/tile";
+            std::cout << std::endl;
+        }
+    }
+
+    return 0;
+}
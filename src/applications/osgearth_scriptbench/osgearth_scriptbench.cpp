@@ -0,0 +1,155 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2008-2012 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <iostream>
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Timer>
+#include <osgEarth/SpatialReference>
+#include <osgEarthFeatures/Feature>
+#include <osgEarthFeatures/ScriptEngine>
+#include <osgEarthSymbology/Geometry>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+/**
+ * Times per-feature ScriptEngine::run() calls against a single batched
+ * run() over the same synthetic feature list.
+ */
+
+int main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help",              "Display this information");
+    arguments.getApplicationUsage()->addCommandLineOption("--features <num>",          "Number of synthetic features (default 10000)");
+    arguments.getApplicationUsage()->addCommandLineOption("--iterations <num>",        "Number of timed passes (default 5)");
+    arguments.getApplicationUsage()->addCommandLineOption("--language <name>",         "Script language (default javascript)");
+    arguments.getApplicationUsage()->addCommandLineOption("--code <script>",           "Script to run for each feature");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        std::cout << arguments.getApplicationUsage()->getCommandLineUsage() << std::endl;
+        arguments.getApplicationUsage()->write(std::cout, arguments.getApplicationUsage()->getCommandLineOptions());
+        return 1;
+    }
+
+    unsigned numFeatures = 10000;
+    unsigned iterations  = 5;
+    std::string language = "javascript";
+    std::string code     = "feature.attributes.height * 2 + feature.attributes.floors;";
+
+    arguments.read("--features", numFeatures);
+    arguments.read("--iterations", iterations);
+    arguments.read("--language", language);
+    arguments.read("--code", code);
+
+    osg::ref_ptr<ScriptEngine> engine = ScriptEngineFactory::create( language );
+    if ( !engine.valid() )
+    {
+        std::cout << "No script engine available for language \"" << language << "\"" << std::endl;
+        return -1;
+    }
+
+    // build a synthetic list of point features with a few attributes each:
+    const SpatialReference* srs = SpatialReference::create("wgs84");
+    FeatureList features;
+    for( unsigned i = 0; i < numFeatures; ++i )
+    {
+        PointSet* point = new PointSet();
+        point->push_back( osg::Vec3d(-180.0 + 360.0*(double)(i % 1000)/1000.0, -80.0 + 160.0*(double)(i / 1000 % 1000)/1000.0, 0.0) );
+
+        Feature* feature = new Feature( point, srs );
+        feature->set( "height", 5.0 + (double)(i % 50) );
+        feature->set( "floors", (int)(1 + i % 20) );
+        feature->set( "name",   std::string("building") );
+        features.push_back( feature );
+    }
+
+    std::cout << "Features:   " << numFeatures << std::endl
+              << "Iterations: " << iterations << std::endl
+              << "Code:       " << code << std::endl;
+
+    double singleTime = 0.0, batchTime = 0.0;
+    unsigned failures = 0, mismatches = 0;
+
+    for( unsigned n = 0; n < iterations; ++n )
+    {
+        // one run() call per feature:
+        ScriptResultVector single;
+        single.reserve( features.size() );
+
+        osg::Timer_t t0 = osg::Timer::instance()->tick();
+        for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i )
+        {
+            single.push_back( engine->run(code, i->get()) );
+        }
+        osg::Timer_t t1 = osg::Timer::instance()->tick();
+
+        // one batched run() call for the whole list:
+        ScriptResultVector batch;
+        if ( !engine->run(code, features, batch) )
+            ++failures;
+        osg::Timer_t t2 = osg::Timer::instance()->tick();
+
+        singleTime += osg::Timer::instance()->delta_s(t0, t1);
+        batchTime  += osg::Timer::instance()->delta_s(t1, t2);
+
+        // the two paths must agree:
+        if ( single.size() != batch.size() )
+        {
+            ++mismatches;
+        }
+        else
+        {
+            for( unsigned i = 0; i < single.size(); ++i )
+            {
+                if ( single[i].asString() != batch[i].asString() )
+                {
+                    ++mismatches;
+                    break;
+                }
+            }
+        }
+    }
+
+    double perFeature = (double)iterations * (double)numFeatures;
+
+    std::cout << std::endl
+              << "run() per feature: " << singleTime << " s total, "
+              << (perFeature > 0.0 ? 1.0e6 * singleTime / perFeature : 0.0) << " us/feature" << std::endl
+              << "run() batched:     " << batchTime << " s total, "
+              << (perFeature > 0.0 ? 1.0e6 * batchTime / perFeature : 0.0) << " us/feature" << std::endl;
+
+    if ( batchTime > 0.0 )
+        std::cout << "Speedup:           " << singleTime/batchTime << "x" << std::endl;
+
+    if ( failures > 0 )
+        std::cout << "Warning: " << failures << " batched pass(es) reported script errors" << std::endl;
+
+    if ( mismatches > 0 )
+    {
+        std::cout << "Error: batched results differ from per-feature results in " << mismatches << " pass(es)" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -72,3 +72,28 @@ CachePolicy::getConfig() const
     conf.addIfSet( "max_age", _maxAge );
     return conf;
 }
+
+void
+CachePolicy::store( osgDB::Options* options ) const
+{
+    if ( options )
+    {
+        options->setPluginStringData( "osgEarth::CachePolicy", getConfig().toJSON() );
+    }
+}
+
+bool
+CachePolicy::fromOptions( const osgDB::Options* options, optional<CachePolicy>& out_policy )
+{
+    if ( options )
+    {
+        std::string json = options->getPluginStringData( "osgEarth::CachePolicy" );
+        Config conf;
+        if ( !json.empty() && conf.fromJSON(json) )
+        {
+            out_policy = CachePolicy( conf );
+            return true;
+        }
+    }
+    return false;
+}
@@ -19,6 +19,7 @@
 #include <osgEarth/CompositeTileSource>
 #include <osgEarth/ImageUtils>
 #include <osgDB/FileNameUtils>
+#include <map>
 
 #define LC "[CompositeTileSource] "
 
@@ -27,7 +28,9 @@ using namespace osgEarth;
 //------------------------------------------------------------------------
 
 CompositeTileSourceOptions::CompositeTileSourceOptions( const TileSourceOptions& options ) :
-TileSourceOptions( options )
+TileSourceOptions( options ),
+_numThreads      ( 4 ),
+_stopWhenOpaque  ( false )
 {
     setDriver( "composite" );
     fromConfig( _conf );
@@ -81,6 +84,9 @@ CompositeTileSourceOptions::getConfig() const
             thisConf.add( "image", i->_tileSourceOptions->getConfig() );
     }
 
+    conf.updateIfSet( "num_threads",      _numThreads );
+    conf.updateIfSet( "stop_when_opaque", _stopWhenOpaque );
+
     return conf;
 }
 
@@ -94,6 +100,9 @@ CompositeTileSourceOptions::mergeConfig( const Config& conf )
 void 
 CompositeTileSourceOptions::fromConfig( const Config& conf )
 {
+    conf.getIfSet( "num_threads",      _numThreads );
+    conf.getIfSet( "stop_when_opaque", _stopWhenOpaque );
+
     const ConfigSet& children = conf.children("image");
     for( ConfigSet::const_iterator i = children.begin(); i != children.end(); ++i )
     {
@@ -125,6 +134,124 @@ namespace
 
         ImageLayerTileProcessor _processor;
     };
+
+    // Progress for a component fetched on the task service. It follows the
+    // tile request's progress, so that canceling the tile also stops any HTTP
+    // transfers in flight, and signals when the task is done (or discarded).
+    struct ComponentProgress : public ProgressCallback
+    {
+        ComponentProgress( ProgressCallback* parent ) : _parent(parent) { }
+
+        bool reportProgress( double current, double total, const std::string& msg )
+        {
+            return checkParent();
+        }
+
+        // called when the task is dequeued; skips it if the tile was canceled meanwhile.
+        void onStarted()
+        {
+            checkParent();
+        }
+
+        bool checkParent()
+        {
+            if ( _parent.valid() && _parent->isCanceled() )
+                cancel();
+            return isCanceled();
+        }
+
+        void onCompleted()
+        {
+            _done.set();
+        }
+
+        void waitUntilDone()
+        {
+            while( !_done.isSet() )
+                _done.wait();
+        }
+
+        osg::ref_ptr<ProgressCallback> _parent;
+        Threading::Event               _done;
+    };
+
+    // Fetches one component image for a tile.
+    struct FetchComponent : public TaskRequest
+    {
+        FetchComponent( TileSource* source, const TileKey& key, TileSource::ImageOperation* op ) :
+            _source(source), _key(key), _op(op) { }
+
+        void operator()( ProgressCallback* progress )
+        {
+            if ( progress && progress->isCanceled() )
+                return;
+            _image = _source->createImage( _key, _op.get(), progress );
+        }
+
+        osg::ref_ptr<TileSource>                 _source;
+        TileKey                                  _key;
+        osg::ref_ptr<TileSource::ImageOperation> _op;
+        osg::ref_ptr<osg::Image>                 _image;
+    };
+
+    // Tracks which pixels of a tile are already hidden under fully opaque
+    // pixels of the components above, using the same rules as ImageUtils::mix.
+    // mix() skips any image whose size differs from the bottom-most one, so
+    // each image size is tracked on its own: the tile is covered once the
+    // components of one size hide every pixel, and stopping there makes that
+    // size the mix base.
+    struct Coverage
+    {
+        struct Mask
+        {
+            Mask() : _remaining(0) { }
+            unsigned                   _remaining;
+            std::vector<unsigned char> _covered;
+        };
+
+        /** Adds the next component down; returns true once the tile is fully covered. */
+        bool add( const osg::Image* image, float opacity )
+        {
+            if ( opacity < 1.0f || ImageUtils::isCompressed(image) )
+                return false;
+
+            int s = image->s(), t = image->t();
+            if ( s <= 0 || t <= 0 )
+                return false;
+
+            // mix() ignores the alpha of anything but a 32-bit image.
+            if ( image->getPixelSizeInBits() != 32 )
+                return true;
+
+            if ( !ImageUtils::PixelReader::supports(image) )
+                return false;
+
+            Mask& mask = _masks[ std::make_pair(s, t) ];
+            if ( mask._covered.empty() )
+            {
+                mask._covered.assign( s*t, 0 );
+                mask._remaining = s*t;
+            }
+
+            ImageUtils::PixelReader read( image );
+            for( int r=0; r<t; ++r )
+            {
+                for( int c=0; c<s; ++c )
+                {
+                    unsigned char& covered = mask._covered[r*s + c];
+                    if ( !covered && read(c, r).a() >= 1.0f )
+                    {
+                        covered = 1;
+                        --mask._remaining;
+                    }
+                }
+            }
+
+            return mask._remaining == 0;
+        }
+
+        std::map< std::pair<int,int>, Mask > _masks;
+    };
 }
 
 //-----------------------------------------------------------------------
@@ -169,39 +296,40 @@ osg::Image*
 CompositeTileSource::createImage(const TileKey&        key,
                                  ProgressCallback*     progress )
 {
-    ImageMixVector images;
-    images.reserve( _options._components.size() );
+    if ( progress && progress->isCanceled() )
+        return 0L;
 
-    for(CompositeTileSourceOptions::ComponentVector::const_iterator i = _options._components.begin();
-        i != _options._components.end();
-        ++i )
+    // collect the components that can supply this tile, top-most first.
+    std::vector<unsigned> candidates;
+    candidates.reserve( _options._components.size() );
+
+    for( int c = (int)_options._components.size()-1; c >= 0; --c )
     {
-        if ( progress && progress->isCanceled() )
-            return 0L;
+        const CompositeTileSourceOptions::Component& comp = _options._components[c];
 
-        TileSource* source = i->_tileSourceInstance->get();
+        TileSource* source = comp._tileSourceInstance->get();
         if ( source )
         {
 
             //TODO:  This duplicates code in ImageLayer::isKeyValid.  Maybe should move that to TileSource::isKeyValid instead
             int minLevel = 0;
             int maxLevel = INT_MAX;
-            if (i->_imageLayerOptions->minLevel().isSet())
+            if (comp._imageLayerOptions->minLevel().isSet())
             {
-                minLevel = i->_imageLayerOptions->minLevel().value();
+                minLevel = comp._imageLayerOptions->minLevel().value();
             }
-            else if (i->_imageLayerOptions->minLevelResolution().isSet())
+            else if (comp._imageLayerOptions->minLevelResolution().isSet())
             {
-                minLevel = source->getProfile()->getLevelOfDetailForHorizResolution( i->_imageLayerOptions->minLevelResolution().value(), source->getPixelsPerTile());            
+                minLevel = source->getProfile()->getLevelOfDetailForHorizResolution( comp._imageLayerOptions->minLevelResolution().value(), source->getPixelsPerTile());            
             }
 
-            if (i->_imageLayerOptions->maxLevel().isSet())
+            if (comp._imageLayerOptions->maxLevel().isSet())
             {
-                maxLevel = i->_imageLayerOptions->maxLevel().value();
+                maxLevel = comp._imageLayerOptions->maxLevel().value();
             }
-            else if (i->_imageLayerOptions->maxLevelResolution().isSet())
+            else if (comp._imageLayerOptions->maxLevelResolution().isSet())
             {
-                maxLevel = source->getProfile()->getLevelOfDetailForHorizResolution( i->_imageLayerOptions->maxLevelResolution().value(), source->getPixelsPerTile());            
+                maxLevel = source->getProfile()->getLevelOfDetailForHorizResolution( comp._imageLayerOptions->maxLevelResolution().value(), source->getPixelsPerTile());            
             }
 
             // check that this source is within the level bounds:
@@ -216,32 +344,7 @@ CompositeTileSource::createImage(const TileKey&        key,
                 //Only try to get data if the source actually has data
                 if ( source->hasData( key ) )
                 {
-                    osg::ref_ptr< ImageLayerPreCacheOperation > preCacheOp;
-                    if ( i->_imageLayerOptions.isSet() )
-                    {
-                        preCacheOp = new ImageLayerPreCacheOperation();
-                        preCacheOp->_processor.init( i->_imageLayerOptions.value(), _dbOptions.get(), true );                        
-                    }
-
-                    ImageOpacityPair imagePair(
-                        source->createImage( key, preCacheOp.get(), progress ),
-                        1.0f );
-
-                    //If the image is not valid and the progress was not cancelled, blacklist
-                    if (!imagePair.first.valid() && (!progress || !progress->isCanceled()))
-                    {
-                        //Add the tile to the blacklist
-                        OE_DEBUG << LC << "Adding tile " << key.str() << " to the blacklist" << std::endl;
-                        source->getBlacklist()->add( key.getTileId() );
-                    }
-
-                    if ( imagePair.first.valid() )
-                    {
-                        // check for opacity:
-                        imagePair.second = i->_imageLayerOptions.isSet() ? i->_imageLayerOptions->opacity().value() : 1.0f;
-
-                        images.push_back( imagePair );
-                    }
+                    candidates.push_back( c );
                 }
                 else
                 {
@@ -255,6 +358,81 @@ CompositeTileSource::createImage(const TileKey&        key,
         }
     }
 
+    if ( candidates.empty() )
+        return 0L;
+
+    // with more than one candidate, fetch them all at once on the task service.
+    // The queue runs the lowest priority value first, so upper components start
+    // first; that's what a top-down early-out waits on.
+    bool concurrent = _service.valid() && candidates.size() > 1;
+
+    std::vector< osg::ref_ptr<FetchComponent> > tasks( candidates.size() );
+    for( unsigned k=0; k<candidates.size(); ++k )
+    {
+        unsigned c = candidates[k];
+        tasks[k] = new FetchComponent( _options._components[c]._tileSourceInstance->get(), key, _preCacheOps[c].get() );
+
+        if ( concurrent )
+        {
+            tasks[k]->setProgressCallback( new ComponentProgress(progress) );
+            tasks[k]->setPriority( (float)k );
+            _service->add( tasks[k].get() );
+        }
+    }
+
+    // gather the results top-down (stopping early if the tile is covered)
+    ImageMixVector images;
+    images.reserve( tasks.size() );
+    Coverage coverage;
+    bool stopWhenOpaque = _options.stopWhenOpaque() == true;
+
+    unsigned k = 0;
+    while( k < tasks.size() )
+    {
+        FetchComponent* task = tasks[k].get();
+        if ( concurrent )
+            static_cast<ComponentProgress*>( task->getProgressCallback() )->waitUntilDone();
+        else
+            (*task)( progress );
+
+        if ( progress && progress->isCanceled() )
+            break;
+
+        const CompositeTileSourceOptions::Component& comp = _options._components[candidates[k]];
+        ++k;
+
+        // take the image, so the result is not shared with a task that may outlive this call.
+        osg::ref_ptr<osg::Image> image = task->_image.get();
+        task->_image = 0L;
+
+        //If the image is not valid and the progress was not cancelled, blacklist
+        if ( !image.valid() && !task->wasCanceled() )
+        {
+            //Add the tile to the blacklist
+            OE_DEBUG << LC << "Adding tile " << key.str() << " to the blacklist" << std::endl;
+            task->_source->getBlacklist()->add( key.getTileId() );
+        }
+
+        if ( image.valid() )
+        {
+            // check for opacity:
+            float opacity = comp._imageLayerOptions.isSet() ? comp._imageLayerOptions->opacity().value() : 1.0f;
+            images.push_back( ImageOpacityPair(image, opacity) );
+
+            if ( stopWhenOpaque && coverage.add(image.get(), opacity) )
+            {
+                OE_DEBUG << LC << "Tile " << key.str() << " is opaque after " << k << " of " << tasks.size() << " components" << std::endl;
+                break;
+            }
+        }
+    }
+
+    // anything still queued or in flight is no longer needed.
+    for( ; k < tasks.size(); ++k )
+    {
+        tasks[k]->cancel();
+    }
+
     if ( progress && progress->isCanceled() )
     {
         return 0L;
@@ -269,8 +447,9 @@ CompositeTileSource::createImage(const TileKey&        key,
     }
     else
     {
-        osg::Image* result = new osg::Image( *images[0].first.get() );
-        for( unsigned int i=1; i<images.size(); ++i )
+        // mix bottom-up.
+        osg::Image* result = new osg::Image( *images.back().first.get() );
+        for( int i=(int)images.size()-2; i>=0; --i )
         {
             ImageOpacityPair& pair = images[i];
             if ( pair.first.valid() )
@@ -303,6 +482,7 @@ CompositeTileSource::initialize(const osgDB::Options* dbOptions,
                 localOverrideProfile = Profile::create( opt.profile().value() );
 
             source->initialize( dbOptions, localOverrideProfile.get() );
+            source->dataExtentsChanged();
 
             if ( !profile.valid() )
             {
@@ -330,6 +510,27 @@ CompositeTileSource::initialize(const osgDB::Options* dbOptions,
 
     setProfile( profile.get() );
 
+    // prepare each component's image processing once, rather than per tile.
+    _preCacheOps.clear();
+    for(CompositeTileSourceOptions::ComponentVector::const_iterator i = _options._components.begin();
+        i != _options._components.end();
+        ++i)
+    {
+        osg::ref_ptr<ImageLayerPreCacheOperation> preCacheOp;
+        if ( i->_imageLayerOptions.isSet() )
+        {
+            preCacheOp = new ImageLayerPreCacheOperation();
+            preCacheOp->_processor.init( i->_imageLayerOptions.value(), _dbOptions.get(), true );
+        }
+        _preCacheOps.push_back( preCacheOp.get() );
+    }
+
+    unsigned numThreads = _options.numThreads().value();
+    if ( numThreads > 1 && _options._components.size() > 1 )
+    {
+        _service = new TaskService( "Composite fetch", osg::minimum(numThreads, (unsigned)_options._components.size()) );
+    }
+
     _initialized = true;
 }
 
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarth/DPLineSegmentIntersector>
+#include <osgEarth/TriangleBVH>
 #include <osg/KdTree>
 #include <osg/TriangleFunctor>
 
@@ -263,6 +264,56 @@ DPLineSegmentIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Drawa
 
     if (iv.getDoDummyTraversal()) return;
 
+    // use the drawable's triangle hierarchy if it has one (e.g. terrain tiles).
+    TriangleBVH* bvh = dynamic_cast<TriangleBVH*>(drawable->getShape());
+    if (bvh)
+    {
+        bool nearestOnly = (_intersectionLimit == LIMIT_ONE_PER_DRAWABLE || _intersectionLimit == LIMIT_ONE || _intersectionLimit == LIMIT_NEAREST);
+
+        TriangleBVH::Hits hits;
+        if (bvh->intersect(s, e, nearestOnly, hits))
+        {
+            for(TriangleBVH::Hits::const_iterator itr = hits.begin(); itr != hits.end(); ++itr)
+            {
+                const TriangleBVH::Hit& bvhHit = *itr;
+
+                // remap ratio into _start, _end range
+                double remap_ratio = ((s-_start).length() + bvhHit.ratio * (e-s).length() )/(_end-_start).length();
+
+                if ( _intersectionLimit == LIMIT_NEAREST && !getIntersections().empty() )
+                {
+                    if (remap_ratio >= getIntersections().begin()->ratio )
+                        continue;
+                    else
+                        getIntersections().clear();
+                }
+
+                Intersection hit;
+                hit.ratio = remap_ratio;
+                hit.matrix = iv.getModelMatrix();
+                hit.nodePath = iv.getNodePath();
+                hit.drawable = drawable;
+                hit.primitiveIndex = bvhHit.primitiveIndex;
+
+                hit.localIntersectionPoint = _start*(1.0-remap_ratio) + _end*remap_ratio;
+                hit.localIntersectionNormal = bvhHit.normal;
+
+                hit.indexList.reserve(3);
+                hit.ratioList.reserve(3);
+                hit.indexList.push_back(bvhHit.p0);
+                hit.ratioList.push_back(bvhHit.r0);
+                hit.indexList.push_back(bvhHit.p1);
+                hit.ratioList.push_back(bvhHit.r1);
+                hit.indexList.push_back(bvhHit.p2);
+                hit.ratioList.push_back(bvhHit.r2);
+
+                insertIntersection(hit);
+            }
+        }
+
+        return;
+    }
+
     osg::KdTree* kdTree = iv.getUseKdTreeWhenAvailable() ? dynamic_cast<osg::KdTree*>(drawable->getShape()) : 0;
     if (kdTree)
     {
@@ -0,0 +1,256 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2012 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/DataExtentIndex>
+#include <osgEarth/Notify>
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+
+using namespace osgEarth;
+
+#define LC "[DataExtentIndex] "
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    const unsigned MAX_LEAF_SIZE = 8;
+    const unsigned MAX_STACK     = 64;
+
+    template<typename BOX>
+    struct CenterLess
+    {
+        CenterLess( int axis ) : _axis(axis) { }
+
+        bool operator()( const BOX& a, const BOX& b ) const {
+            return _axis == 0 ?
+                a.xmin + a.xmax < b.xmin + b.xmax :
+                a.ymin + a.ymax < b.ymin + b.ymax;
+        }
+
+        int _axis;
+    };
+
+    // same (exclusive) test as GeoExtent::intersects.
+    template<typename BOX>
+    inline bool overlaps( const BOX& a, const BOX& b )
+    {
+        return !(
+            a.xmin >= b.xmax ||
+            a.xmax <= b.xmin ||
+            a.ymin >= b.ymax ||
+            a.ymax <= b.ymin );
+    }
+
+    // splits an extent into one or two boxes, as GeoExtent::intersects does.
+    template<typename BOX>
+    unsigned toBoxes( const GeoExtent& e, BOX* out )
+    {
+        if ( e.crossesAntimeridian() )
+        {
+            out[0].xmin = e.west(); out[0].xmax = 180.0;
+            out[1].xmin = -180.0;   out[1].xmax = e.east();
+            out[0].ymin = out[1].ymin = e.south();
+            out[0].ymax = out[1].ymax = e.north();
+            return 2;
+        }
+        else
+        {
+            out[0].xmin = e.west();  out[0].xmax = e.east();
+            out[0].ymin = e.south(); out[0].ymax = e.north();
+            return 1;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+DataExtentIndex::DataExtentIndex( const DataExtentList& extents ) :
+_numExtents( extents.size() )
+{
+    _boxes.reserve( extents.size() );
+    for( DataExtentList::const_iterator i = extents.begin(); i != extents.end(); ++i )
+    {
+        Box b[2];
+        unsigned n = toBoxes( *i, b );
+        for( unsigned j=0; j<n; ++j )
+        {
+            b[j].minLevel = i->getMinLevel();
+            b[j].maxLevel = i->getMaxLevel();
+            _boxes.push_back( b[j] );
+        }
+    }
+
+    if ( !_boxes.empty() )
+    {
+        _nodes.reserve( 2 * (_boxes.size() / MAX_LEAF_SIZE + 1) );
+        buildNode( 0, _boxes.size() );
+    }
+}
+
+unsigned
+DataExtentIndex::buildNode( unsigned first, unsigned count )
+{
+    unsigned nodeIndex = _nodes.size();
+    _nodes.push_back( Node() );
+
+    Box bounds;
+    bounds.xmin = bounds.ymin = DBL_MAX;
+    bounds.xmax = bounds.ymax = -DBL_MAX;
+    bounds.minLevel = UINT_MAX;
+    bounds.maxLevel = 0;
+    double cxmin = DBL_MAX, cxmax = -DBL_MAX, cymin = DBL_MAX, cymax = -DBL_MAX;
+
+    for( unsigned i=first; i<first+count; ++i )
+    {
+        const Box& b = _boxes[i];
+        bounds.xmin = std::min( bounds.xmin, b.xmin );
+        bounds.ymin = std::min( bounds.ymin, b.ymin );
+        bounds.xmax = std::max( bounds.xmax, b.xmax );
+        bounds.ymax = std::max( bounds.ymax, b.ymax );
+        bounds.minLevel = std::min( bounds.minLevel, b.minLevel );
+        bounds.maxLevel = std::max( bounds.maxLevel, b.maxLevel );
+
+        double cx = 0.5*(b.xmin + b.xmax), cy = 0.5*(b.ymin + b.ymax);
+        cxmin = std::min( cxmin, cx ); cxmax = std::max( cxmax, cx );
+        cymin = std::min( cymin, cy ); cymax = std::max( cymax, cy );
+    }
+    _nodes[nodeIndex].bounds = bounds;
+
+    // split on the longer axis of the box centers.
+    int axis = (cxmax - cxmin) >= (cymax - cymin) ? 0 : 1;
+    double extent = axis == 0 ? cxmax - cxmin : cymax - cymin;
+
+    if ( count <= MAX_LEAF_SIZE || !(extent > 0.0) )
+    {
+        _nodes[nodeIndex].offset = first;
+        _nodes[nodeIndex].count  = count;
+        return nodeIndex;
+    }
+
+    unsigned mid = first + count/2;
+    std::nth_element( _boxes.begin()+first, _boxes.begin()+mid, _boxes.begin()+first+count, CenterLess<Box>(axis) );
+
+    buildNode( first, mid-first );
+    unsigned right = buildNode( mid, first+count-mid );
+
+    _nodes[nodeIndex].offset = right;
+    _nodes[nodeIndex].count  = 0;
+    return nodeIndex;
+}
+
+bool
+DataExtentIndex::query(const Box* boxes, unsigned numBoxes, bool checkArea, bool checkLevel, unsigned lod) const
+{
+    if ( _nodes.empty() )
+        return false;
+
+    unsigned stack[MAX_STACK];
+    unsigned top = 0;
+    stack[top++] = 0;
+
+    while( top > 0 )
+    {
+        unsigned nodeIndex = stack[--top];
+        const Node& node = _nodes[nodeIndex];
+
+        if ( checkLevel && (lod < node.bounds.minLevel || lod > node.bounds.maxLevel) )
+            continue;
+
+        if ( checkArea )
+        {
+            bool hit = false;
+            for( unsigned q=0; q<numBoxes && !hit; ++q )
+                hit = overlaps( node.bounds, boxes[q] );
+            if ( !hit )
+                continue;
+        }
+
+        if ( node.count > 0 )
+        {
+            for( unsigned i=node.offset; i<node.offset+node.count; ++i )
+            {
+                const Box& b = _boxes[i];
+                if ( checkLevel && (lod < b.minLevel || lod > b.maxLevel) )
+                    continue;
+
+                if ( !checkArea )
+                    return true;
+
+                for( unsigned q=0; q<numBoxes; ++q )
+                    if ( overlaps( b, boxes[q] ) )
+                        return true;
+            }
+        }
+        else
+        {
+            // the tree is balanced, so this can't realistically happen; but if
+            // it does, err on the side of reporting data.
+            if ( top + 2 > MAX_STACK )
+            {
+                OE_WARN << LC << "Index too deep; assuming data is present" << std::endl;
+                return true;
+            }
+            stack[top++] = node.offset;
+            stack[top++] = nodeIndex + 1;
+        }
+    }
+
+    return false;
+}
+
+bool
+DataExtentIndex::intersects( const GeoExtent& extent ) const
+{
+    if ( !extent.isValid() )
+        return false;
+
+    Box boxes[2];
+    unsigned n = toBoxes( extent, boxes );
+    return query( boxes, n, true, false, 0 );
+}
+
+bool
+DataExtentIndex::intersects( const GeoExtent& extent, unsigned lod ) const
+{
+    if ( !extent.isValid() )
+        return false;
+
+    Box boxes[2];
+    unsigned n = toBoxes( extent, boxes );
+    return query( boxes, n, true, true, lod );
+}
+
+bool
+DataExtentIndex::hasLevel( unsigned lod ) const
+{
+    return query( 0L, 0, false, true, lod );
+}
+
+unsigned
+DataExtentIndex::getMinLevel() const
+{
+    return _nodes.empty() ? 0 : _nodes[0].bounds.minLevel;
+}
+
+unsigned
+DataExtentIndex::getMaxLevel() const
+{
+    return _nodes.empty() ? 0 : _nodes[0].bounds.maxLevel;
+}
@@ -118,3 +118,30 @@ ECEF::transformAndGetRotationMatrix(const osg::Vec3d&       input,
         osg::DegreesToRadians( geod_point.x() ),
         out_rotation );
 }
+
+void
+ECEF::transformAndGetRotationMatrices(const std::vector<osg::Vec3d>& input,
+                                      const SpatialReference*        inputSRS,
+                                      std::vector<osg::Vec3d>&       out_points,
+                                      std::vector<osg::Matrixd>&     out_rotations )
+{
+    std::vector<osg::Vec3d> geod_points( input );
+    if ( !inputSRS->isGeographic() )
+        inputSRS->transform( geod_points, inputSRS->getGeographicSRS() );
+
+    const osg::EllipsoidModel* em = inputSRS->getEllipsoid();
+
+    out_points.resize( geod_points.size() );
+    out_rotations.resize( geod_points.size() );
+    for( unsigned i=0; i<geod_points.size(); ++i )
+    {
+        double lat = osg::DegreesToRadians( geod_points[i].y() );
+        double lon = osg::DegreesToRadians( geod_points[i].x() );
+
+        em->convertLatLongHeightToXYZ(
+            lat, lon, geod_points[i].z(),
+            out_points[i].x(), out_points[i].y(), out_points[i].z() );
+
+        em->computeCoordinateFrame( lat, lon, out_rotations[i] );
+    }
+}
@@ -19,6 +19,7 @@
 #include <osgEarth/ElevationLayer>
 #include <osgEarth/VerticalDatum>
 #include <osgEarth/HeightFieldUtils>
+#include <osgEarth/HeightFieldCodec>
 #include <osg/Version>
 
 using namespace osgEarth;
@@ -45,19 +46,25 @@ TerrainLayerOptions( name, driverOptions )
 void
 ElevationLayerOptions::setDefaults()
 {
-    //NOP
+    _cacheFormat.init( CACHE_FORMAT_OSGB );
 }
 
 Config
 ElevationLayerOptions::getConfig( bool isolate ) const
 {
-    return TerrainLayerOptions::getConfig( isolate );
+    Config conf = TerrainLayerOptions::getConfig( isolate );
+    conf.updateIfSet( "cache_format", "osgb",          _cacheFormat, CACHE_FORMAT_OSGB );
+    conf.updateIfSet( "cache_format", "compact",       _cacheFormat, CACHE_FORMAT_COMPACT );
+    conf.updateIfSet( "cache_format", "compact_exact", _cacheFormat, CACHE_FORMAT_COMPACT_EXACT );
+    return conf;
 }
 
 void
 ElevationLayerOptions::fromConfig( const Config& conf )
 {
-    //NOP
+    conf.getIfSet( "cache_format", "osgb",          _cacheFormat, CACHE_FORMAT_OSGB );
+    conf.getIfSet( "cache_format", "compact",       _cacheFormat, CACHE_FORMAT_COMPACT );
+    conf.getIfSet( "cache_format", "compact_exact", _cacheFormat, CACHE_FORMAT_COMPACT_EXACT );
 }
 
 void
@@ -388,7 +395,13 @@ ElevationLayer::createHeightField(const TileKey&    key,
         ReadResult r = cacheBin->readObject( key.str() );
         if ( r.succeeded() )
         {
-            result = r.release<osg::HeightField>();
+            // compact-format tiles come back as encoded strings:
+            StringObject* encoded = r.get<StringObject>();
+            if ( encoded )
+                result = HeightFieldCodec::decode( encoded->getString() );
+            else
+                result = r.release<osg::HeightField>();
+
             if ( result )
                 fromCache = true;
         }
@@ -419,7 +432,18 @@ ElevationLayer::createHeightField(const TileKey&    key,
          !fromCache    &&
          _runtimeOptions.cachePolicy()->isCacheWriteable() )
     {
-        cacheBin->write( key.str(), result );
+        ElevationLayerOptions::CacheFormat format = *_runtimeOptions.cacheFormat();
+        std::string encoded;
+        if (format != ElevationLayerOptions::CACHE_FORMAT_OSGB &&
+            HeightFieldCodec::encode(result, format == ElevationLayerOptions::CACHE_FORMAT_COMPACT_EXACT, encoded) )
+        {
+            osg::ref_ptr<StringObject> obj = new StringObject( encoded );
+            cacheBin->write( key.str(), obj.get() );
+        }
+        else
+        {
+            cacheBin->write( key.str(), result );
+        }
     }
 
     if ( result )
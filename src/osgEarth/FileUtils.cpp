@@ -25,6 +25,8 @@
 #include <osg/Notify>
 #include <list>
 #include <sstream>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #ifdef WIN32
 #include <windows.h>
@@ -167,3 +169,13 @@ std::string osgEarth::getTempName(const std::string& prefix, const std::string&
     }
     return "";
 }
+
+bool osgEarth::getLastModifiedTime(const std::string& path, time_t& out_time)
+{
+    struct stat buf;
+    if ( ::stat(path.c_str(), &buf) != 0 )
+        return false;
+
+    out_time = buf.st_mtime;
+    return true;
+}
@@ -19,6 +19,8 @@
 
 #include <osgEarth/Geoid>
 #include <osgEarth/HeightFieldUtils>
+#include <algorithm>
+#include <vector>
 
 #define LC "[Geoid] "
 
@@ -26,8 +28,12 @@ using namespace osgEarth;
 
 
 Geoid::Geoid() :
-_units( Units::METERS ),
-_valid( false )
+_units    ( Units::METERS ),
+_valid    ( false ),
+_hasNoData( false ),
+_samples  ( 0L ),
+_cols     ( 0 ),
+_rows     ( 0 )
 {
     //nop
 }
@@ -43,11 +49,42 @@ void
 Geoid::setHeightField( osg::HeightField* hf )
 {
     _hf = hf;
+    _grid = 0L;
     _bounds = Bounds(
         _hf->getOrigin().x(),
         _hf->getOrigin().y(),
         _hf->getOrigin().x() + _hf->getXInterval() * double(_hf->getNumColumns()),
         _hf->getOrigin().y() + _hf->getYInterval() * double(_hf->getNumRows()) );
+
+    // the bulk kernels skip NO_DATA checks unless the grid actually has holes.
+    const osg::HeightField::HeightList& heights = _hf->getHeightList();
+    _hasNoData = std::find( heights.begin(), heights.end(), NO_DATA_VALUE ) != heights.end();
+
+    _samples = heights.empty() ? 0L : &heights[0];
+    _cols    = _hf->getNumColumns();
+    _rows    = _hf->getNumRows();
+
+    validate();
+}
+
+void
+Geoid::setGrid( GeoidGrid* grid )
+{
+    _grid = grid;
+    _hf = 0L;
+    _bounds = Bounds(
+        _grid->getOriginX(),
+        _grid->getOriginY(),
+        _grid->getOriginX() + _grid->getXInterval() * double(_grid->getNumColumns()),
+        _grid->getOriginY() + _grid->getYInterval() * double(_grid->getNumRows()) );
+
+    // the file records this, so there's no need to touch every sample.
+    _hasNoData = _grid->hasNoData();
+
+    _samples = _grid->getData();
+    _cols    = _grid->getNumColumns();
+    _rows    = _grid->getNumRows();
+
     validate();
 }
 
@@ -62,7 +99,7 @@ void
 Geoid::validate()
 {
     _valid = false;
-    if ( !_hf.valid() )
+    if ( !_samples )
     {
         //OE_WARN << LC << "ILLEGAL GEOID: no heightfield" << std::endl;
     }
@@ -76,6 +113,41 @@ Geoid::validate()
     }
 }
 
+namespace
+{
+    // Bilinear sample position along one axis of the geoid grid: the two
+    // neighboring posts, the weight of the upper one, and whether the
+    // coordinate falls inside the geoid at all.
+    struct GridAxis
+    {
+        unsigned i0, i1;
+        float    w;
+        float    inside;
+
+        void set( double coord, double minCoord, double span, unsigned numPosts )
+        {
+            inside = coord >= minCoord && coord <= minCoord+span ? 1.0f : 0.0f;
+            if ( inside == 0.0f )
+            {
+                i0 = i1 = 0;
+                w  = 0.0f;
+                return;
+            }
+            double p = (coord-minCoord)/span * double(numPosts-1);
+            i0 = osg::minimum( (unsigned)p, numPosts-1 );
+            i1 = osg::minimum( i0+1, numPosts-1 );
+            w  = i1 > i0 ? (float)(p - double(i0)) : 0.0f;
+        }
+    };
+
+    inline float bilinear( const float* row0, const float* row1, const GridAxis& x, float wy )
+    {
+        float bottom = row0[x.i0] + (row0[x.i1] - row0[x.i0]) * x.w;
+        float top    = row1[x.i0] + (row1[x.i1] - row1[x.i0]) * x.w;
+        return bottom + (top - bottom) * wy;
+    }
+}
+
 float 
 Geoid::getHeight(double lat_deg, double lon_deg, const ElevationInterpolation& interp ) const
 {
@@ -85,12 +157,107 @@ Geoid::getHeight(double lat_deg, double lon_deg, const ElevationInterpolation& i
     {
         double nlon = (lon_deg-_bounds.xMin())/_bounds.width();
         double nlat = (lat_deg-_bounds.yMin())/_bounds.height();
-        result = HeightFieldUtils::getHeightAtNormalizedLocation( _hf.get(), nlon, nlat, interp );
+
+        if ( _hf.valid() )
+        {
+            result = HeightFieldUtils::getHeightAtNormalizedLocation( _hf.get(), nlon, nlat, interp );
+        }
+        else if ( interp == INTERP_NEAREST )
+        {
+            unsigned c = osg::minimum( (unsigned)osg::round(nlon*double(_cols-1)), _cols-1 );
+            unsigned r = osg::minimum( (unsigned)osg::round(nlat*double(_rows-1)), _rows-1 );
+            result = _samples[r*_cols + c];
+        }
+        else
+        {
+            GridAxis x, y;
+            x.set( lon_deg, _bounds.xMin(), _bounds.width(),  _cols );
+            y.set( lat_deg, _bounds.yMin(), _bounds.height(), _rows );
+
+            const float* row0 = _samples + y.i0*_cols;
+            const float* row1 = _samples + y.i1*_cols;
+            if ( _hasNoData && (
+                row0[x.i0] == NO_DATA_VALUE || row0[x.i1] == NO_DATA_VALUE ||
+                row1[x.i0] == NO_DATA_VALUE || row1[x.i1] == NO_DATA_VALUE) )
+            {
+                result = NO_DATA_VALUE;
+            }
+            else
+            {
+                result = bilinear( row0, row1, x, y.w );
+            }
+        }
     }
 
     return result;
 }
 
+void
+Geoid::getHeights(const double* lat_deg,
+                  const double* lon_deg,
+                  unsigned      count,
+                  float*        out_heights ) const
+{
+    if ( !_valid || _hasNoData )
+    {
+        for( unsigned i=0; i<count; ++i )
+            out_heights[i] = getHeight( lat_deg[i], lon_deg[i] );
+        return;
+    }
+
+    GridAxis x, y;
+    for( unsigned i=0; i<count; ++i )
+    {
+        x.set( lon_deg[i], _bounds.xMin(), _bounds.width(),  _cols );
+        y.set( lat_deg[i], _bounds.yMin(), _bounds.height(), _rows );
+        out_heights[i] = bilinear( _samples + y.i0*_cols, _samples + y.i1*_cols, x, y.w ) * x.inside * y.inside;
+    }
+}
+
+void
+Geoid::getHeights(double   lonMin,
+                  double   latMin,
+                  double   lonInterval,
+                  double   latInterval,
+                  unsigned numCols,
+                  unsigned numRows,
+                  float*   out_heights ) const
+{
+    if ( !_valid || _hasNoData )
+    {
+        for( unsigned r=0; r<numRows; ++r )
+            for( unsigned c=0; c<numCols; ++c )
+                out_heights[r*numCols+c] = getHeight( latMin + latInterval*double(r), lonMin + lonInterval*double(c) );
+        return;
+    }
+
+    // the grid is separable, so the column terms are shared by every row and
+    // the inner loop is a straight bilinear blend with no branches.
+    std::vector<GridAxis> xs( numCols );
+    for( unsigned c=0; c<numCols; ++c )
+        xs[c].set( lonMin + lonInterval*double(c), _bounds.xMin(), _bounds.width(), _cols );
+
+    for( unsigned r=0; r<numRows; ++r )
+    {
+        float* out = out_heights + r*numCols;
+
+        GridAxis y;
+        y.set( latMin + latInterval*double(r), _bounds.yMin(), _bounds.height(), _rows );
+        if ( y.inside == 0.0f )
+        {
+            std::fill( out, out+numCols, 0.0f );
+            continue;
+        }
+
+        const float* row0 = _samples + y.i0*_cols;
+        const float* row1 = _samples + y.i1*_cols;
+        for( unsigned c=0; c<numCols; ++c )
+        {
+            out[c] = bilinear( row0, row1, xs[c], y.w ) * xs[c].inside;
+        }
+    }
+}
+
 bool
 Geoid::isEquivalentTo( const Geoid& rhs ) const
 {
@@ -99,5 +266,6 @@ Geoid::isEquivalentTo( const Geoid& rhs ) const
         _valid                      &&
         _name == rhs._name          &&
         _hf.get() == rhs._hf.get()  &&
+        _grid.get() == rhs._grid.get() &&
         _units == rhs._units;
 }
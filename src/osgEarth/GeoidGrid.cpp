@@ -0,0 +1,360 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2012 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/GeoidGrid>
+#include <osgEarth/GeoCommon>
+#include <osgEarth/Notify>
+#include <osgEarth/FileUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(WIN32) && !defined(__CYGWIN__)
+#  include <windows.h>
+#  define OE_GEOID_WIN32_MAPPING 1
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+using namespace osgEarth;
+
+#define LC "[GeoidGrid] "
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    // File layout (all fields in the byte order of the machine that wrote it,
+    // which the byte order mark identifies):
+    //
+    //   0  char[4]  magic "OEGD"
+    //   4  uint32   version
+    //   8  uint32   byte order mark, 0x01020304
+    //  12  uint32   number of columns
+    //  16  uint32   number of rows
+    //  20  uint32   flags
+    //  24  float64  origin x (degrees)
+    //  32  float64  origin y (degrees)
+    //  40  float64  x interval (degrees)
+    //  48  float64  y interval (degrees)
+    //  56  (reserved)
+    //  64  float32  samples[rows][cols], meters, row-major from the south
+    //
+    // The header is padded to 64 bytes so the samples stay aligned when mapped.
+
+    const char     MAGIC[4]        = { 'O', 'E', 'G', 'D' };
+    const unsigned VERSION         = 1;
+    const unsigned BYTE_ORDER_MARK = 0x01020304;
+    const unsigned HEADER_SIZE     = 64;
+    const unsigned FLAG_NO_DATA    = 1;
+
+    template<typename T> inline void put( char* buf, unsigned offset, T value ) { memcpy( buf+offset, &value, sizeof(T) ); }
+    template<typename T> inline T    get( const char* buf, unsigned offset ) { T value; memcpy( &value, buf+offset, sizeof(T) ); return value; }
+
+    template<typename T> inline void swapBytes( T& value )
+    {
+        unsigned char* b = reinterpret_cast<unsigned char*>( &value );
+        std::reverse( b, b+sizeof(T) );
+    }
+
+    template<typename T> inline T getSwapped( const char* buf, unsigned offset, bool swap )
+    {
+        T value = get<T>( buf, offset );
+        if ( swap ) swapBytes( value );
+        return value;
+    }
+
+    // Moves a file over another one in a single step.
+    bool replaceFile( const std::string& from, const std::string& to )
+    {
+#ifdef OE_GEOID_WIN32_MAPPING
+        return ::MoveFileExA( from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+        return ::rename( from.c_str(), to.c_str() ) == 0;
+#endif
+    }
+}
+
+//------------------------------------------------------------------------
+
+GeoidGrid::GeoidGrid() :
+_cols       ( 0 ),
+_rows       ( 0 ),
+_originX    ( 0.0 ),
+_originY    ( 0.0 ),
+_xInterval  ( 0.0 ),
+_yInterval  ( 0.0 ),
+_hasNoData  ( false ),
+_data       ( 0L ),
+_mapping    ( 0L ),
+_mappingSize( 0 ),
+_fileHandle ( 0L ),
+_mapHandle  ( 0L )
+{
+    //nop
+}
+
+GeoidGrid::~GeoidGrid()
+{
+#ifdef OE_GEOID_WIN32_MAPPING
+    if ( _mapping )
+        ::UnmapViewOfFile( _mapping );
+    if ( _mapHandle )
+        ::CloseHandle( (HANDLE)_mapHandle );
+    if ( _fileHandle )
+        ::CloseHandle( (HANDLE)_fileHandle );
+#else
+    if ( _mapping )
+        ::munmap( _mapping, _mappingSize );
+#endif
+}
+
+GeoidGrid*
+GeoidGrid::open( const std::string& filename )
+{
+    std::ifstream in( filename.c_str(), std::ios::in | std::ios::binary );
+    if ( !in.is_open() )
+        return 0L;
+
+    char header[HEADER_SIZE];
+    if ( !in.read(header, HEADER_SIZE) || memcmp(header, MAGIC, 4) != 0 )
+    {
+        OE_WARN << LC << "\"" << filename << "\" is not a geoid grid file" << std::endl;
+        return 0L;
+    }
+
+    unsigned bom = get<unsigned>( header, 8 );
+    bool swap = bom != BYTE_ORDER_MARK;
+    if ( swap )
+    {
+        swapBytes( bom );
+        if ( bom != BYTE_ORDER_MARK )
+        {
+            OE_WARN << LC << "\"" << filename << "\" has an unrecognized byte order" << std::endl;
+            return 0L;
+        }
+    }
+
+    if ( getSwapped<unsigned>(header, 4, swap) != VERSION )
+    {
+        OE_WARN << LC << "\"" << filename << "\" has an unsupported version" << std::endl;
+        return 0L;
+    }
+
+    osg::ref_ptr<GeoidGrid> grid = new GeoidGrid();
+    grid->_cols      = getSwapped<unsigned>( header, 12, swap );
+    grid->_rows      = getSwapped<unsigned>( header, 16, swap );
+    grid->_hasNoData = (getSwapped<unsigned>( header, 20, swap ) & FLAG_NO_DATA) != 0;
+    grid->_originX   = getSwapped<double>( header, 24, swap );
+    grid->_originY   = getSwapped<double>( header, 32, swap );
+    grid->_xInterval = getSwapped<double>( header, 40, swap );
+    grid->_yInterval = getSwapped<double>( header, 48, swap );
+
+    // make sure the file actually holds all the samples before we map it.
+    size_t numSamples = (size_t)grid->_cols * (size_t)grid->_rows;
+    in.seekg( 0, std::ios::end );
+    size_t fileSize = (size_t)in.tellg();
+    if ( numSamples == 0 || fileSize < HEADER_SIZE + numSamples*sizeof(float) )
+    {
+        OE_WARN << LC << "\"" << filename << "\" is truncated" << std::endl;
+        return 0L;
+    }
+
+    size_t mapSize = HEADER_SIZE + numSamples*sizeof(float);
+
+    if ( !swap )
+    {
+#ifdef OE_GEOID_WIN32_MAPPING
+        HANDLE file = ::CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+        if ( file != INVALID_HANDLE_VALUE )
+        {
+            HANDLE mapHandle = ::CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+            void*  view      = mapHandle ? ::MapViewOfFile( mapHandle, FILE_MAP_READ, 0, 0, mapSize ) : 0L;
+            if ( view )
+            {
+                grid->_fileHandle = file;
+                grid->_mapHandle  = mapHandle;
+                grid->_mapping    = view;
+            }
+            else
+            {
+                if ( mapHandle ) ::CloseHandle( mapHandle );
+                ::CloseHandle( file );
+            }
+        }
+#else
+        int fd = ::open( filename.c_str(), O_RDONLY );
+        if ( fd >= 0 )
+        {
+            void* view = ::mmap( 0L, mapSize, PROT_READ, MAP_SHARED, fd, 0 );
+            ::close( fd ); // the mapping keeps its own reference to the file
+            if ( view != MAP_FAILED )
+            {
+                grid->_mapping = view;
+            }
+        }
+#endif
+        if ( grid->_mapping )
+        {
+            grid->_mappingSize = mapSize;
+            grid->_data = reinterpret_cast<const float*>( static_cast<const char*>(grid->_mapping) + HEADER_SIZE );
+            OE_DEBUG << LC << "Mapped \"" << filename << "\" (" << grid->_cols << " x " << grid->_rows << ")" << std::endl;
+            return grid.release();
+        }
+    }
+
+    // no mapping available (or the byte order differs), so read it all in.
+    grid->_memory.resize( numSamples );
+    in.clear();
+    in.seekg( HEADER_SIZE, std::ios::beg );
+    if ( !in.read( reinterpret_cast<char*>(&grid->_memory[0]), numSamples*sizeof(float) ) )
+    {
+        OE_WARN << LC << "Failed to read \"" << filename << "\"" << std::endl;
+        return 0L;
+    }
+
+    if ( swap )
+    {
+        for( size_t i=0; i<numSamples; ++i )
+            swapBytes( grid->_memory[i] );
+    }
+
+    grid->_data = &grid->_memory[0];
+    OE_DEBUG << LC << "Read \"" << filename << "\" (" << grid->_cols << " x " << grid->_rows << ")" << std::endl;
+    return grid.release();
+}
+
+bool
+GeoidGrid::write( const osg::HeightField* hf, const std::string& filename )
+{
+    if ( !hf || hf->getNumColumns() == 0 || hf->getNumRows() == 0 )
+        return false;
+
+    const osg::HeightField::HeightList& heights = hf->getHeightList();
+    bool hasNoData = std::find( heights.begin(), heights.end(), NO_DATA_VALUE ) != heights.end();
+
+    char header[HEADER_SIZE];
+    memset( header, 0, HEADER_SIZE );
+    memcpy( header, MAGIC, 4 );
+    put<unsigned>( header, 4,  VERSION );
+    put<unsigned>( header, 8,  BYTE_ORDER_MARK );
+    put<unsigned>( header, 12, hf->getNumColumns() );
+    put<unsigned>( header, 16, hf->getNumRows() );
+    put<unsigned>( header, 20, hasNoData ? FLAG_NO_DATA : 0u );
+    put<double>  ( header, 24, hf->getOrigin().x() );
+    put<double>  ( header, 32, hf->getOrigin().y() );
+    put<double>  ( header, 40, hf->getXInterval() );
+    put<double>  ( header, 48, hf->getYInterval() );
+
+    // write to a temporary file next to the target and rename it into place: other
+    // processes may have the old file mapped, and must never see a partial one.
+    std::string tempName = getTempName( filename, ".tmp" );
+
+    std::ofstream out( tempName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( !out.is_open() )
+    {
+        OE_WARN << LC << "Cannot write to \"" << tempName << "\"" << std::endl;
+        return false;
+    }
+
+    out.write( header, HEADER_SIZE );
+    out.write( reinterpret_cast<const char*>(&heights[0]), heights.size()*sizeof(float) );
+    out.close();
+
+    if ( out.fail() || !replaceFile(tempName, filename) )
+    {
+        OE_WARN << LC << "Failed to write \"" << filename << "\"" << std::endl;
+        ::remove( tempName.c_str() );
+        return false;
+    }
+
+    return true;
+}
+
+osg::HeightField*
+GeoidGrid::createHeightField( const short* grid, unsigned cols, unsigned rows, float step )
+{
+    if ( !grid || cols < 2 || rows == 0 )
+        return 0L;
+
+    osg::HeightField* hf = new osg::HeightField();
+    hf->allocate( cols, rows );
+    hf->setOrigin( osg::Vec3(-180.f, -90.f, 0.f) );
+    hf->setXInterval( step );
+    hf->setYInterval( step );
+
+    // the last input column repeats 0 degrees, and the input's 180 degree
+    // column lands on -180; +180 is a copy of it.
+    const unsigned halfway = (cols-1)/2;
+    osg::HeightField::HeightList& heights = hf->getHeightList();
+    for( unsigned r=0; r<rows; ++r )
+    {
+        const short* in  = &grid[r*cols];
+        float*       out = &heights[(rows-1-r)*cols];
+        for( unsigned c=0; c<cols-1; ++c )
+        {
+            out[(c+halfway) % (cols-1)] = 0.01f * float(in[c]);
+        }
+        out[cols-1] = out[0];
+    }
+
+    return hf;
+}
+
+GeoidGrid*
+GeoidGrid::load( const std::string& name )
+{
+    std::string filename = name + ".geoid";
+    std::string path;
+
+    const char* geoidPath = ::getenv( "OSGEARTH_GEOID_PATH" );
+    if ( geoidPath && osgDB::fileExists(osgDB::concatPaths(geoidPath, filename)) )
+        path = osgDB::concatPaths( geoidPath, filename );
+    else
+        path = osgDB::findDataFile( filename );
+
+    return path.empty() ? 0L : open( path );
+}
+
+bool
+GeoidGrid::store( const osg::HeightField* hf, const std::string& name )
+{
+    const char* geoidPath = ::getenv( "OSGEARTH_GEOID_PATH" );
+    if ( !geoidPath )
+        return false;
+
+    if ( !osgDB::makeDirectory(geoidPath) )
+    {
+        OE_WARN << LC << "Cannot create folder \"" << geoidPath << "\"" << std::endl;
+        return false;
+    }
+
+    std::string path = osgDB::concatPaths( geoidPath, name + ".geoid" );
+    if ( !write(hf, path) )
+        return false;
+
+    OE_INFO << LC << "Wrote precompiled geoid grid to \"" << path << "\"" << std::endl;
+    return true;
+}
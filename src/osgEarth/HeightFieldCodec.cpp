@@ -0,0 +1,281 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2012 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/HeightFieldCodec>
+#include <osgEarth/GeoCommon>
+#include <vector>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace osgEarth;
+
+#define LC "[HeightFieldCodec] "
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    const char     MAGIC[4]        = { 'O', 'E', 'H', 'F' };
+    const unsigned char VERSION    = 1;
+    const unsigned char MODE_QUANTIZED = 0;
+    const unsigned char MODE_EXACT     = 1;
+    const unsigned NO_DATA_QUANTIZED   = 0xFFFF;
+
+    // fixed-size little-endian writers/readers, so the encoding is portable.
+    void writeU32( std::string& out, unsigned v )
+    {
+        for( unsigned i=0; i<4; ++i )
+            out.push_back( (char)((v >> (i*8)) & 0xff) );
+    }
+
+    void writeF64( std::string& out, double d )
+    {
+        unsigned char b[8];
+        memcpy( b, &d, 8 );
+        unsigned probe = 1;
+        bool little = *(unsigned char*)&probe == 1;
+        for( unsigned i=0; i<8; ++i )
+            out.push_back( (char)b[little ? i : 7-i] );
+    }
+
+    struct Reader
+    {
+        Reader( const std::string& in ) : _in(in), _pos(0), _ok(true) { }
+
+        unsigned char byte()
+        {
+            if ( _pos >= _in.size() ) { _ok = false; return 0; }
+            return (unsigned char)_in[_pos++];
+        }
+
+        unsigned u32()
+        {
+            unsigned v = 0;
+            for( unsigned i=0; i<4; ++i )
+                v |= (unsigned)byte() << (i*8);
+            return v;
+        }
+
+        double f64()
+        {
+            unsigned char b[8];
+            unsigned probe = 1;
+            bool little = *(unsigned char*)&probe == 1;
+            for( unsigned i=0; i<8; ++i )
+                b[little ? i : 7-i] = byte();
+            double d;
+            memcpy( &d, b, 8 );
+            return d;
+        }
+
+        unsigned varint()
+        {
+            unsigned v = 0;
+            for( unsigned shift=0; shift<35 && _ok; shift += 7 )
+            {
+                unsigned char b = byte();
+                v |= (unsigned)(b & 0x7f) << shift;
+                if ( (b & 0x80) == 0 )
+                    return v;
+            }
+            _ok = false;
+            return 0;
+        }
+
+        const std::string& _in;
+        unsigned           _pos;
+        bool               _ok;
+    };
+
+    void writeVarint( std::string& out, unsigned v )
+    {
+        while( v >= 0x80 )
+        {
+            out.push_back( (char)((v & 0x7f) | 0x80) );
+            v >>= 7;
+        }
+        out.push_back( (char)v );
+    }
+
+    inline unsigned zigzag( unsigned v )   { int n = (int)v; return (unsigned)((n << 1) ^ (n >> 31)); }
+    inline unsigned unzigzag( unsigned v ) { return (v >> 1) ^ (unsigned)(-(int)(v & 1)); }
+
+    // Planar predictor over the sample grid; wraps around in 32 bits so it is
+    // lossless for any input, including raw float bit patterns.
+    inline unsigned predict( const std::vector<unsigned>& v, unsigned cols, unsigned c, unsigned r )
+    {
+        if ( r == 0 )
+            return c == 0 ? 0u : v[c-1];
+        if ( c == 0 )
+            return v[(r-1)*cols];
+        return v[r*cols + c-1] + v[(r-1)*cols + c] - v[(r-1)*cols + c-1];
+    }
+}
+
+//------------------------------------------------------------------------
+
+bool
+HeightFieldCodec::encode(const osg::HeightField* hf, bool exact, std::string& out)
+{
+    if ( !hf || hf->getNumColumns() == 0 || hf->getNumRows() == 0 )
+        return false;
+
+    unsigned cols = hf->getNumColumns();
+    unsigned rows = hf->getNumRows();
+    const osg::HeightField::HeightList& heights = hf->getHeightList();
+
+    std::vector<unsigned> values( cols*rows );
+
+    double offset = 0.0, scale = 1.0;
+    if ( exact )
+    {
+        for( unsigned i=0; i<values.size(); ++i )
+            memcpy( &values[i], &heights[i], 4 );
+    }
+    else
+    {
+        float minH = FLT_MAX, maxH = -FLT_MAX;
+        for( unsigned i=0; i<heights.size(); ++i )
+        {
+            if ( heights[i] != NO_DATA_VALUE )
+            {
+                minH = osg::minimum( minH, heights[i] );
+                maxH = osg::maximum( maxH, heights[i] );
+            }
+        }
+
+        if ( minH <= maxH )
+        {
+            offset = minH;
+            if ( maxH > minH )
+                scale = ((double)maxH - (double)minH) / (double)(NO_DATA_QUANTIZED-1);
+        }
+
+        for( unsigned i=0; i<values.size(); ++i )
+        {
+            if ( heights[i] == NO_DATA_VALUE )
+            {
+                values[i] = NO_DATA_QUANTIZED;
+            }
+            else
+            {
+                double q = floor( ((double)heights[i] - offset) / scale + 0.5 );
+                values[i] = (unsigned)osg::clampBetween( q, 0.0, (double)(NO_DATA_QUANTIZED-1) );
+            }
+        }
+    }
+
+    out.clear();
+    out.reserve( 64 + values.size()*2 );
+    out.append( MAGIC, 4 );
+    out.push_back( (char)VERSION );
+    out.push_back( (char)(exact ? MODE_EXACT : MODE_QUANTIZED) );
+    writeU32( out, cols );
+    writeU32( out, rows );
+    writeF64( out, hf->getOrigin().x() );
+    writeF64( out, hf->getOrigin().y() );
+    writeF64( out, hf->getOrigin().z() );
+    writeF64( out, hf->getXInterval() );
+    writeF64( out, hf->getYInterval() );
+    if ( !exact )
+    {
+        writeF64( out, offset );
+        writeF64( out, scale );
+    }
+
+    for( unsigned r=0; r<rows; ++r )
+    {
+        for( unsigned c=0; c<cols; ++c )
+        {
+            unsigned residual = values[r*cols+c] - predict(values, cols, c, r);
+            writeVarint( out, zigzag(residual) );
+        }
+    }
+
+    return true;
+}
+
+osg::HeightField*
+HeightFieldCodec::decode(const std::string& in)
+{
+    if ( !isEncoded(in) )
+        return 0L;
+
+    Reader read( in );
+    read._pos = 4;
+    if ( read.byte() != VERSION )
+        return 0L;
+
+    bool exact = read.byte() == MODE_EXACT;
+    unsigned cols = read.u32();
+    unsigned rows = read.u32();
+    osg::Vec3d origin;
+    origin.x() = read.f64();
+    origin.y() = read.f64();
+    origin.z() = read.f64();
+    double xInterval = read.f64();
+    double yInterval = read.f64();
+    double offset = 0.0, scale = 1.0;
+    if ( !exact )
+    {
+        offset = read.f64();
+        scale  = read.f64();
+    }
+
+    // every sample takes at least one byte, which guards against bad sizes.
+    if ( !read._ok || cols == 0 || rows == 0 || (double)cols*(double)rows > (double)(in.size() - read._pos) )
+        return 0L;
+
+    std::vector<unsigned> values( cols*rows );
+    for( unsigned r=0; r<rows && read._ok; ++r )
+    {
+        for( unsigned c=0; c<cols; ++c )
+        {
+            values[r*cols+c] = predict(values, cols, c, r) + unzigzag( read.varint() );
+        }
+    }
+
+    if ( !read._ok )
+        return 0L;
+
+    osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+    hf->allocate( cols, rows );
+    hf->setOrigin( origin );
+    hf->setXInterval( xInterval );
+    hf->setYInterval( yInterval );
+
+    osg::HeightField::HeightList& heights = hf->getHeightList();
+    for( unsigned i=0; i<values.size(); ++i )
+    {
+        if ( exact )
+            memcpy( &heights[i], &values[i], 4 );
+        else if ( values[i] == NO_DATA_QUANTIZED )
+            heights[i] = NO_DATA_VALUE;
+        else
+            heights[i] = (float)(offset + scale * (double)values[i]);
+    }
+
+    return hf.release();
+}
+
+bool
+HeightFieldCodec::isEncoded(const std::string& in)
+{
+    return in.size() > 6 && memcmp( in.data(), MAGIC, 4 ) == 0;
+}
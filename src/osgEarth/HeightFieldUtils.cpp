@@ -318,7 +318,7 @@ HeightFieldUtils::createReferenceHeightField( const GeoExtent& ex, unsigned numC
 
     const VerticalDatum* vdatum = ex.isValid() ? ex.getSRS()->getVerticalDatum() : 0L;
 
-    if ( vdatum )
+    if ( vdatum && vdatum->getGeoid() )
     {
         // need the lat/long extent for geoid queries:
         GeoExtent geodeticExtent = ex.getSRS()->isGeographic() ? ex : ex.transform( ex.getSRS()->getGeographicSRS() );
@@ -327,16 +327,10 @@ HeightFieldUtils::createReferenceHeightField( const GeoExtent& ex, unsigned numC
         double lonInterval = geodeticExtent.width() / (double)(numCols-1);
         double latInterval = geodeticExtent.height() / (double)(numRows-1);
 
-        for( unsigned r=0; r<numRows; ++r )
-        {            
-            double lat = latMin + latInterval*(double)r;
-            for( unsigned c=0; c<numCols; ++c )
-            {
-                double lon = lonMin + lonInterval*(double)c;
-                double offset = vdatum->msl2hae(lat, lon, 0.0);
-                hf->setHeight( c, r, offset );
-            }
-        }
+        // the MSL-to-HAE offset of a zero height is just the geoid height.
+        vdatum->getGeoid()->getHeights(
+            lonMin, latMin, lonInterval, latInterval, numCols, numRows,
+            &hf->getHeightList()[0] );
     }
     else
     {
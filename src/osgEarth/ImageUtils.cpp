@@ -25,6 +25,9 @@
 #include <osgDB/Registry>
 #include <string.h>
 #include <memory.h>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
 
 #define LC "[ImageUtils] "
 
@@ -251,6 +254,300 @@ ImageUtils::createMipmapBlendedImage( const osg::Image* primary, const osg::Imag
     return result.release();
 }
 
+namespace
+{
+    // Computes the byte offsets of each mipmap level after the first, and returns the
+    // total size of the chain.
+    unsigned computeMipmapLayout( unsigned s, unsigned t, unsigned bytesPerLevel(unsigned, unsigned),
+                                  unsigned numLevels, osg::Image::MipmapDataType& out_offsets )
+    {
+        unsigned total = 0;
+        for( unsigned i=0; i<numLevels; ++i )
+        {
+            if ( i > 0 )
+                out_offsets.push_back( total );
+            total += bytesPerLevel( osg::maximum(s>>i, 1u), osg::maximum(t>>i, 1u) );
+        }
+        return total;
+    }
+
+    unsigned rgba8LevelSize( unsigned s, unsigned t ) { return s*t*4; }
+    unsigned dxt1LevelSize( unsigned s, unsigned t )  { return ((s+3)/4)*((t+3)/4)*8; }
+    unsigned dxt5LevelSize( unsigned s, unsigned t )  { return ((s+3)/4)*((t+3)/4)*16; }
+
+    inline unsigned short toRGB565( const unsigned char* c )
+    {
+        return ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3);
+    }
+
+    inline void fromRGB565( unsigned short v, int* out )
+    {
+        out[0] = ((v >> 11) & 0x1f) * 255 / 31;
+        out[1] = ((v >> 5)  & 0x3f) * 255 / 63;
+        out[2] = ( v        & 0x1f) * 255 / 31;
+    }
+
+    // Encodes the color part of a 4x4 block (16 RGBA pixels) as a DXT1 color block,
+    // using the inset bounding box of the block colors as the endpoints.
+    void encodeColorBlock( const unsigned char* px, unsigned char* out )
+    {
+        unsigned char lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+        for( unsigned i=0; i<16; ++i )
+        {
+            for( unsigned c=0; c<3; ++c )
+            {
+                lo[c] = osg::minimum( lo[c], px[i*4+c] );
+                hi[c] = osg::maximum( hi[c], px[i*4+c] );
+            }
+        }
+
+        for( unsigned c=0; c<3; ++c )
+        {
+            int inset = (hi[c] - lo[c]) >> 4;
+            lo[c] = (unsigned char)(lo[c] + inset);
+            hi[c] = (unsigned char)(hi[c] - inset);
+        }
+
+        // pick the box diagonal that follows the colors: flip green/blue if they
+        // run against red.
+        int mid[3] = { (lo[0]+hi[0])/2, (lo[1]+hi[1])/2, (lo[2]+hi[2])/2 };
+        int covG = 0, covB = 0;
+        for( unsigned i=0; i<16; ++i )
+        {
+            int dr = px[i*4+0] - mid[0];
+            covG += dr * (px[i*4+1] - mid[1]);
+            covB += dr * (px[i*4+2] - mid[2]);
+        }
+        if ( covG < 0 ) std::swap( lo[1], hi[1] );
+        if ( covB < 0 ) std::swap( lo[2], hi[2] );
+
+        unsigned short c0 = toRGB565( hi );
+        unsigned short c1 = toRGB565( lo );
+        if ( c0 < c1 )
+            std::swap( c0, c1 );
+
+        int palette[4][3];
+        fromRGB565( c0, palette[0] );
+        fromRGB565( c1, palette[1] );
+        for( unsigned c=0; c<3; ++c )
+        {
+            palette[2][c] = (2*palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2*palette[1][c]) / 3;
+        }
+
+        unsigned indices = 0;
+        if ( c0 != c1 )
+        {
+            for( unsigned i=0; i<16; ++i )
+            {
+                int best = 0, bestDist = INT_MAX;
+                for( int p=0; p<4; ++p )
+                {
+                    int dr = px[i*4+0] - palette[p][0];
+                    int dg = px[i*4+1] - palette[p][1];
+                    int db = px[i*4+2] - palette[p][2];
+                    int dist = dr*dr + dg*dg + db*db;
+                    if ( dist < bestDist ) { bestDist = dist; best = p; }
+                }
+                indices |= (unsigned)best << (i*2);
+            }
+        }
+
+        out[0] = c0 & 0xff; out[1] = c0 >> 8;
+        out[2] = c1 & 0xff; out[3] = c1 >> 8;
+        out[4] = indices & 0xff;         out[5] = (indices >> 8) & 0xff;
+        out[6] = (indices >> 16) & 0xff; out[7] = (indices >> 24) & 0xff;
+    }
+
+    // Encodes the alpha part of a 4x4 block as a DXT5 alpha block (8-value mode).
+    void encodeAlphaBlock( const unsigned char* px, unsigned char* out )
+    {
+        unsigned char a0 = 0, a1 = 255;
+        for( unsigned i=0; i<16; ++i )
+        {
+            a0 = osg::maximum( a0, px[i*4+3] );
+            a1 = osg::minimum( a1, px[i*4+3] );
+        }
+
+        int palette[8];
+        palette[0] = a0;
+        palette[1] = a1;
+        for( int p=1; p<7; ++p )
+            palette[p+1] = ((7-p)*a0 + p*a1) / 7;
+
+        unsigned long long indices = 0;
+        if ( a0 != a1 )
+        {
+            for( unsigned i=0; i<16; ++i )
+            {
+                int best = 0, bestDist = INT_MAX;
+                for( int p=0; p<8; ++p )
+                {
+                    int dist = abs( (int)px[i*4+3] - palette[p] );
+                    if ( dist < bestDist ) { bestDist = dist; best = p; }
+                }
+                indices |= (unsigned long long)best << (i*3);
+            }
+        }
+
+        out[0] = a0;
+        out[1] = a1;
+        for( unsigned b=0; b<6; ++b )
+            out[2+b] = (unsigned char)((indices >> (b*8)) & 0xff);
+    }
+}
+
+osg::Image*
+ImageUtils::createRGBA8(const osg::Image* input, unsigned int out_s, unsigned int out_t, bool mipmaps)
+{
+    if ( !input || out_s == 0 || out_t == 0 )
+        return 0L;
+
+    if ( !PixelReader::supports(input) )
+    {
+        OE_WARN << LC << "createRGBA8: unsupported format" << std::endl;
+        return 0L;
+    }
+
+    unsigned numLevels = mipmaps ? osg::Image::computeNumberOfMipmapLevels( out_s, out_t ) : 1;
+    osg::Image::MipmapDataType mipmapOffsets;
+    unsigned totalSizeBytes = computeMipmapLayout( out_s, out_t, rgba8LevelSize, numLevels, mipmapOffsets );
+
+    unsigned char* data = new unsigned char[totalSizeBytes];
+
+    osg::ref_ptr<osg::Image> result = new osg::Image();
+    result->setImage( out_s, out_t, 1, GL_RGB8A_INTERNAL, GL_RGBA, GL_UNSIGNED_BYTE, data, osg::Image::USE_NEW_DELETE );
+    if ( mipmapOffsets.size() > 0 )
+        result->setMipmapLevels( mipmapOffsets );
+
+    // level 0: convert and resample in one pass.
+    bool isRGBA8 =
+        input->getPixelFormat() == GL_RGBA &&
+        input->getDataType() == GL_UNSIGNED_BYTE;
+
+    PixelReader read( input );
+    unsigned in_s = input->s(), in_t = input->t();
+
+    for( unsigned row=0; row<out_t; ++row )
+    {
+        unsigned in_row = osg::minimum( (unsigned)(((float)row/(float)out_t) * (float)in_t), in_t-1 );
+        unsigned char* ptr = data + row*out_s*4;
+
+        if ( isRGBA8 && in_s == out_s )
+        {
+            memcpy( ptr, input->data(0, in_row), out_s*4 );
+            continue;
+        }
+
+        for( unsigned col=0; col<out_s; ++col, ptr += 4 )
+        {
+            unsigned in_col = osg::minimum( (unsigned)(((float)col/(float)out_s) * (float)in_s), in_s-1 );
+            if ( isRGBA8 )
+            {
+                memcpy( ptr, input->data(in_col, in_row), 4 );
+            }
+            else
+            {
+                osg::Vec4 c = read( in_col, in_row );
+                for( unsigned k=0; k<4; ++k )
+                    ptr[k] = (unsigned char)( osg::clampBetween(c[k], 0.0f, 1.0f) * 255.0f + 0.5f );
+            }
+        }
+    }
+
+    // remaining levels: 2x2 box filter of the previous level.
+    for( unsigned level=1; level<numLevels; ++level )
+    {
+        unsigned ps = osg::maximum(out_s >> (level-1), 1u), pt = osg::maximum(out_t >> (level-1), 1u);
+        unsigned ls = osg::maximum(out_s >> level, 1u),     lt = osg::maximum(out_t >> level, 1u);
+        const unsigned char* src = result->getMipmapData(level-1);
+        unsigned char*       dst = result->getMipmapData(level);
+
+        for( unsigned row=0; row<lt; ++row )
+        {
+            unsigned r0 = osg::minimum( row*2, pt-1 ), r1 = osg::minimum( row*2+1, pt-1 );
+            for( unsigned col=0; col<ls; ++col )
+            {
+                unsigned c0 = osg::minimum( col*2, ps-1 ), c1 = osg::minimum( col*2+1, ps-1 );
+                for( unsigned k=0; k<4; ++k )
+                {
+                    unsigned sum =
+                        src[(r0*ps+c0)*4+k] + src[(r0*ps+c1)*4+k] +
+                        src[(r1*ps+c0)*4+k] + src[(r1*ps+c1)*4+k];
+                    dst[(row*ls+col)*4+k] = (unsigned char)((sum + 2) >> 2);
+                }
+            }
+        }
+    }
+
+    return result.release();
+}
+
+osg::Image*
+ImageUtils::compressDXT(const osg::Image* input, bool alpha)
+{
+    if ( !input || input->getPixelFormat() != GL_RGBA || input->getDataType() != GL_UNSIGNED_BYTE )
+    {
+        OE_WARN << LC << "compressDXT: input must be RGBA8" << std::endl;
+        return 0L;
+    }
+
+    GLenum format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    unsigned blockSize = alpha ? 16 : 8;
+
+    unsigned s = input->s(), t = input->t();
+    unsigned numLevels = input->getNumMipmapLevels();
+    osg::Image::MipmapDataType mipmapOffsets;
+    unsigned totalSizeBytes = computeMipmapLayout( s, t, alpha ? dxt5LevelSize : dxt1LevelSize, numLevels, mipmapOffsets );
+
+    unsigned char* data = new unsigned char[totalSizeBytes];
+
+    osg::ref_ptr<osg::Image> result = new osg::Image();
+    result->setImage( s, t, 1, format, format, GL_UNSIGNED_BYTE, data, osg::Image::USE_NEW_DELETE );
+    if ( mipmapOffsets.size() > 0 )
+        result->setMipmapLevels( mipmapOffsets );
+
+    unsigned char block[64];
+
+    for( unsigned level=0; level<numLevels; ++level )
+    {
+        unsigned ls = osg::maximum(s >> level, 1u), lt = osg::maximum(t >> level, 1u);
+        const unsigned char* src = level == 0 ? input->data() : input->getMipmapData(level);
+        unsigned char*       dst = level == 0 ? data : data + mipmapOffsets[level-1];
+        unsigned rowBytes = level == 0 ? input->getRowSizeInBytes() : ls*4;
+
+        for( unsigned by=0; by<lt; by+=4 )
+        {
+            for( unsigned bx=0; bx<ls; bx+=4 )
+            {
+                // gather the block, replicating edge pixels for partial blocks.
+                for( unsigned y=0; y<4; ++y )
+                {
+                    unsigned row = osg::minimum( by+y, lt-1 );
+                    for( unsigned x=0; x<4; ++x )
+                    {
+                        unsigned col = osg::minimum( bx+x, ls-1 );
+                        memcpy( &block[(y*4+x)*4], src + row*rowBytes + col*4, 4 );
+                    }
+                }
+
+                if ( alpha )
+                {
+                    encodeAlphaBlock( block, dst );
+                    encodeColorBlock( block, dst+8 );
+                }
+                else
+                {
+                    encodeColorBlock( block, dst );
+                }
+                dst += blockSize;
+            }
+        }
+    }
+
+    return result.release();
+}
+
 namespace
 {
     struct MixImage
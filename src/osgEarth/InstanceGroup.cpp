@@ -0,0 +1,239 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2012 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/InstanceGroup>
+#include <osgUtil/CullVisitor>
+#include <osgUtil/IntersectionVisitor>
+#include <cfloat>
+
+using namespace osgEarth;
+
+#define LC "[InstanceGroup] "
+
+//------------------------------------------------------------------------
+
+InstanceGroup::InstanceGroup()
+{
+    //nop
+}
+
+InstanceGroup::InstanceGroup(const InstanceGroup& rhs, const osg::CopyOp& op) :
+osg::Group ( rhs, op ),
+_positions ( rhs._positions ),
+_rotations ( rhs._rotations ),
+_scales    ( rhs._scales ),
+_ranges    ( rhs._ranges )
+{
+    //nop
+}
+
+unsigned
+InstanceGroup::addInstance(const osg::Vec3d& position,
+                           const osg::Quat&  rotation,
+                           float             scale )
+{
+    _positions.push_back( position );
+    _rotations.push_back( rotation );
+    _scales.push_back( scale );
+    dirtyBound();
+    return _positions.size() - 1;
+}
+
+void
+InstanceGroup::reserveInstances( unsigned num )
+{
+    _positions.reserve( num );
+    _rotations.reserve( num );
+    _scales.reserve( num );
+}
+
+void
+InstanceGroup::removeInstances()
+{
+    _positions.clear();
+    _rotations.clear();
+    _scales.clear();
+    dirtyBound();
+}
+
+osg::Matrixd
+InstanceGroup::getInstanceMatrix( unsigned i ) const
+{
+    osg::Matrixd m;
+    m.makeRotate( _rotations[i] );
+    m.preMultScale( osg::Vec3d(_scales[i], _scales[i], _scales[i]) );
+    m.postMultTranslate( _positions[i] );
+    return m;
+}
+
+bool
+InstanceGroup::addChild( osg::Node* child, float minRange, float maxRange )
+{
+    if ( !osg::Group::addChild(child) )
+        return false;
+    setRange( getNumChildren()-1, minRange, maxRange );
+    return true;
+}
+
+void
+InstanceGroup::setRange( unsigned childIndex, float minRange, float maxRange )
+{
+    if ( childIndex >= _ranges.size() )
+        _ranges.resize( childIndex+1, Range(0.0f, FLT_MAX) );
+    _ranges[childIndex] = Range( minRange, maxRange );
+}
+
+bool
+InstanceGroup::addChild( osg::Node* child )
+{
+    return insertChild( getNumChildren(), child );
+}
+
+bool
+InstanceGroup::insertChild( unsigned index, osg::Node* child )
+{
+    index = osg::minimum( index, getNumChildren() );
+    if ( !osg::Group::insertChild(index, child) )
+        return false;
+    if ( _ranges.size() < getNumChildren()-1 )
+        _ranges.resize( getNumChildren()-1, Range(0.0f, FLT_MAX) );
+    _ranges.insert( _ranges.begin()+index, Range(0.0f, FLT_MAX) );
+    return true;
+}
+
+bool
+InstanceGroup::removeChildren( unsigned pos, unsigned numChildrenToRemove )
+{
+    if ( pos < _ranges.size() )
+        _ranges.erase( _ranges.begin()+pos, _ranges.begin()+osg::minimum((unsigned)_ranges.size(), pos+numChildrenToRemove) );
+    return osg::Group::removeChildren( pos, numChildrenToRemove );
+}
+
+osg::BoundingSphere
+InstanceGroup::computeBound() const
+{
+    osg::BoundingSphere childBound = osg::Group::computeBound();
+
+    _instanceBounds.clear();
+    osg::BoundingSphere bs;
+    if ( !childBound.valid() )
+        return bs;
+
+    _instanceBounds.resize( _positions.size() );
+    for( unsigned i=0; i<_positions.size(); ++i )
+    {
+        osg::Vec3d center = _positions[i] + _rotations[i] * (osg::Vec3d(childBound.center()) * _scales[i]);
+        double     radius = childBound.radius() * _scales[i];
+        _instanceBounds[i].set( center.x(), center.y(), center.z(), radius );
+        bs.expandBy( osg::BoundingSphere(center, radius) );
+    }
+    return bs;
+}
+
+void
+InstanceGroup::cull(const osg::Polytope& frustum,
+                    const osg::Vec3d&    eye,
+                    float                lodScale,
+                    VisibleList&         out ) const
+{
+    // computes the instance bounds if necessary.
+    if ( !getBound().valid() )
+        return;
+
+    const osg::Polytope::PlaneList& planes = frustum.getPlaneList();
+    unsigned numPlanes = planes.size();
+    unsigned numChildren = osg::minimum( (unsigned)_ranges.size(), getNumChildren() );
+
+    for( unsigned i=0; i<_instanceBounds.size(); ++i )
+    {
+        const osg::Vec4d& b = _instanceBounds[i];
+        osg::Vec3d center( b.x(), b.y(), b.z() );
+
+        bool visible = true;
+        for( unsigned p=0; p<numPlanes && visible; ++p )
+        {
+            if ( planes[p].distance(center) < -b.w() )
+                visible = false;
+        }
+        if ( !visible )
+            continue;
+
+        float range = (center - eye).length() * lodScale;
+        for( unsigned c=0; c<numChildren; ++c )
+        {
+            if ( range >= _ranges[c].first && range < _ranges[c].second )
+                out.push_back( Visible(i, c) );
+        }
+    }
+}
+
+void
+InstanceGroup::traverse( osg::NodeVisitor& nv )
+{
+    if ( nv.getVisitorType() == osg::NodeVisitor::CULL_VISITOR )
+    {
+        osgUtil::CullVisitor* cv = static_cast<osgUtil::CullVisitor*>( &nv );
+
+        VisibleList visible;
+        cull( cv->getCurrentCullingSet().getFrustum(), cv->getEyeLocal(), cv->getLODScale(), visible );
+
+        for( unsigned v=0; v<visible.size(); )
+        {
+            unsigned i = visible[v].first;
+
+            osg::ref_ptr<osg::RefMatrix> matrix = cv->createOrReuseMatrix( *cv->getModelViewMatrix() );
+            matrix->preMult( getInstanceMatrix(i) );
+            cv->pushModelViewMatrix( matrix.get(), osg::Transform::RELATIVE_RF );
+
+            for( ; v<visible.size() && visible[v].first == i; ++v )
+                _children[visible[v].second]->accept( nv );
+
+            cv->popModelViewMatrix();
+        }
+    }
+
+    else if ( dynamic_cast<osgUtil::IntersectionVisitor*>( &nv ) )
+    {
+        osgUtil::IntersectionVisitor* iv = static_cast<osgUtil::IntersectionVisitor*>( &nv );
+
+        // Visit the children once per instance, in that instance's frame; this
+        // is what IntersectionVisitor::apply(osg::Transform&) does for a
+        // relative transform.
+        for( unsigned i=0; i<_positions.size(); ++i )
+        {
+            osg::ref_ptr<osg::RefMatrix> matrix = iv->getModelMatrix() ?
+                new osg::RefMatrix( *iv->getModelMatrix() ) :
+                new osg::RefMatrix();
+            matrix->preMult( getInstanceMatrix(i) );
+
+            iv->pushModelMatrix( matrix.get() );
+            iv->push_clone();
+
+            for( unsigned c=0; c<_children.size(); ++c )
+                _children[c]->accept( nv );
+
+            iv->pop_clone();
+            iv->popModelMatrix();
+        }
+    }
+
+    else
+    {
+        osg::Group::traverse( nv );
+    }
+}
@@ -21,6 +21,8 @@
 #include <osgEarth/TileSource>
 #include <osgEarth/HeightFieldUtils>
 #include <osgEarth/URI>
+#include <osgEarth/TaskService>
+#include <osg/Timer>
 #include <iterator>
 
 using namespace osgEarth;
@@ -376,6 +378,73 @@ Map::removeMapCallback( MapCallback* cb )
     }    
 }
 
+namespace
+{
+    // Initializes a terrain layer's tile source (see Map::initializeLayers)
+    struct InitLayer
+    {
+        void init( TerrainLayer* layer ) { _layer = layer; }
+        void execute() { _layer->getTileSource(); }
+        TerrainLayer* _layer;
+    };
+}
+
+void
+Map::initializeLayers()
+{
+    std::vector< osg::ref_ptr<TerrainLayer> > layers;
+    {
+        Threading::ScopedReadLock lock( _mapDataMutex );
+        layers.insert( layers.end(), _imageLayers.begin(), _imageLayers.end() );
+        layers.insert( layers.end(), _elevationLayers.begin(), _elevationLayers.end() );
+    }
+
+    if ( layers.empty() )
+        return;
+
+    osg::Timer_t startTime = osg::Timer::instance()->tick();
+
+    unsigned numThreads = osg::minimum( osg::maximum( *_mapOptions.layerInitThreads(), 1u ), (unsigned)layers.size() );
+    if ( numThreads == 1 )
+    {
+        for( unsigned i = 0; i < layers.size(); ++i )
+        {
+            layers[i]->getTileSource();
+        }
+    }
+    else
+    {
+        // each layer serializes its own initialization, so it is safe to race a
+        // lazy getTileSource() call from elsewhere.
+        // the pool is kept for later calls (e.g. after adding layers).
+        osg::ref_ptr<TaskService> service;
+        {
+            Threading::ScopedMutexLock lock( _layerInitMutex );
+            if ( !_layerInitService.valid() )
+                _layerInitService = new TaskService( "Map layer init", numThreads );
+            else if ( _layerInitService->getNumThreads() < (int)numThreads )
+                _layerInitService->setNumThreads( numThreads );
+            service = _layerInitService.get();
+        }
+        std::vector< osg::ref_ptr< ParallelTask<InitLayer> > > tasks( layers.size() );
+        Threading::MultiEvent semaphore( (int)layers.size() );
+
+        for( unsigned i = 0; i < layers.size(); ++i )
+        {
+            tasks[i] = new ParallelTask<InitLayer>( &semaphore );
+            tasks[i]->init( layers[i].get() );
+            service->add( tasks[i].get() );
+        }
+
+        semaphore.wait();
+    }
+
+    OE_INFO << LC << "Initialized " << layers.size() << " terrain layer(s) on "
+        << numThreads << " thread(s) in "
+        << osg::Timer::instance()->delta_m(startTime, osg::Timer::instance()->tick())
+        << " ms" << std::endl;
+}
+
 void
 Map::addImageLayer( ImageLayer* layer )
 {
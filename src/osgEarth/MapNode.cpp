@@ -220,6 +220,10 @@ MapNode::init()
     // TODO: not sure why we call this here
     _map->setGlobalOptions( local_options.get() );
 
+    // bring up the map's terrain layers concurrently; otherwise the engine would
+    // initialize them one at a time as it queries the map.
+    _map->initializeLayers();
+
     // load and attach the terrain engine, but don't initialize it until we need it
     const TerrainOptions& terrainOptions = _mapNodeOptions.getTerrainOptions();
 
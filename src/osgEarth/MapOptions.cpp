@@ -46,6 +46,8 @@ MapOptions::fromConfig( const Config& conf )
     conf.getIfSet( "elevation_interpolation", "average",     _elevationInterpolation, INTERP_AVERAGE);
     conf.getIfSet( "elevation_interpolation", "bilinear",    _elevationInterpolation, INTERP_BILINEAR);
     conf.getIfSet( "elevation_interpolation", "triangulate", _elevationInterpolation, INTERP_TRIANGULATE);    
+
+    conf.getIfSet( "layer_init_threads", _layerInitThreads );
 }
 
 Config
@@ -68,5 +70,7 @@ MapOptions::getConfig() const
     conf.updateIfSet( "elevation_interpolation", "bilinear",    _elevationInterpolation, INTERP_BILINEAR);
     conf.updateIfSet( "elevation_interpolation", "triangulate", _elevationInterpolation, INTERP_TRIANGULATE);
 
+    conf.updateIfSet( "layer_init_threads", _layerInitThreads );
+
     return conf;
 }
@@ -1040,27 +1040,19 @@ SpatialReference::transformZ(std::vector<osg::Vec3d>& points,
     if ( _vdatum.get() == outVDatum )
         return true;
 
-    Units inUnits = _vdatum.valid() ? _vdatum->getUnits() : Units::METERS;
-    Units outUnits = outVDatum ? outVDatum->getUnits() : inUnits;
+    // convert all the points in one batch so the geoid offsets are computed in bulk.
+    unsigned count = points.size();
+    if ( count == 0 )
+        return true;
+
+    std::vector<double> lats( count ), lons( count ), z( count );
 
     if ( isGeographic() || pointsAreLatLong )
     {
-        for( unsigned i=0; i<points.size(); ++i )
+        for( unsigned i=0; i<count; ++i )
         {
-            if ( _vdatum.valid() )
-            {
-                // to HAE:
-                points[i].z() = _vdatum->msl2hae( points[i].y(), points[i].x(), points[i].z() );
-            }
-
-            // do the units conversion:
-            points[i].z() = inUnits.convertTo(outUnits, points[i].z());
-
-            if ( outVDatum )
-            {
-                // to MSL:
-                points[i].z() = outVDatum->hae2msl( points[i].y(), points[i].x(), points[i].z() );
-            }
+            lons[i] = points[i].x();
+            lats[i] = points[i].y();
         }
     }
 
@@ -1070,25 +1062,21 @@ SpatialReference::transformZ(std::vector<osg::Vec3d>& points,
         std::vector<osg::Vec3d> geopoints(points);
         transform( geopoints, getGeographicSRS() );
 
-        for( unsigned i=0; i<geopoints.size(); ++i )
+        for( unsigned i=0; i<count; ++i )
         {
-            if ( _vdatum.valid() )
-            {
-                // to HAE:
-                points[i].z() = _vdatum->msl2hae( geopoints[i].y(), geopoints[i].x(), points[i].z() );
-            }
-
-            // do the units conversion:
-            points[i].z() = inUnits.convertTo(outUnits, points[i].z());
-
-            if ( outVDatum )
-            {
-                // to MSL:
-                points[i].z() = outVDatum->hae2msl( geopoints[i].y(), geopoints[i].x(), points[i].z() );
-            }
+            lons[i] = geopoints[i].x();
+            lats[i] = geopoints[i].y();
         }
     }
 
+    for( unsigned i=0; i<count; ++i )
+        z[i] = points[i].z();
+
+    VerticalDatum::transform( _vdatum.get(), outVDatum, &lats[0], &lons[0], &z[0], count );
+
+    for( unsigned i=0; i<count; ++i )
+        points[i].z() = z[i];
+
     return true;
 }
 
@@ -22,6 +22,7 @@
 #include <osgUtil/IntersectionVisitor>
 #include <osgUtil/LineSegmentIntersector>
 #include <osgViewer/View>
+#include <algorithm>
 
 #define LC "[Terrain] "
 
@@ -53,14 +54,29 @@ namespace
             }
         }
     };
+
+    // Resolution of the callback index grid along each axis of the map extent.
+    const unsigned CALLBACK_GRID_SIZE = 512u;
+
+    // Callbacks whose extent spans more cells than this are not worth indexing;
+    // they are kept in the global list and only tested against their extent.
+    const unsigned MAX_CELLS_PER_CALLBACK = 64u;
+
+    inline bool boundsIntersect( const Bounds& a, const Bounds& b )
+    {
+        return !(
+            a.xMax() < b.xMin() || a.xMin() > b.xMax() ||
+            a.yMax() < b.yMin() || a.yMin() > b.yMax() );
+    }
 }
 
 //---------------------------------------------------------------------------
 
 Terrain::Terrain(osg::Node* graph, const Profile* mapProfile, bool geocentric) :
-_graph     ( graph ),
-_profile   ( mapProfile ),
-_geocentric( geocentric )
+_graph         ( graph ),
+_profile       ( mapProfile ),
+_geocentric    ( geocentric ),
+_nextCallbackID( 0u )
 {
     //nop
 }
@@ -92,7 +108,7 @@ Terrain::getHeight(double     mapX,
         getSRS()->transformToECEF(end, end);
     }
 
-    osgUtil::LineSegmentIntersector* lsi = new osgUtil::LineSegmentIntersector(start, end);
+    DPLineSegmentIntersector* lsi = new DPLineSegmentIntersector(start, end);
     osgUtil::IntersectionVisitor iv( lsi );
     lsi->setIntersectionLimit(osgUtil::Intersector::LIMIT_ONE);
 
@@ -167,7 +183,113 @@ Terrain::getWorldCoordsUnderMouse(osg::View* view, float x, float y, osg::Vec3d&
 }
 
 void
-Terrain::addTerrainCallback( TerrainCallback* cb, osg::Referenced* clientData )
+Terrain::computeCallbackExtents( const GeoExtent& extent, std::vector<Bounds>& output ) const
+{
+    output.clear();
+    if ( !extent.isValid() )
+        return;
+
+    GeoExtent mapExtent = extent.getSRS() && !extent.getSRS()->isHorizEquivalentTo(getSRS()) ?
+        extent.transform( getSRS() ) :
+        extent;
+
+    if ( !mapExtent.isValid() )
+        return;
+
+    GeoExtent west, east;
+    if ( mapExtent.crossesAntimeridian() && mapExtent.splitAcrossAntimeridian(west, east) )
+    {
+        output.push_back( west.bounds() );
+        output.push_back( east.bounds() );
+    }
+    else
+    {
+        output.push_back( mapExtent.bounds() );
+    }
+}
+
+void
+Terrain::getCellRange( const Bounds& b, unsigned& c0, unsigned& r0, unsigned& c1, unsigned& r1 ) const
+{
+    const GeoExtent& full = _profile->getExtent();
+    double cellWidth  = full.width()  / (double)CALLBACK_GRID_SIZE;
+    double cellHeight = full.height() / (double)CALLBACK_GRID_SIZE;
+
+    double fc0 = floor( (b.xMin() - full.xMin()) / cellWidth );
+    double fc1 = floor( (b.xMax() - full.xMin()) / cellWidth );
+    double fr0 = floor( (b.yMin() - full.yMin()) / cellHeight );
+    double fr1 = floor( (b.yMax() - full.yMin()) / cellHeight );
+
+    double maxIndex = (double)(CALLBACK_GRID_SIZE-1);
+    c0 = (unsigned)osg::clampBetween( fc0, 0.0, maxIndex );
+    c1 = (unsigned)osg::clampBetween( fc1, 0.0, maxIndex );
+    r0 = (unsigned)osg::clampBetween( fr0, 0.0, maxIndex );
+    r1 = (unsigned)osg::clampBetween( fr1, 0.0, maxIndex );
+}
+
+void
+Terrain::indexCallback( unsigned id, const CallbackRecord& rec )
+{
+    // count the cells first so we don't index callbacks that cover huge areas.
+    unsigned numCells = 0;
+    for( std::vector<Bounds>::const_iterator b = rec._extents.begin(); b != rec._extents.end(); ++b )
+    {
+        unsigned c0, r0, c1, r1;
+        getCellRange( *b, c0, r0, c1, r1 );
+        numCells += (c1-c0+1)*(r1-r0+1);
+    }
+
+    if ( rec._extents.empty() || numCells > MAX_CELLS_PER_CALLBACK )
+    {
+        // IDs are issued in increasing order, but re-indexing can re-insert an older one.
+        std::vector<unsigned>::iterator i = std::lower_bound( _globalCallbacks.begin(), _globalCallbacks.end(), id );
+        _globalCallbacks.insert( i, id );
+        return;
+    }
+
+    for( std::vector<Bounds>::const_iterator b = rec._extents.begin(); b != rec._extents.end(); ++b )
+    {
+        unsigned c0, r0, c1, r1;
+        getCellRange( *b, c0, r0, c1, r1 );
+        for( unsigned r = r0; r <= r1; ++r )
+            for( unsigned c = c0; c <= c1; ++c )
+                _callbackGrid[r*CALLBACK_GRID_SIZE + c].push_back( id );
+    }
+}
+
+void
+Terrain::unindexCallback( unsigned id, const CallbackRecord& rec )
+{
+    std::vector<unsigned>::iterator g = std::lower_bound( _globalCallbacks.begin(), _globalCallbacks.end(), id );
+    if ( g != _globalCallbacks.end() && *g == id )
+    {
+        _globalCallbacks.erase( g );
+        return;
+    }
+
+    for( std::vector<Bounds>::const_iterator b = rec._extents.begin(); b != rec._extents.end(); ++b )
+    {
+        unsigned c0, r0, c1, r1;
+        getCellRange( *b, c0, r0, c1, r1 );
+        for( unsigned r = r0; r <= r1; ++r )
+        {
+            for( unsigned c = c0; c <= c1; ++c )
+            {
+                CallbackGrid::iterator cell = _callbackGrid.find( r*CALLBACK_GRID_SIZE + c );
+                if ( cell != _callbackGrid.end() )
+                {
+                    std::vector<unsigned>& ids = cell->second;
+                    ids.erase( std::remove(ids.begin(), ids.end(), id), ids.end() );
+                    if ( ids.empty() )
+                        _callbackGrid.erase( cell );
+                }
+            }
+        }
+    }
+}
+
+void
+Terrain::addTerrainCallback( TerrainCallback* cb, osg::Referenced* clientData, const GeoExtent& extentOfInterest )
 {
     if ( cb )
     {
@@ -175,9 +297,32 @@ Terrain::addTerrainCallback( TerrainCallback* cb, osg::Referenced* clientData )
         rec._callback = cb;
         rec._clientData = clientData;
         rec._hasClientData = clientData != 0L;
+        computeCallbackExtents( extentOfInterest, rec._extents );
 
         Threading::ScopedWriteLock exclusiveLock( _callbacksMutex );
-        _callbacks.push_back( rec );
+        unsigned id = _nextCallbackID++;
+        _callbacks[id] = rec;
+        indexCallback( id, rec );
+    }
+}
+
+void
+Terrain::setTerrainCallbackExtent( TerrainCallback* cb, const GeoExtent& extentOfInterest )
+{
+    std::vector<Bounds> extents;
+    computeCallbackExtents( extentOfInterest, extents );
+
+    Threading::ScopedWriteLock exclusiveLock( _callbacksMutex );
+
+    for( CallbackMap::iterator i = _callbacks.begin(); i != _callbacks.end(); ++i )
+    {
+        CallbackRecord& rec = i->second;
+        if ( rec._callback.get() == cb )
+        {
+            unindexCallback( i->first, rec );
+            rec._extents = extents;
+            indexCallback( i->first, rec );
+        }
     }
 }
 
@@ -186,12 +331,13 @@ Terrain::removeTerrainCallback( TerrainCallback* cb )
 {
     Threading::ScopedWriteLock exclusiveLock( _callbacksMutex );
 
-    for( CallbackList::iterator i = _callbacks.begin(); i != _callbacks.end(); )
+    for( CallbackMap::iterator i = _callbacks.begin(); i != _callbacks.end(); )
     {
-        CallbackRecord& rec = *i;
+        CallbackRecord& rec = i->second;
         if ( rec._callback.get() == cb )
         {
-            i = _callbacks.erase( i );
+            unindexCallback( i->first, rec );
+            _callbacks.erase( i++ );
         }
         else
         {
@@ -205,12 +351,13 @@ Terrain::removeTerrainCallbacksWithClientData( osg::Referenced* cd )
 {
     Threading::ScopedWriteLock exclusiveLock( _callbacksMutex );
 
-    for( CallbackList::iterator i = _callbacks.begin(); i != _callbacks.end(); )
+    for( CallbackMap::iterator i = _callbacks.begin(); i != _callbacks.end(); )
     {
-        CallbackRecord& rec = *i;
+        CallbackRecord& rec = i->second;
         if ( rec._hasClientData && rec._clientData.get() == cd )
         {
-            i = _callbacks.erase( i );
+            unindexCallback( i->first, rec );
+            _callbacks.erase( i++ );
         }
         else
         {
@@ -236,33 +383,93 @@ Terrain::notifyTileAdded( const TileKey& key, osg::Node* node )
 void
 Terrain::fireTileAdded( const TileKey& key, osg::Node* node )
 {
-    Threading::ScopedReadLock sharedLock( _callbacksMutex );
-
-    for( CallbackList::iterator i = _callbacks.begin(); i != _callbacks.end(); )
+    std::vector<unsigned> expired;
     {
-        CallbackRecord& rec = *i;
+        Threading::ScopedReadLock sharedLock( _callbacksMutex );
 
-        bool keep = true;
-        osg::ref_ptr<osg::Referenced> clientData_safe = rec._clientData.get();
+        // collect the callbacks that might care about this tile: the global ones, plus
+        // any indexed ones in the grid cells that the tile touches.
+        const Bounds tileBounds = key.getExtent().bounds();
+        std::vector<unsigned> candidates( _globalCallbacks );
 
-        // if the client data has gone away, discard the callback.
-        if ( rec._hasClientData && !clientData_safe.valid() )
+        if ( !_callbackGrid.empty() )
         {
-            keep = false;
+            unsigned c0, r0, c1, r1;
+            getCellRange( tileBounds, c0, r0, c1, r1 );
+
+            if ( (c1-c0+1)*(r1-r0+1) >= _callbackGrid.size() )
+            {
+                // big tile; cheaper to just take everything in the grid.
+                for( CallbackGrid::const_iterator cell = _callbackGrid.begin(); cell != _callbackGrid.end(); ++cell )
+                    candidates.insert( candidates.end(), cell->second.begin(), cell->second.end() );
+            }
+            else
+            {
+                for( unsigned r = r0; r <= r1; ++r )
+                {
+                    for( unsigned c = c0; c <= c1; ++c )
+                    {
+                        CallbackGrid::const_iterator cell = _callbackGrid.find( r*CALLBACK_GRID_SIZE + c );
+                        if ( cell != _callbackGrid.end() )
+                            candidates.insert( candidates.end(), cell->second.begin(), cell->second.end() );
+                    }
+                }
+            }
+
+            // fire in registration order, once each.
+            std::sort( candidates.begin(), candidates.end() );
+            candidates.erase( std::unique(candidates.begin(), candidates.end()), candidates.end() );
         }
-        else
+
+        for( std::vector<unsigned>::const_iterator id = candidates.begin(); id != candidates.end(); ++id )
         {
-            TerrainCallbackContext context( this, clientData_safe.get() );
-            rec._callback->onTileAdded( key, node, context );
+            CallbackMap::iterator i = _callbacks.find( *id );
+            if ( i == _callbacks.end() )
+                continue;
+
+            CallbackRecord& rec = i->second;
+
+            // exact test against the extent of interest, if there is one.
+            if ( !rec._extents.empty() )
+            {
+                bool hit = false;
+                for( std::vector<Bounds>::const_iterator b = rec._extents.begin(); b != rec._extents.end() && !hit; ++b )
+                    hit = boundsIntersect( *b, tileBounds );
+                if ( !hit )
+                    continue;
+            }
+
+            osg::ref_ptr<osg::Referenced> clientData_safe = rec._clientData.get();
+
+            // if the client data has gone away, discard the callback.
+            if ( rec._hasClientData && !clientData_safe.valid() )
+            {
+                expired.push_back( *id );
+            }
+            else
+            {
+                TerrainCallbackContext context( this, clientData_safe.get() );
+                rec._callback->onTileAdded( key, node, context );
 
-            // if the callback set the "remove" flag, discard the callback.
-            if ( context._remove )
-                keep = false;
+                // if the callback set the "remove" flag, discard the callback.
+                if ( context._remove )
+                    expired.push_back( *id );
+            }
         }
+    }
 
-        if ( keep )
-            ++i;
-        else
-            i = _callbacks.erase( i );
+    // discard expired callbacks under an exclusive lock.
+    if ( !expired.empty() )
+    {
+        Threading::ScopedWriteLock exclusiveLock( _callbacksMutex );
+        for( std::vector<unsigned>::const_iterator id = expired.begin(); id != expired.end(); ++id )
+        {
+            CallbackMap::iterator i = _callbacks.find( *id );
+            if ( i != _callbacks.end() )
+            {
+                unindexCallback( i->first, i->second );
+                _callbacks.erase( i );
+            }
+        }
     }
 }
@@ -22,6 +22,7 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/URI>
 #include <osgDB/WriteFile>
+#include <osg/Timer>
 #include <osg/Version>
 #include <OpenThreads/ScopedLock>
 #include <memory.h>
@@ -226,6 +227,7 @@ TerrainLayer::setCache( Cache* cache )
                 hashConf.remove( "cache_enabled" );
                 hashConf.remove( "cache_policy" );
                 hashConf.remove( "cacheid" );
+                hashConf.remove( "metadata_max_age" );
 
                 cacheId = Stringify() << std::hex << osgEarth::hashString(hashConf.toJSON());
             }
@@ -486,6 +488,8 @@ TerrainLayer::initTileSource()
 {	
     OE_DEBUG << LC << "Initializing tile source ..." << std::endl;
 
+    osg::Timer_t startTime = osg::Timer::instance()->tick();
+
     // instantiate it from driver options if it has not already been created:
     if ( !_tileSource.valid() )
     {
@@ -520,12 +524,20 @@ TerrainLayer::initTileSource()
             URIContext( _runtimeOptions->referrer() ).store( _dbOptions.get() );
         }
 
+        // pass the layer's cache policy along, so the tile source can apply it
+        // to anything it caches on its own (service metadata, for example).
+        if ( _dbOptions.valid() && _runtimeOptions->cachePolicy().isSet() )
+            _runtimeOptions->cachePolicy()->store( _dbOptions.get() );
+
         // intialize the tile source
 		_tileSource->initialize( _dbOptions.get(), overrideProfile.get() );
 
 		if ( _tileSource->isOK() )
 		{
 			_tileSize = _tileSource->getPixelsPerTile();
+
+            // the data extents are final now; index them before any tiles are requested.
+            _tileSource->dataExtentsChanged();
 		}
 		else
 		{
@@ -549,6 +561,10 @@ TerrainLayer::initTileSource()
     }
 
     _tileSourceInitialized = true;
+
+    OE_INFO << LC << "Layer \"" << getName() << "\" initialized in "
+        << osg::Timer::instance()->delta_m(startTime, osg::Timer::instance()->tick())
+        << " ms" << std::endl;
 }
 
 bool
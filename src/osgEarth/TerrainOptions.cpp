@@ -100,6 +100,7 @@ _attenuationDistance( 1000000 ),
 _lodBlending( false ),
 _lodTransitionTimeSeconds( 0.5f ),
 _enableMipmapping( true ),
+_compressTextures( false ),
 _clusterCulling( true ),
 _enableBlending( false ),
 _mercatorFastPath( true ),
@@ -126,6 +127,7 @@ TerrainOptions::getConfig() const
     conf.updateIfSet( "attenuation_distance", _attenuationDistance );
     conf.updateIfSet( "lod_transition_time", _lodTransitionTimeSeconds );
     conf.updateIfSet( "mipmapping", _enableMipmapping );
+    conf.updateIfSet( "compress_textures", _compressTextures );
     conf.updateIfSet( "cluster_culling", _clusterCulling );
     conf.updateIfSet( "blending", _enableBlending );
     conf.updateIfSet( "mercator_fast_path", _mercatorFastPath );
@@ -167,6 +169,7 @@ TerrainOptions::fromConfig( const Config& conf )
     conf.getIfSet( "attenuation_distance", _attenuationDistance );
     conf.getIfSet( "lod_transition_time", _lodTransitionTimeSeconds );
     conf.getIfSet( "mipmapping", _enableMipmapping );
+    conf.getIfSet( "compress_textures", _compressTextures );
     conf.getIfSet( "cluster_culling", _clusterCulling );
     conf.getIfSet( "blending", _enableBlending );
     conf.getIfSet( "mercator_fast_path", _mercatorFastPath );
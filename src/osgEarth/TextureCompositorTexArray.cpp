@@ -167,7 +167,7 @@ namespace
 {
     osg::Texture2DArray*
     s_getTexture( osg::StateSet* stateSet, const TextureLayout& layout,
-                  int unit, unsigned textureSize )
+                  int unit, unsigned textureSize, bool compressed )
     {
         osg::Texture2DArray* tex = static_cast<osg::Texture2DArray*>(
             stateSet->getTextureAttribute( unit, osg::StateAttribute::TEXTURE ) );
@@ -176,8 +176,16 @@ namespace
         if ( !tex )
         {
             tex = new SparseTexture2DArray();
-            tex->setSourceFormat( GL_RGBA );
-            tex->setInternalFormat( GL_RGBA8 );
+            if ( compressed )
+            {
+                tex->setSourceFormat( GL_COMPRESSED_RGBA_S3TC_DXT5_EXT );
+                tex->setInternalFormat( GL_COMPRESSED_RGBA_S3TC_DXT5_EXT );
+            }
+            else
+            {
+                tex->setSourceFormat( GL_RGBA );
+                tex->setInternalFormat( GL_RGBA8 );
+            }
             tex->setTextureWidth( textureSize );
             tex->setTextureHeight( textureSize );
 
@@ -186,6 +194,7 @@ namespace
             tex->setResizeNonPowerOfTwoHint(false);
             tex->setFilter( osg::Texture::MAG_FILTER, osg::Texture::LINEAR );
             tex->setFilter( osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR );
+            tex->setUseHardwareMipMapGeneration( true );
 
             // configure the wrapping
             tex->setWrap(osg::Texture::WRAP_S,osg::Texture::CLAMP_TO_EDGE);
@@ -230,14 +239,14 @@ namespace
         return sampler.get();
     }
 
-    void assignImage(osg::Texture2DArray* texture, int slot, osg::Image* image)
+    void assignImage(osg::Texture2DArray* texture, int slot, osg::Image* image, bool mipmapping)
     {
         // We have to dirty() the image because otherwise the texture2d
         // array implementation will not recognize it as new data.
         image->dirty();
         texture->setImage( slot, image );
 
-        if (ImageUtils::isPowerOfTwo( image ) && !(!image->isMipmap() && ImageUtils::isCompressed(image)))
+        if (mipmapping && ImageUtils::isPowerOfTwo( image ) && !(!image->isMipmap() && ImageUtils::isCompressed(image)))
         {
             if ( texture->getFilter(osg::Texture::MIN_FILTER) != osg::Texture::LINEAR_MIPMAP_LINEAR )
                 texture->setFilter( osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR );
@@ -273,7 +282,9 @@ TextureCompositorTexArray::isSupported()
 }
 
 TextureCompositorTexArray::TextureCompositorTexArray( const TerrainOptions& options ) :
-_lodTransitionTime( *options.lodTransitionTime() )
+_lodTransitionTime( *options.lodTransitionTime() ),
+_enableMipmapping ( *options.enableMipmapping() ),
+_compressTextures ( *options.compressTextures() )
 {
     //nop
 }
@@ -285,28 +296,48 @@ TextureCompositorTexArray::prepareImage( const GeoImage& layerImage, const GeoEx
     if (!image)
         return GeoImage::INVALID;
 
-    if (image->getPixelFormat() != GL_RGBA ||
-        image->getInternalTextureFormat() != GL_RGBA8 ||
-        image->s() != textureSize ||
-        image->t() != textureSize )
+    // All tex2darray layers must be identical in size and format, so every image goes
+    // to RGBA8 (or DXT5) at the fixed texture size. This runs on the tile-building
+    // threads, so we do the conversion here and leave only the upload for the draw thread.
+    GLenum targetFormat = _compressTextures ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_RGBA8;
+
+    // an image that already has the right size and format goes in as-is, with or
+    // without mipmaps of its own; the GPU generates any that are missing.
+    if (image->getInternalTextureFormat() == targetFormat &&
+        (_compressTextures || image->getPixelFormat() == GL_RGBA) &&
+        image->s() == textureSize &&
+        image->t() == textureSize )
     {
-        // Because all tex2darray layers must be identical in format, let's use RGBA.
-        osg::ref_ptr<osg::Image> newImage = ImageUtils::convertToRGBA8( image );
-        
-        // TODO: revisit. For now let's just settle on 256 (again, all layers must be the same size)
-        if ( image->s() != textureSize || image->t() != textureSize )
-        {
-            osg::ref_ptr<osg::Image> resizedImage;
-            if ( ImageUtils::resizeImage( newImage.get(), textureSize, textureSize, resizedImage ) )
-                newImage = resizedImage.get();
-        }
+        return layerImage;
+    }
 
-        return GeoImage( newImage.get(), layerImage.getExtent() );
+    osg::ref_ptr<osg::Image> newImage = ImageUtils::convertToRGBA8( image );
+    if ( !newImage.valid() )
+    {
+        OE_WARN << LC << "Unable to convert layer image to RGBA8" << std::endl;
+        return GeoImage::INVALID;
     }
-    else
+
+    // TODO: revisit. For now let's just settle on 256 (again, all layers must be the same size)
+    if ( image->s() != textureSize || image->t() != textureSize )
     {
-        return layerImage;
+        osg::ref_ptr<osg::Image> resizedImage;
+        if ( ImageUtils::resizeImage( newImage.get(), textureSize, textureSize, resizedImage ) )
+            newImage = resizedImage.get();
     }
+
+    if ( _compressTextures )
+    {
+        // drivers can't generate mipmaps for a compressed texture, so build the
+        // chain before compressing.
+        if ( _enableMipmapping )
+            newImage = ImageUtils::createRGBA8( newImage.get(), textureSize, textureSize, true );
+
+        if ( newImage.valid() )
+            newImage = ImageUtils::compressDXT( newImage.get(), true );
+    }
+
+    return GeoImage( newImage.get(), layerImage.getExtent() );
 }
 
 void
@@ -324,11 +355,11 @@ TextureCompositorTexArray::applyLayerUpdate(osg::StateSet*       stateSet,
 
     // access the texture array, creating or growing it if necessary:
     osg::Texture2DArray* texture = s_getTexture( stateSet, layout, 0,
-                                                 textureSize() );
+                                                 textureSize(), _compressTextures );
     ensureSampler( stateSet, 0 );
     // assign the new image at the proper position in the texture array.
     osg::Image* image = preparedImage.getImage();
-    assignImage(texture, slot, image);
+    assignImage(texture, slot, image, _enableMipmapping);
     
     // update the region uniform to reflect the geo extent of the image:
     const GeoExtent& imageExtent = preparedImage.getExtent();
@@ -19,6 +19,7 @@
 #include <limits.h>
 
 #include <osgEarth/TileSource>
+#include <osgEarth/Cache>
 #include <osgEarth/ImageToHeightFieldConverter>
 #include <osgEarth/ImageUtils>
 #include <osgEarth/FileUtils>
@@ -149,7 +150,8 @@ _tileSize          ( 256 ),
 _noDataValue       ( (float)SHRT_MIN ),
 _noDataMinValue    ( -32000.0f ),
 _noDataMaxValue    (  32000.0f ),
-_L2CacheSize       ( 16 )
+_L2CacheSize       ( 16 ),
+_metadataMaxAge    ( 86400.0 )
 { 
     fromConfig( _conf );
 }
@@ -165,6 +167,7 @@ TileSourceOptions::getConfig() const
     conf.updateIfSet( "nodata_max", _noDataMaxValue );
     conf.updateIfSet( "blacklist_filename", _blacklistFilename);
     conf.updateIfSet( "l2_cache_size", _L2CacheSize );
+    conf.updateIfSet( "metadata_max_age", _metadataMaxAge );
     conf.updateObjIfSet( "profile", _profileOptions );
     return conf;
 }
@@ -187,6 +190,7 @@ TileSourceOptions::fromConfig( const Config& conf )
     conf.getIfSet( "nodata_max", _noDataMaxValue );
     conf.getIfSet( "blacklist_filename", _blacklistFilename);
     conf.getIfSet( "l2_cache_size", _L2CacheSize );
+    conf.getIfSet( "metadata_max_age", _metadataMaxAge );
     conf.getObjIfSet( "profile", _profileOptions );
 
     // special handling of default tile size:
@@ -339,24 +343,70 @@ TileSource::setProfile( const Profile* profile )
     _profile = profile;
 }
 
+CachePolicy
+TileSource::getMetadataCachePolicy( const osgDB::Options* dbOptions ) const
+{
+    // the layer only stores a cache in its options if caching is enabled for it.
+    if ( !dbOptions || !Cache::get(dbOptions) )
+        return CachePolicy::NO_CACHE;
+
+    // follow the layer's usage (read-only, cache-only...) and never keep
+    // metadata longer than the layer would keep its tiles.
+    CachePolicy policy( CachePolicy::USAGE_READ_WRITE, *_options.metadataMaxAge() );
+
+    optional<CachePolicy> layerPolicy;
+    if ( CachePolicy::fromOptions(dbOptions, layerPolicy) )
+    {
+        if ( layerPolicy->usage().isSet() )
+            policy.usage() = *layerPolicy->usage();
+        if ( layerPolicy->maxAge().isSet() )
+            policy.maxAge() = osg::minimum( *policy.maxAge(), *layerPolicy->maxAge() );
+    }
+
+    return policy;
+}
+
 const Profile*
 TileSource::getProfile() const
 {
     return _profile.get();
 }
 
+void
+TileSource::dataExtentsChanged()
+{
+    // build outside the lock and swap it in; readers keep the index they already hold.
+    osg::ref_ptr<DataExtentIndex> index = new DataExtentIndex( _dataExtents );
+
+    Threading::ScopedWriteLock lock( _dataExtentIndexMutex );
+    _dataExtentIndex = index.get();
+}
+
+osg::ref_ptr<DataExtentIndex>
+TileSource::getDataExtentIndex() const
+{
+    {
+        Threading::ScopedReadLock lock( _dataExtentIndexMutex );
+        if ( _dataExtentIndex.valid() )
+            return _dataExtentIndex;
+    }
+
+    // a source used outside of a layer may never have been indexed; do it once.
+    Threading::ScopedWriteLock lock( _dataExtentIndexMutex );
+    if ( !_dataExtentIndex.valid() )
+    {
+        _dataExtentIndex = new DataExtentIndex( _dataExtents );
+    }
+    return _dataExtentIndex;
+}
+
 unsigned int
 TileSource::getMaxDataLevel() const
 {
     //If we have no data extents, just use a reasonably high number
     if (_dataExtents.size() == 0) return 23;
 
-    unsigned int maxDataLevel = 0;
-    for (DataExtentList::const_iterator itr = _dataExtents.begin(); itr != _dataExtents.end(); ++itr)
-    {
-        if (itr->getMaxLevel() > maxDataLevel) maxDataLevel = itr->getMaxLevel();
-    }
-    return maxDataLevel;
+    return getDataExtentIndex()->getMaxLevel();
 }
 
 unsigned int
@@ -365,12 +415,7 @@ TileSource::getMinDataLevel() const
     //If we have no data extents, just use 0
     if (_dataExtents.size() == 0) return 0;
 
-    unsigned int minDataLevel = INT_MAX;
-    for (DataExtentList::const_iterator itr = _dataExtents.begin(); itr != _dataExtents.end(); ++itr)
-    {
-        if (itr->getMinLevel() < minDataLevel) minDataLevel = itr->getMinLevel();
-    }
-    return minDataLevel;
+    return getDataExtentIndex()->getMinLevel();
 }
 
 bool
@@ -380,17 +425,7 @@ TileSource::hasDataAtLOD( unsigned lod ) const
     if ( _dataExtents.size() == 0 )
         return true;
 
-    bool intersects = false;
-
-    for (DataExtentList::const_iterator itr = _dataExtents.begin(); itr != _dataExtents.end(); ++itr)
-    {
-        if ( itr->getMinLevel() <= lod && lod <= itr->getMaxLevel() )
-        {
-            intersects = true;
-            break;
-        }
-    }
-    return intersects;
+    return getDataExtentIndex()->hasLevel( lod );
 }
 
 bool
@@ -400,17 +435,7 @@ TileSource::hasDataInExtent( const GeoExtent& extent ) const
     if ( _dataExtents.size() == 0 )
         return true;
 
-    bool intersects = false;
-
-    for (DataExtentList::const_iterator itr = _dataExtents.begin(); itr != _dataExtents.end(); ++itr)
-    {
-        if ( extent.intersects( *itr ) )
-        {
-            intersects = true;
-            break;
-        }
-    }
-    return intersects;
+    return getDataExtentIndex()->intersects( extent );
 }
 
 
@@ -420,19 +445,7 @@ TileSource::hasData(const osgEarth::TileKey& key) const
     //If no data extents are provided, just return true
     if (_dataExtents.size() == 0) return true;
 
-    const osgEarth::GeoExtent& keyExtent = key.getExtent();
-    bool intersectsData = false;
-
-    for (DataExtentList::const_iterator itr = _dataExtents.begin(); itr != _dataExtents.end(); ++itr)
-    {
-        if (keyExtent.intersects( *itr ) && key.getLevelOfDetail() >= itr->getMinLevel() && key.getLevelOfDetail() <= itr->getMaxLevel())
-        {
-            intersectsData = true;
-            break;
-        }
-    }
-
-    return intersectsData;
+    return getDataExtentIndex()->intersects( key.getExtent(), key.getLevelOfDetail() );
 }
 
 bool
@@ -0,0 +1,333 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2012 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/TriangleBVH>
+#include <osgEarth/Notify>
+#include <osg/TriangleIndexFunctor>
+#include <algorithm>
+#include <cmath>
+
+using namespace osgEarth;
+
+#define LC "[TriangleBVH] "
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    const unsigned MAX_LEAF_SIZE = 4;
+    const unsigned MAX_STACK     = 64;
+
+    // collects triangle indices in osg::TriangleFunctor order.
+    struct CollectTriangles
+    {
+        CollectTriangles() : _count(0) { }
+
+        void operator()( unsigned p0, unsigned p1, unsigned p2 )
+        {
+            // keep the primitive count in step with TriangleFunctor, but
+            // don't store triangles that can never be hit.
+            if ( p0 != p1 && p1 != p2 && p0 != p2 )
+            {
+                _indices.push_back( p0 );
+                _indices.push_back( p1 );
+                _indices.push_back( p2 );
+                _indices.push_back( _count );
+            }
+            ++_count;
+        }
+
+        std::vector<unsigned> _indices;
+        unsigned              _count;
+    };
+
+    struct CentroidLess
+    {
+        CentroidLess( const std::vector<osg::Vec3f>& centroids, int axis ) : _centroids(centroids), _axis(axis) { }
+
+        bool operator()( unsigned a, unsigned b ) const {
+            return _centroids[a][_axis] < _centroids[b][_axis];
+        }
+
+        const std::vector<osg::Vec3f>& _centroids;
+        int                            _axis;
+    };
+
+    // clips the segment start + t*dir, t in [0, tmax], against a box.
+    inline bool clipToBox( const osg::BoundingBoxf& bbox, const osg::Vec3d& start, const osg::Vec3d& dir, double tmax, double& out_tEntry )
+    {
+        double t0 = 0.0, t1 = tmax;
+        for( int i=0; i<3; ++i )
+        {
+            if ( dir[i] == 0.0 )
+            {
+                if ( start[i] < bbox._min[i] || start[i] > bbox._max[i] )
+                    return false;
+            }
+            else
+            {
+                double inv = 1.0/dir[i];
+                double tn  = (bbox._min[i] - start[i]) * inv;
+                double tf  = (bbox._max[i] - start[i]) * inv;
+                if ( tn > tf ) std::swap( tn, tf );
+                if ( tn > t0 ) t0 = tn;
+                if ( tf < t1 ) t1 = tf;
+                if ( t0 > t1 )
+                    return false;
+            }
+        }
+        out_tEntry = t0;
+        return true;
+    }
+
+    struct StackEntry
+    {
+        unsigned node;
+        double   tEntry;
+    };
+}
+
+//------------------------------------------------------------------------
+
+TriangleBVH::TriangleBVH()
+{
+    //nop
+}
+
+TriangleBVH::TriangleBVH(const TriangleBVH& rhs, const osg::CopyOp& op) :
+osg::Shape ( rhs, op ),
+_nodes     ( rhs._nodes ),
+_triangles ( rhs._triangles ),
+_vertices  ( rhs._vertices )
+{
+    //nop
+}
+
+bool
+TriangleBVH::build( osg::Geometry* geometry )
+{
+    _nodes.clear();
+    _triangles.clear();
+    _vertices = geometry ? dynamic_cast<osg::Vec3Array*>( geometry->getVertexArray() ) : 0L;
+    if ( !_vertices.valid() || _vertices->empty() )
+        return false;
+
+    osg::TriangleIndexFunctor<CollectTriangles> collect;
+    geometry->accept( collect );
+
+    unsigned numTris = collect._indices.size() / 4;
+    if ( numTris == 0 )
+        return false;
+
+    const osg::Vec3Array& verts = *_vertices.get();
+    std::vector<Triangle>   tris( numTris );
+    std::vector<osg::Vec3f> centroids( numTris );
+    std::vector<unsigned>   order( numTris );
+
+    for( unsigned i=0; i<numTris; ++i )
+    {
+        Triangle& t = tris[i];
+        t.p0    = collect._indices[i*4];
+        t.p1    = collect._indices[i*4+1];
+        t.p2    = collect._indices[i*4+2];
+        t.index = collect._indices[i*4+3];
+        if ( t.p0 >= verts.size() || t.p1 >= verts.size() || t.p2 >= verts.size() )
+            return false;
+        centroids[i] = (verts[t.p0] + verts[t.p1] + verts[t.p2]) / 3.0f;
+        order[i] = i;
+    }
+
+    _triangles.swap( tris );
+    _nodes.reserve( 2 * (numTris / MAX_LEAF_SIZE + 1) );
+    buildNode( order, centroids, 0, numTris );
+
+    // store the triangles in leaf order so each leaf is a contiguous range.
+    std::vector<Triangle> sorted( numTris );
+    for( unsigned i=0; i<numTris; ++i )
+        sorted[i] = _triangles[order[i]];
+    _triangles.swap( sorted );
+
+    return true;
+}
+
+unsigned
+TriangleBVH::buildNode(std::vector<unsigned>&         order,
+                       const std::vector<osg::Vec3f>& centroids,
+                       unsigned                       first,
+                       unsigned                       count)
+{
+    unsigned nodeIndex = _nodes.size();
+    _nodes.push_back( Node() );
+
+    const osg::Vec3Array& verts = *_vertices.get();
+    osg::BoundingBoxf bbox, centroidBox;
+    for( unsigned i=first; i<first+count; ++i )
+    {
+        const Triangle& t = _triangles[order[i]];
+        bbox.expandBy( verts[t.p0] );
+        bbox.expandBy( verts[t.p1] );
+        bbox.expandBy( verts[t.p2] );
+        centroidBox.expandBy( centroids[order[i]] );
+    }
+
+    // pad the box a little so that float rounding in the clip test never
+    // rejects a triangle that touches the boundary.
+    float pad = (bbox._max - bbox._min).length() * 1e-5f + 1e-5f;
+    bbox._min -= osg::Vec3f(pad, pad, pad);
+    bbox._max += osg::Vec3f(pad, pad, pad);
+    _nodes[nodeIndex].bbox = bbox;
+
+    // split on the longest axis of the centroid bounds.
+    osg::Vec3f extent = centroidBox._max - centroidBox._min;
+    int axis = extent.x() > extent.y() ? (extent.x() > extent.z() ? 0 : 2) : (extent.y() > extent.z() ? 1 : 2);
+
+    if ( count <= MAX_LEAF_SIZE || extent[axis] <= 0.0f )
+    {
+        _nodes[nodeIndex].offset = first;
+        _nodes[nodeIndex].count  = count;
+        return nodeIndex;
+    }
+
+    unsigned mid = first + count/2;
+    std::nth_element( order.begin()+first, order.begin()+mid, order.begin()+first+count, CentroidLess(centroids, axis) );
+
+    buildNode( order, centroids, first, mid-first );
+    unsigned right = buildNode( order, centroids, mid, first+count-mid );
+
+    _nodes[nodeIndex].offset = right;
+    _nodes[nodeIndex].count  = 0;
+    return nodeIndex;
+}
+
+bool
+TriangleBVH::intersect(const osg::Vec3d& start,
+                       const osg::Vec3d& end,
+                       bool              nearestOnly,
+                       Hits&             out_hits ) const
+{
+    if ( _nodes.empty() )
+        return false;
+
+    const osg::Vec3Array& verts = *_vertices.get();
+    osg::Vec3d dir = end - start;
+    double     tBest = 1.0;
+    Hit        nearest;
+    bool       found = false;
+
+    StackEntry stack[MAX_STACK];
+    unsigned   top = 0;
+
+    double tEntry;
+    if ( !clipToBox(_nodes[0].bbox, start, dir, tBest, tEntry) )
+        return false;
+    stack[top].node = 0;
+    stack[top].tEntry = tEntry;
+    ++top;
+
+    while( top > 0 )
+    {
+        --top;
+        if ( stack[top].tEntry > tBest )
+            continue;
+
+        const Node& node = _nodes[stack[top].node];
+
+        if ( node.count > 0 )
+        {
+            for( unsigned i=node.offset; i<node.offset+node.count; ++i )
+            {
+                const Triangle& tri = _triangles[i];
+                osg::Vec3d v0( verts[tri.p0] ), v1( verts[tri.p1] ), v2( verts[tri.p2] );
+
+                osg::Vec3d e1 = v1 - v0;
+                osg::Vec3d e2 = v2 - v0;
+                osg::Vec3d p  = dir ^ e2;
+                double det = e1 * p;
+                if ( det == 0.0 )
+                    continue; // parallel or degenerate
+
+                double inv = 1.0/det;
+                osg::Vec3d tv = start - v0;
+                double u = (tv * p) * inv;
+                if ( u < 0.0 || u > 1.0 )
+                    continue;
+
+                osg::Vec3d q = tv ^ e1;
+                double v = (dir * q) * inv;
+                if ( v < 0.0 || u + v > 1.0 )
+                    continue;
+
+                double t = (e2 * q) * inv;
+                if ( t < 0.0 || t > tBest )
+                    continue;
+
+                Hit hit;
+                hit.ratio          = t;
+                hit.primitiveIndex = tri.index;
+                hit.p0 = tri.p0; hit.p1 = tri.p1; hit.p2 = tri.p2;
+                hit.r0 = 1.0 - u - v;
+                hit.r1 = u;
+                hit.r2 = v;
+                hit.normal = e1 ^ e2;
+                hit.normal.normalize();
+
+                if ( nearestOnly )
+                {
+                    nearest = hit;
+                    tBest   = t;
+                    found   = true;
+                }
+                else
+                {
+                    out_hits.push_back( hit );
+                    found = true;
+                }
+            }
+        }
+        else
+        {
+            // visit the nearer child first, so a nearest-only query can prune the other.
+            unsigned left = stack[top].node + 1, right = node.offset;
+            double tLeft, tRight;
+            bool hitLeft  = clipToBox( _nodes[left].bbox,  start, dir, tBest, tLeft );
+            bool hitRight = clipToBox( _nodes[right].bbox, start, dir, tBest, tRight );
+
+            if ( top + 2 > MAX_STACK )
+            {
+                OE_WARN << LC << "Hierarchy too deep; intersection results may be incomplete" << std::endl;
+                break;
+            }
+
+            if ( hitLeft && hitRight && tLeft < tRight )
+            {
+                stack[top].node = right; stack[top].tEntry = tRight; ++top;
+                stack[top].node = left;  stack[top].tEntry = tLeft;  ++top;
+            }
+            else
+            {
+                if ( hitLeft )  { stack[top].node = left;  stack[top].tEntry = tLeft;  ++top; }
+                if ( hitRight ) { stack[top].node = right; stack[top].tEntry = tRight; ++top; }
+            }
+        }
+    }
+
+    if ( nearestOnly && found )
+        out_hits.push_back( nearest );
+
+    return found;
+}
@@ -21,6 +21,7 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/GeoData>
+#include <vector>
 
 #include <osgDB/ReadFile>
 #include <osgDB/ReaderWriter>
@@ -98,7 +99,7 @@ VerticalDatum::transform(const VerticalDatum* from,
 
     if ( from )
     {
-        in_out_z = from->msl2hae( lat_deg, lon_deg, INTERP_BILINEAR );
+        in_out_z = from->msl2hae( lat_deg, lon_deg, in_out_z );
     }
 
     Units fromUnits = from ? from->getUnits() : Units::METERS;
@@ -108,7 +109,7 @@ VerticalDatum::transform(const VerticalDatum* from,
 
     if ( to )
     {
-        in_out_z = to->hae2msl( lat_deg, lon_deg, INTERP_BILINEAR );
+        in_out_z = to->hae2msl( lat_deg, lon_deg, in_out_z );
     }
 
     return true;
@@ -127,6 +128,49 @@ VerticalDatum::transform(const VerticalDatum* from,
     return ok;
 }
 
+bool
+VerticalDatum::transform(const VerticalDatum* from,
+                         const VerticalDatum* to,
+                         const double*        lat_deg,
+                         const double*        lon_deg,
+                         double*              in_out_z,
+                         unsigned             count)
+{
+    if ( from == to || count == 0 )
+        return true;
+
+    const Geoid* fromGeoid = from ? from->getGeoid() : 0L;
+    const Geoid* toGeoid   = to   ? to->getGeoid()   : 0L;
+
+    Units fromUnits = from ? from->getUnits() : Units::METERS;
+    Units toUnits = to ? to->getUnits() : fromUnits;
+    double scale = fromUnits.convertTo(toUnits, 1.0);
+
+    std::vector<float> offsets( count );
+
+    if ( fromGeoid )
+    {
+        fromGeoid->getHeights( lat_deg, lon_deg, count, &offsets[0] );
+        for( unsigned i=0; i<count; ++i )
+            in_out_z[i] += offsets[i];
+    }
+
+    if ( scale != 1.0 )
+    {
+        for( unsigned i=0; i<count; ++i )
+            in_out_z[i] *= scale;
+    }
+
+    if ( toGeoid )
+    {
+        toGeoid->getHeights( lat_deg, lon_deg, count, &offsets[0] );
+        for( unsigned i=0; i<count; ++i )
+            in_out_z[i] -= offsets[i];
+    }
+
+    return true;
+}
+
 bool
 VerticalDatum::transform(const VerticalDatum* from,
                          const VerticalDatum* to,
@@ -138,30 +182,64 @@ VerticalDatum::transform(const VerticalDatum* from,
 
     unsigned cols = hf->getNumColumns();
     unsigned rows = hf->getNumRows();
-    osg::Vec3d sw = hf->getOrigin();
-    osg::Vec3d ne;
-    ne.x() = sw.x() + hf->getXInterval()*double(rows);
-    ne.y() = sw.y() + hf->getYInterval()*double(cols);
-    double xstep = hf->getXInterval();
-    double ystep = hf->getYInterval();
-
-    if ( !extent.getSRS()->isGeographic() )
+    if ( cols < 2 || rows < 2 )
+        return false;
+
+    const Geoid* fromGeoid = from ? from->getGeoid() : 0L;
+    const Geoid* toGeoid   = to   ? to->getGeoid()   : 0L;
+
+    Units fromUnits = from ? from->getUnits() : Units::METERS;
+    Units toUnits = to ? to->getUnits() : fromUnits;
+    float scale = (float)fromUnits.convertTo(toUnits, 1.0);
+
+    unsigned count = cols*rows;
+    std::vector<float> fromOffsets, toOffsets;
+    if ( fromGeoid ) fromOffsets.resize( count );
+    if ( toGeoid )   toOffsets.resize( count );
+
+    double xstep = extent.width() / double(cols-1);
+    double ystep = extent.height() / double(rows-1);
+
+    if ( extent.getSRS()->isGeographic() )
     {
-        const SpatialReference* geoSRS = extent.getSRS()->getGeographicSRS();
-        extent.getSRS()->transform(sw, geoSRS, sw);
-        extent.getSRS()->transform(ne, geoSRS, ne);
-        xstep = (ne.x()-sw.x()) / double(cols);
-        ystep = (ne.y()-sw.y()) / double(rows);
+        // a regular lat/long grid, so use the separable kernel.
+        if ( fromGeoid )
+            fromGeoid->getHeights( extent.xMin(), extent.yMin(), xstep, ystep, cols, rows, &fromOffsets[0] );
+        if ( toGeoid )
+            toGeoid->getHeights( extent.xMin(), extent.yMin(), xstep, ystep, cols, rows, &toOffsets[0] );
+    }
+    else if ( fromGeoid || toGeoid )
+    {
+        // project every sample to lat/long in one batch.
+        std::vector<osg::Vec3d> points( count );
+        for( unsigned r=0; r<rows; ++r )
+            for( unsigned c=0; c<cols; ++c )
+                points[r*cols+c].set( extent.xMin() + xstep*double(c), extent.yMin() + ystep*double(r), 0.0 );
+
+        extent.getSRS()->transform( points, extent.getSRS()->getGeographicSRS() );
+
+        std::vector<double> lats( count ), lons( count );
+        for( unsigned i=0; i<count; ++i )
+        {
+            lons[i] = points[i].x();
+            lats[i] = points[i].y();
+        }
+
+        if ( fromGeoid )
+            fromGeoid->getHeights( &lats[0], &lons[0], count, &fromOffsets[0] );
+        if ( toGeoid )
+            toGeoid->getHeights( &lats[0], &lons[0], count, &toOffsets[0] );
     }
 
-    for( unsigned c=0; c<cols; ++c)
+    osg::HeightField::HeightList& heights = hf->getHeightList();
+    for( unsigned i=0; i<count; ++i )
     {
-        double lon = sw.x() + xstep*double(c);
-        for( unsigned r=0; r<rows; ++r)
+        float& h = heights[i];
+        if ( h != NO_DATA_VALUE )
         {
-            double lat = sw.y() + ystep*double(r);
-            float& h = hf->getHeight(r, c);
-            VerticalDatum::transform( from, to, lat, lon, h );
+            if ( fromGeoid ) h += fromOffsets[i];
+            h *= scale;
+            if ( toGeoid ) h -= toOffsets[i];
         }
     }
 
@@ -88,12 +88,14 @@ AnnotationNode::setAutoClamp( bool value )
 
             if ( AnnotationSettings::getContinuousClamping() )
             {
-                mapNode_safe->getTerrain()->addTerrainCallback(new AutoClampCallback(), this);
+                _autoClampCallback = new AutoClampCallback();
+                mapNode_safe->getTerrain()->addTerrainCallback(_autoClampCallback.get(), this, _autoClampExtent);
             }
         }
         else if ( _autoclamp && !value )
         {
             mapNode_safe->getTerrain()->removeTerrainCallbacksWithClientData(this);
+            _autoClampCallback = 0L;
         }
 
         _autoclamp = value;
@@ -122,6 +124,21 @@ AnnotationNode::setAutoClamp( bool value )
     }
 }
 
+void
+AnnotationNode::setAutoClampExtent( const GeoExtent& extent )
+{
+    _autoClampExtent = extent;
+
+    if ( _autoClampCallback.valid() )
+    {
+        osg::ref_ptr<MapNode> mapNode_safe = _mapNode.get();
+        if ( mapNode_safe.valid() )
+        {
+            mapNode_safe->getTerrain()->setTerrainCallbackExtent( _autoClampCallback.get(), _autoClampExtent );
+        }
+    }
+}
+
 void
 AnnotationNode::setDepthAdjustment( bool enable )
 {
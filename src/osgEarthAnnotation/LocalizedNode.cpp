@@ -97,6 +97,11 @@ LocalizedNode::setPosition( const GeoPoint& pos )
         _mapPosition = pos;
     }
 
+    // limit terrain callbacks to tiles under the new position:
+    setAutoClampExtent( GeoExtent(
+        _mapPosition.getSRS(),
+        _mapPosition.x(), _mapPosition.y(), _mapPosition.x(), _mapPosition.y()) );
+
     // make sure the node is set up for auto-z-update if necessary:
     configureForAltitudeMode( _mapPosition.altitudeMode() );
 
@@ -259,6 +259,11 @@ OrthoNode::setPosition( const GeoPoint& position )
         _mapPosition = position;
     }
 
+    // limit terrain callbacks to tiles under the new position:
+    setAutoClampExtent( GeoExtent(
+        _mapPosition.getSRS(),
+        _mapPosition.x(), _mapPosition.y(), _mapPosition.x(), _mapPosition.y()) );
+
     // make sure the node is set up for auto-z-update if necessary:
     configureForAltitudeMode( _mapPosition.altitudeMode() );
 
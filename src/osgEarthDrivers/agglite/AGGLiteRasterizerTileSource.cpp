@@ -26,6 +26,7 @@
 #include <osgEarthSymbology/AGG.h>
 #include <osgEarth/Registry>
 #include <osgEarth/FileUtils>
+#include <osgEarth/ThreadingUtils>
 
 #include <osg/Notify>
 #include <osgDB/FileNameUtils>
@@ -38,6 +39,8 @@
 //#include "agg.h"
 
 #include <sstream>
+#include <algorithm>
+#include <cmath>
 #include <OpenThreads/Mutex>
 #include <OpenThreads/ScopedLock>
 
@@ -51,6 +54,117 @@ using namespace OpenThreads;
 
 /********************************************************************/
 
+namespace
+{
+    /**
+     * Features that have been transformed to the map SRS, bucketed into a
+     * uniform grid so a tile only visits the features near it.
+     */
+    struct FeatureIndex : public osg::Referenced
+    {
+        FeatureIndex() : _cols(0), _rows(0), _cellWidth(1.0), _cellHeight(1.0) { }
+
+        void build( const FeatureList& features )
+        {
+            for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i )
+            {
+                Bounds b = i->get()->getGeometry()->getBounds();
+                if ( b.isValid() )
+                {
+                    _features.push_back( i->get() );
+                    _bounds.push_back( b );
+                    _extent.expandBy( b );
+                }
+            }
+
+            if ( _features.empty() )
+                return;
+
+            // aim for a handful of features per cell.
+            unsigned dim = (unsigned)std::ceil( std::sqrt((double)_features.size() / 4.0) );
+            _cols = _rows = osg::clampBetween( dim, 1u, 1024u );
+            _cellWidth  = _extent.width()  > 0.0 ? _extent.width()  / (double)_cols : 1.0;
+            _cellHeight = _extent.height() > 0.0 ? _extent.height() / (double)_rows : 1.0;
+            _cells.resize( _cols * _rows );
+
+            for( unsigned i = 0; i < _bounds.size(); ++i )
+            {
+                unsigned c0, c1, r0, r1;
+                getCells( _bounds[i], c0, c1, r0, r1 );
+                for( unsigned r = r0; r <= r1; ++r )
+                    for( unsigned c = c0; c <= c1; ++c )
+                        _cells[r*_cols + c].push_back( i );
+            }
+        }
+
+        /** Appends copies of the features whose bounds intersect a box. */
+        void query( const Bounds& box, FeatureList& output ) const
+        {
+            if ( _features.empty() || !box.isValid() ||
+                 box.xMin() > _extent.xMax() || box.xMax() < _extent.xMin() ||
+                 box.yMin() > _extent.yMax() || box.yMax() < _extent.yMin() )
+                return;
+
+            unsigned c0, c1, r0, r1;
+            getCells( box, c0, c1, r0, r1 );
+
+            std::vector<unsigned> hits;
+            for( unsigned r = r0; r <= r1; ++r )
+                for( unsigned c = c0; c <= c1; ++c )
+                    hits.insert( hits.end(), _cells[r*_cols + c].begin(), _cells[r*_cols + c].end() );
+
+            // a feature spanning several cells is listed in each one.
+            std::sort( hits.begin(), hits.end() );
+            hits.erase( std::unique(hits.begin(), hits.end()), hits.end() );
+
+            for( std::vector<unsigned>::const_iterator i = hits.begin(); i != hits.end(); ++i )
+            {
+                const Bounds& b = _bounds[*i];
+                if ( b.xMin() <= box.xMax() && b.xMax() >= box.xMin() && b.yMin() <= box.yMax() && b.yMax() >= box.yMin() )
+                {
+                    // the renderer modifies geometry in place, so hand out copies.
+                    output.push_back( new Feature( *_features[*i].get() ) );
+                }
+            }
+        }
+
+        void getCells( const Bounds& b, unsigned& c0, unsigned& c1, unsigned& r0, unsigned& r1 ) const
+        {
+            c0 = toCell( b.xMin(), _extent.xMin(), _cellWidth,  _cols );
+            c1 = toCell( b.xMax(), _extent.xMin(), _cellWidth,  _cols );
+            r0 = toCell( b.yMin(), _extent.yMin(), _cellHeight, _rows );
+            r1 = toCell( b.yMax(), _extent.yMin(), _cellHeight, _rows );
+        }
+
+        static unsigned toCell( double v, double origin, double size, unsigned num )
+        {
+            double cell = std::floor( (v - origin) / size );
+            return cell <= 0.0 ? 0u : cell >= (double)(num-1) ? num-1 : (unsigned)cell;
+        }
+
+        osg::ref_ptr<FeatureProfile>     _profile;     // profile of the indexed (transformed) features
+        std::vector< osg::ref_ptr<Feature> > _features;
+        std::vector<Bounds>              _bounds;
+        Bounds                           _extent;
+        unsigned                         _cols, _rows;
+        double                           _cellWidth, _cellHeight;
+        std::vector< std::vector<unsigned> > _cells;
+    };
+
+    /**
+     * One build of a feature index. The first thread to need it builds it;
+     * others wait on "done" instead of building it again.
+     */
+    struct FeatureIndexBuild : public osg::Referenced
+    {
+        osg::ref_ptr<FeatureIndex> _index;
+        Revision                   _revision;   // of the feature source, when the build started
+        Threading::Event           _done;
+    };
+}
+
+/********************************************************************/
+
 class AGGLiteRasterizerTileSource : public FeatureTileSource
 {
 public:
@@ -81,6 +195,29 @@ public:
         return true;
     }
 
+    //override
+    bool queryAndRenderFeaturesForStyle(
+        const Style&     style,
+        const Query&     query,
+        osg::Referenced* buildData,
+        const GeoExtent& imageExtent,
+        osg::Image*      image )
+    {
+        if ( _options.featureIndex() != true )
+            return FeatureTileSource::queryAndRenderFeaturesForStyle( style, query, buildData, imageExtent, image );
+
+        osg::ref_ptr<FeatureIndex> index = getOrCreateFeatureIndex( style, query );
+        if ( !index.valid() )
+            return false;
+
+        FeatureList features;
+        index->query( imageExtent.bounds(), features );
+        if ( features.empty() )
+            return false;
+
+        return renderFeatures( style, features, index->_profile.get(), buildData, imageExtent, image );
+    }
+
     //override
     bool renderFeaturesForStyle(
         const Style&       style,
@@ -88,6 +225,100 @@ public:
         osg::Referenced*   buildData,
         const GeoExtent&   imageExtent,
         osg::Image*        image )
+    {
+        return renderFeatures( style, inFeatures, getFeatureSource()->getFeatureProfile(), buildData, imageExtent, image );
+    }
+
+    /**
+     * Reads the features for a style once, transforms them to the map SRS, and
+     * indexes them for all subsequent tiles. The index is rebuilt when the
+     * feature source changes.
+     */
+    osg::ref_ptr<FeatureIndex> getOrCreateFeatureIndex( const Style& style, const Query& query )
+    {
+        std::string key = style.getName() + ";" + query.getConfig().toJSON();
+
+        // the lock only guards the table; each index builds outside of it.
+        osg::ref_ptr<FeatureIndexBuild> build;
+        bool builder = false;
+        {
+            Threading::ScopedMutexLock lock( _indexMutex );
+
+            osg::ref_ptr<FeatureIndexBuild>& entry = _indexes[key];
+            if ( !entry.valid() || (entry->_done.isSet() && _features->outOfSyncWith(entry->_revision)) )
+            {
+                entry = new FeatureIndexBuild();
+                _features->sync( entry->_revision );
+                builder = true;
+            }
+            build = entry.get();
+        }
+
+        if ( builder )
+        {
+            build->_index = createFeatureIndex( style, query );
+            build->_done.set();
+        }
+        else
+        {
+            while( !build->_done.isSet() )
+                build->_done.wait();
+        }
+
+        return build->_index;
+    }
+
+    FeatureIndex* createFeatureIndex( const Style& style, const Query& query )
+    {
+        FeatureList features;
+        osg::ref_ptr<FeatureCursor> cursor = _features->createFeatureCursor( query );
+        while( cursor.valid() && cursor->hasMore() )
+        {
+            Feature* feature = cursor->nextFeature();
+            Geometry* geom = feature ? feature->getGeometry() : 0L;
+            if ( geom )
+            {
+                // apply a type override if requested:
+                if (_options.geometryTypeOverride().isSet() &&
+                    _options.geometryTypeOverride() != geom->getComponentType() )
+                {
+                    geom = geom->cloneAs( _options.geometryTypeOverride().value() );
+                    if ( geom )
+                        feature->setGeometry( geom );
+                }
+            }
+            if ( geom )
+            {
+                features.push_back( feature );
+            }
+        }
+
+        FilterContext context;
+        context.profile() = getFeatureSource()->getFeatureProfile();
+
+        TransformFilter xform( getProfile()->getSRS() );
+        xform.setLocalizeCoordinates( false );
+        context = xform.push( features, context );
+
+        osg::ref_ptr<FeatureIndex> index = new FeatureIndex();
+        index->_profile = new FeatureProfile( getProfile()->getExtent() );
+        index->build( features );
+
+        OE_INFO << LC << "Indexed " << index->_features.size() << " features for style \"" << style.getName() << "\"" << std::endl;
+
+        return index.release();
+    }
+
+    /**
+     * Rasterizes features expressed in the SRS of the given profile.
+     */
+    bool renderFeatures(
+        const Style&          style,
+        const FeatureList&    inFeatures,
+        const FeatureProfile* featureProfile,
+        osg::Referenced*      buildData,
+        const GeoExtent&      imageExtent,
+        osg::Image*           image )
     {
         // local copy of the features that we can process
         FeatureList features = inFeatures;
@@ -96,7 +327,7 @@ public:
 
         // A processing context to use with the filters:
         FilterContext context;
-        context.profile() = getFeatureSource()->getFeatureProfile();
+        context.profile() = featureProfile;
 
         const LineSymbol* masterLine = style.getSymbol<LineSymbol>();
         const PolygonSymbol* masterPoly = style.getSymbol<PolygonSymbol>();
@@ -205,9 +436,23 @@ public:
             // "relative line size" means that the line width is expressed in (approx) pixels
             // rather than in map units
             if ( _options.relativeLineSize() == true )
+            {
                 buffer.distance() = xres * lineWidth;
+            }
             else
-                buffer.distance() = lineWidth;
+            {
+                // absolute widths are in the feature source's units; scale them if the
+                // features were already transformed to another SRS.
+                const SpatialReference* sourceSRS = getFeatureSource()->getFeatureProfile()->getSRS();
+                double unitScale = 1.0;
+                if ( !context.profile()->getSRS()->isEquivalentTo(sourceSRS) )
+                {
+                    GeoExtent sourceExtent = imageExtent.transform( sourceSRS );
+                    if ( sourceExtent.width() > 0.0 )
+                        unitScale = transformedExtent.width() / sourceExtent.width();
+                }
+                buffer.distance() = lineWidth * unitScale;
+            }
 
             buffer.push( linesToBuffer, context );
         }
@@ -339,6 +584,10 @@ public:
 private:
     const AGGLiteOptions _options;
     std::string _configPath;
+
+    typedef std::map<std::string, osg::ref_ptr<FeatureIndexBuild> > FeatureIndexes;
+    FeatureIndexes    _indexes;
+    Threading::Mutex  _indexMutex;
 };
 
 // Reads tiles from a TileCache disk cache.
@@ -21,6 +21,7 @@
 #define OSGEARTH_ARCGIS_MAP_SERVICE_H 1
 
 #include <osgEarth/Profile>
+#include <osgEarth/CachePolicy>
 #include <list>
 #include "Extent.h"
 
@@ -90,9 +91,13 @@ public:
     /**
      * Initializes a map service interface and populates its metadata from the
      * provided REST API URL (e.g.: http://server/ArcGIS/rest/services/MyMapService)
-     * Call isValid() to verify success.
+     * Call isValid() to verify success. The metadata is read through the cache
+     * in the options according to the cache policy.
      */
-    bool init( const std::string& url, const osgDB::ReaderWriter::Options* options =0L );
+    bool init(
+        const std::string&                  url,
+        const osgDB::ReaderWriter::Options* options     =0L,
+        const CachePolicy&                  cachePolicy =CachePolicy::NO_CACHE );
 
     /**
      * Returns true if the map service initialized succesfully.
@@ -71,6 +71,13 @@ public:
         if ( _format.empty() )
             _format = "png";
 
+    }
+
+    // override
+    void initialize( const osgDB::Options* dbOptions, const Profile* overrideProfile)
+    {
+        _dbOptions = dbOptions;
+
         URI url = _options.url().value();
         //Add the token if necessary
         if (_options.token().isSet())
@@ -83,18 +90,12 @@ public:
             }
         }
 
-        // read metadata from the server
-        if ( !_map_service.init( url.full() ) ) //, getOptions()) )
+        // read metadata from the server (or from the cache, if it's fresh enough)
+        if ( !_map_service.init( url.full(), dbOptions, getMetadataCachePolicy(dbOptions) ) )
         {
             OE_WARN << "[osgearth] [ArcGIS] map service initialization failed: "
                 << _map_service.getError() << std::endl;
         }
-    }
-
-    // override
-    void initialize( const osgDB::Options* dbOptions, const Profile* overrideProfile)
-    {
-        _dbOptions = dbOptions;
 
         const Profile* profile = NULL;
 
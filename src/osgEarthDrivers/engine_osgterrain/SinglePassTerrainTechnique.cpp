@@ -22,7 +22,9 @@
 
 #include <osgEarth/Cube>
 #include <osgEarth/ImageUtils>
+#include <osgEarth/TriangleBVH>
 
+#include <osg/BufferObject>
 #include <osg/Point>
 #include <osg/Program>
 #include <osg/io_utils>
@@ -38,6 +40,7 @@
 #include <osgEarthSymbology/Geometry>
 #include <osgEarthSymbology/MeshConsolidator>
 
+#include <map>
 #include <sstream>
 
 using namespace osgEarth;
@@ -63,6 +66,275 @@ namespace
   };
 
   typedef std::vector<MaskRecord> MaskRecordVector;
+
+  /**
+   * Converts a regular grid of local (NDC) tile coordinates to model space in bulk.
+   * The per-column longitude and per-row latitude terms are computed once, and the
+   * up vector comes straight from the ellipsoid instead of from a second locator
+   * conversion. Only usable for locators with an axis-aligned transform; init()
+   * returns false otherwise and the caller must use the locator directly.
+   */
+  struct GridTransformer
+  {
+    bool init( const GeoLocator* locator, unsigned numColumns, unsigned numRows )
+    {
+      const osg::Matrixd& m = locator->getTransform();
+      if ( m(0,1) != 0.0 || m(0,2) != 0.0 || m(1,0) != 0.0 || m(1,2) != 0.0 ||
+           m(2,0) != 0.0 || m(2,1) != 0.0 || m(2,2) != 1.0 || m(3,2) != 0.0 )
+        return false;
+
+      _geocentric = locator->getCoordinateSystemType() == osgTerrain::Locator::GEOCENTRIC;
+      if ( _geocentric )
+      {
+        const osg::EllipsoidModel* em = locator->getEllipsoidModel();
+        if ( !em )
+          return false;
+        _a = em->getRadiusEquator();
+        double f = (_a - em->getRadiusPolar()) / _a;
+        _e2 = 2.0*f - f*f;
+      }
+
+      _x.resize( numColumns );
+      _cosLon.resize( _geocentric ? numColumns : 0 );
+      _sinLon.resize( _geocentric ? numColumns : 0 );
+      for( unsigned i=0; i<numColumns; ++i )
+      {
+        _x[i] = ((double)i/(double)(numColumns-1)) * m(0,0) + m(3,0);
+        if ( _geocentric )
+        {
+          _cosLon[i] = cos(_x[i]);
+          _sinLon[i] = sin(_x[i]);
+        }
+      }
+
+      _y.resize( numRows );
+      _cosLat.resize( _geocentric ? numRows : 0 );
+      _sinLat.resize( _geocentric ? numRows : 0 );
+      _N.resize( _geocentric ? numRows : 0 );
+      for( unsigned j=0; j<numRows; ++j )
+      {
+        _y[j] = ((double)j/(double)(numRows-1)) * m(1,1) + m(3,1);
+        if ( _geocentric )
+        {
+          _cosLat[j] = cos(_y[j]);
+          _sinLat[j] = sin(_y[j]);
+          _N[j] = _a / sqrt( 1.0 - _e2*_sinLat[j]*_sinLat[j] );
+        }
+      }
+
+      // sanity-check against the locator itself, in case a subclass overrides the conversion.
+      osg::Vec3d check, fast, up;
+      locator->convertLocalToModel( osg::Vec3d(1.0, 1.0, 100.0), check );
+      transform( numColumns-1, numRows-1, 100.0, fast, up );
+      return (check-fast).length() < 1e-3;
+    }
+
+    void transform( unsigned i, unsigned j, double height, osg::Vec3d& out_model, osg::Vec3d& out_up ) const
+    {
+      if ( _geocentric )
+      {
+        out_up.set( _cosLat[j]*_cosLon[i], _cosLat[j]*_sinLon[i], _sinLat[j] );
+        double r = _N[j] + height;
+        out_model.set( r*out_up.x(), r*out_up.y(), (_N[j]*(1.0-_e2) + height)*_sinLat[j] );
+      }
+      else
+      {
+        out_model.set( _x[i], _y[j], height );
+        out_up.set( 0.0, 0.0, 1.0 );
+      }
+    }
+
+    bool _geocentric;
+    double _a, _e2;
+    std::vector<double> _x, _y, _cosLon, _sinLon, _cosLat, _sinLat, _N;
+  };
+
+  template<typename T>
+  void buildSurfaceIndices( T* elements, unsigned numRows, unsigned numColumns, bool swapOrientation )
+  {
+    elements->reserve( (numRows-1) * (numColumns-1) * 6 );
+    for( unsigned j=0; j<numRows-1; ++j )
+    {
+      for( unsigned i=0; i<numColumns-1; ++i )
+      {
+        unsigned i00 = swapOrientation ? (j+1)*numColumns + i : j*numColumns + i;
+        unsigned i01 = swapOrientation ? j*numColumns + i     : (j+1)*numColumns + i;
+        unsigned i10 = i00+1;
+        unsigned i11 = i01+1;
+
+        elements->push_back(i01); elements->push_back(i00); elements->push_back(i11);
+        elements->push_back(i00); elements->push_back(i10); elements->push_back(i11);
+      }
+    }
+  }
+
+  // triangulates a single strip, in the same winding a TriangleIndexFunctor would produce.
+  template<typename T>
+  void buildStripIndices( T* elements, unsigned numVerts )
+  {
+    elements->reserve( (numVerts-2) * 3 );
+    for( unsigned i=2; i<numVerts; ++i )
+    {
+      unsigned b = i-2;
+      if ( i%2 ) { elements->push_back(b); elements->push_back(b+2); elements->push_back(b+1); }
+      else       { elements->push_back(b); elements->push_back(b+1); elements->push_back(b+2); }
+    }
+  }
+
+  /**
+   * DrawElements that belong to the shared index cache. Expiring one tile releases
+   * the GL objects of its geometry, but must not delete an EBO that every other live
+   * tile is still drawing with, so the per-tile release skips it. The cache releases
+   * the EBO itself (see SharedIndexCache::releaseGLObjects).
+   */
+  template<typename T>
+  class SharedDrawElements : public T
+  {
+  public:
+    SharedDrawElements() : T( GL_TRIANGLES ) { }
+
+    virtual void releaseGLObjects( osg::State* state =0L ) const
+    {
+      // per-tile path: leave the shared EBO to the cache.
+    }
+  };
+
+  // Creates the smallest DrawElements type that can address numVerts vertices.
+  osg::DrawElements* createDrawElements( unsigned numVerts )
+  {
+    if ( numVerts < 0x100 )
+      return new SharedDrawElements<osg::DrawElementsUByte>();
+    else if ( numVerts < 0x10000 )
+      return new SharedDrawElements<osg::DrawElementsUShort>();
+    else
+      return new SharedDrawElements<osg::DrawElementsUInt>();
+  }
+
+  /**
+   * Immutable index buffers shared by every tile with the same grid layout. Unmasked
+   * tiles with no invalid elevation samples all have identical topology, so there is
+   * no need for each of them to build and hold its own copy.
+   */
+  class SharedIndexCache
+  {
+  public:
+    SharedIndexCache() : _users( 0 ) { }
+
+    osg::DrawElements* getSurface( unsigned numRows, unsigned numColumns, bool swapOrientation )
+    {
+      Threading::ScopedMutexLock lock( _mutex );
+      osg::ref_ptr<osg::DrawElements>& elements = _surfaces[swapOrientation?1:0][std::make_pair(numRows, numColumns)];
+      if ( !elements.valid() )
+      {
+        elements = createDrawElements( numRows*numColumns );
+        if ( osg::DrawElementsUByte* ub = dynamic_cast<osg::DrawElementsUByte*>(elements.get()) )
+          buildSurfaceIndices( ub, numRows, numColumns, swapOrientation );
+        else if ( osg::DrawElementsUShort* us = dynamic_cast<osg::DrawElementsUShort*>(elements.get()) )
+          buildSurfaceIndices( us, numRows, numColumns, swapOrientation );
+        else
+          buildSurfaceIndices( static_cast<osg::DrawElementsUInt*>(elements.get()), numRows, numColumns, swapOrientation );
+        finish( elements.get() );
+      }
+      return elements.get();
+    }
+
+    osg::DrawElements* getSkirt( unsigned numVerts )
+    {
+      Threading::ScopedMutexLock lock( _mutex );
+      osg::ref_ptr<osg::DrawElements>& elements = _skirts[numVerts];
+      if ( !elements.valid() )
+      {
+        elements = createDrawElements( numVerts );
+        if ( osg::DrawElementsUByte* ub = dynamic_cast<osg::DrawElementsUByte*>(elements.get()) )
+          buildStripIndices( ub, numVerts );
+        else if ( osg::DrawElementsUShort* us = dynamic_cast<osg::DrawElementsUShort*>(elements.get()) )
+          buildStripIndices( us, numVerts );
+        else
+          buildStripIndices( static_cast<osg::DrawElementsUInt*>(elements.get()), numVerts );
+        finish( elements.get() );
+      }
+      return elements.get();
+    }
+
+    // Releases the EBOs of all the shared sets, for one graphics context or (with a
+    // NULL state) for all of them. The sets upload themselves again on next use.
+    void releaseGLObjects( osg::State* state )
+    {
+      Threading::ScopedMutexLock lock( _mutex );
+      releaseAll( state );
+    }
+
+    void addUser()
+    {
+      Threading::ScopedMutexLock lock( _mutex );
+      ++_users;
+    }
+
+    // when the last terrain goes away, release everything and start over.
+    void removeUser()
+    {
+      Threading::ScopedMutexLock lock( _mutex );
+      if ( _users > 0 && --_users == 0 )
+      {
+        releaseAll( 0L );
+        _surfaces[0].clear();
+        _surfaces[1].clear();
+        _skirts.clear();
+      }
+    }
+
+  private:
+    void releaseAll( osg::State* state )
+    {
+      for( unsigned i = 0; i < 2; ++i )
+        for( SurfaceMap::iterator s = _surfaces[i].begin(); s != _surfaces[i].end(); ++s )
+          release( s->second.get(), state );
+      for( SkirtMap::iterator s = _skirts.begin(); s != _skirts.end(); ++s )
+        release( s->second.get(), state );
+    }
+
+    void release( osg::DrawElements* elements, osg::State* state )
+    {
+      if ( elements && elements->getElementBufferObject() )
+        elements->getElementBufferObject()->releaseGLObjects( state );
+    }
+
+    void finish( osg::DrawElements* elements )
+    {
+      // give the shared set its own EBO so that no single tile's geometry claims it.
+      elements->setElementBufferObject( new osg::ElementBufferObject() );
+      elements->setDataVariance( osg::Object::STATIC );
+      elements->setThreadSafeRefUnref( true );
+    }
+
+    typedef std::map< std::pair<unsigned,unsigned>, osg::ref_ptr<osg::DrawElements> > SurfaceMap;
+    typedef std::map< unsigned, osg::ref_ptr<osg::DrawElements> > SkirtMap;
+
+    Threading::Mutex _mutex;
+    SurfaceMap       _surfaces[2];
+    SkirtMap         _skirts;
+    unsigned         _users;
+  };
+
+  SharedIndexCache s_sharedIndices;
+}
+
+void
+SinglePassTerrainTechnique::addSharedIndexUser()
+{
+    s_sharedIndices.addUser();
+}
+
+void
+SinglePassTerrainTechnique::removeSharedIndexUser()
+{
+    s_sharedIndices.removeUser();
+}
+
+void
+SinglePassTerrainTechnique::releaseSharedIndexGLObjects( osg::State* state )
+{
+    s_sharedIndices.releaseGLObjects( state );
 }
 
 // --------------------------------------------------------------------------
@@ -841,21 +1113,49 @@ SinglePassTerrainTechnique::createGeometry( const TileFrame& tilef )
     typedef std::vector<int> Indices;
     Indices indices(numVerticesInSurface, -1);    
 
+    // pre-size the surface arrays; they are trimmed to the number of valid vertices below.
+    surfaceVerts->resize( numVerticesInSurface );
+    normals->resize( numVerticesInSurface );
+    elevations->resize( numVerticesInSurface );
+    if ( unifiedSurfaceTexCoords )
+        unifiedSurfaceTexCoords->resize( numVerticesInSurface );
+    for( RenderLayerVector::iterator r = renderLayers.begin(); r != renderLayers.end(); ++r )
+    {
+        if ( r->_ownsTexCoords )
+            r->_texCoords->resize( numVerticesInSurface );
+    }
+
+    // precompute the grid-to-model conversion terms, if the locator allows it.
+    GridTransformer grid;
+    bool useGrid = !isCube && grid.init( _masterLocator.get(), numColumns, numRows );
+
+    // masks whose NDC bounds overlap the current row:
+    std::vector<MaskRecord*> rowMasks;
+    rowMasks.reserve( masks.size() );
+
     // populate vertex and tex coord arrays    
-    unsigned int i, j; //, k=0;
+    unsigned int i, j, k=0;
     for(j=0; j<numRows; ++j)
     {
-        for(i=0; i<numColumns; ++i) // ++k)
+        double ndc_y = ((double)j)/(double)(numRows-1);
+        unsigned int j_equiv = j_sampleFactor==1.0 ? j : (unsigned int) (double(j)*j_sampleFactor);
+
+        rowMasks.clear();
+        for (MaskRecordVector::iterator mr = masks.begin(); mr != masks.end(); ++mr)
+        {
+            if ( ndc_y >= (*mr)._ndcMin.y() && ndc_y <= (*mr)._ndcMax.y() )
+                rowMasks.push_back( &(*mr) );
+        }
+
+        for(i=0; i<numColumns; ++i)
         {
             unsigned int iv = j*numColumns + i;
-            osg::Vec3d ndc( ((double)i)/(double)(numColumns-1), ((double)j)/(double)(numRows-1), 0.0);
+            osg::Vec3d ndc( ((double)i)/(double)(numColumns-1), ndc_y, 0.0);
      
             bool validValue = true;
             
             unsigned int i_equiv = i_sampleFactor==1.0 ? i : (unsigned int) (double(i)*i_sampleFactor);
 
-            unsigned int j_equiv = j_sampleFactor==1.0 ? j : (unsigned int) (double(j)*j_sampleFactor);
-
             if (elevationLayer)
             {
                 float value = 0.0f;
@@ -864,17 +1164,16 @@ SinglePassTerrainTechnique::createGeometry( const TileFrame& tilef )
             }
 
             //Invalidate if point falls within mask bounding box
-            if (validValue && masks.size() > 0)
+            if (validValue && rowMasks.size() > 0)
             {
-              for (MaskRecordVector::iterator mr = masks.begin(); mr != masks.end(); ++mr)
+              for (std::vector<MaskRecord*>::iterator mr = rowMasks.begin(); mr != rowMasks.end(); ++mr)
               {
-                if(ndc.x() >= (*mr)._ndcMin.x() && ndc.x() <= (*mr)._ndcMax.x() &&
-                   ndc.y() >= (*mr)._ndcMin.y() && ndc.y() <= (*mr)._ndcMax.y())
+                if(ndc.x() >= (*mr)->_ndcMin.x() && ndc.x() <= (*mr)->_ndcMax.x())
                 {
                   validValue = false;
                   indices[iv] = -2;
 
-                  (*mr)._internal->push_back(ndc);
+                  (*mr)->_internal->push_back(ndc);
 
                   break;
                 }
@@ -883,19 +1182,32 @@ SinglePassTerrainTechnique::createGeometry( const TileFrame& tilef )
             
             if (validValue)
             {
-                //indices[iv] = k;
-                indices[iv] = surfaceVerts->size();
+                indices[iv] = k;
             
-                osg::Vec3d model;
-                _masterLocator->convertLocalToModel(ndc, model);
+                osg::Vec3d model, up;
+                if ( useGrid )
+                {
+                    grid.transform( i, j, ndc.z(), model, up );
+                }
+                else
+                {
+                    _masterLocator->convertLocalToModel(ndc, model);
 
-                //(*surfaceVerts)[k] = model - centerModel;
-                (*surfaceVerts).push_back(model - _centerModel);
+                    // compute the local normal
+                    osg::Vec3d ndc_one = ndc; ndc_one.z() += 1.0;
+                    _masterLocator->convertLocalToModel(ndc_one, up);
+                    up = up - model;
+                    up.normalize();
+                }
+
+                (*surfaceVerts)[k] = model - _centerModel;
+                (*normals)[k] = up;
+                (*elevations)[k] = ndc.z();
 
                 if ( _texCompositor->requiresUnitTextureSpace() )
                 {
                     // the unified unit texture space requires a single, untransformed unit coord [0..1]
-                    (*unifiedSurfaceTexCoords).push_back( osg::Vec2( ndc.x(), ndc.y() ) );
+                    (*unifiedSurfaceTexCoords)[k].set( ndc.x(), ndc.y() );
                 }
                 else
                 {
@@ -904,40 +1216,37 @@ SinglePassTerrainTechnique::createGeometry( const TileFrame& tilef )
                     {
                         if ( r->_ownsTexCoords )
                         {
-                            //if ( r->_locator.get() != _masterLocator.get() )
-                            //if ( r->_locator->isEr->_locator != masterTextureLocator _masterLocator.get() )
                             if ( !r->_locator->isEquivalentTo( *masterTextureLocator.get() ) )
                             {
                                 osg::Vec3d color_ndc;
                                 osgTerrain::Locator::convertLocalCoordBetween( *masterTextureLocator.get(), ndc, *r->_locator.get(), color_ndc );
-                                r->_texCoords->push_back( osg::Vec2( color_ndc.x(), color_ndc.y() ) );
+                                (*r->_texCoords)[k].set( color_ndc.x(), color_ndc.y() );
                             }
                             else
                             {
-                                r->_texCoords->push_back( osg::Vec2( ndc.x(), ndc.y() ) );
+                                (*r->_texCoords)[k].set( ndc.x(), ndc.y() );
                             }
                         }
                     }
                 }
 
-                if (elevations.valid())
-                {
-                    (*elevations).push_back(ndc.z());
-                }
-
-                // compute the local normal
-                osg::Vec3d ndc_one = ndc; ndc_one.z() += 1.0;
-                osg::Vec3d model_one;
-                _masterLocator->convertLocalToModel(ndc_one, model_one);
-                model_one = model_one - model;
-                model_one.normalize();    
-
-                //(*normals)[k] = model_one;
-                (*normals).push_back(model_one);
+                ++k;
             }
         }
     }
 
+    // trim off the slots reserved for masked/invalid vertices.
+    surfaceVerts->resize( k );
+    normals->resize( k );
+    elevations->resize( k );
+    if ( unifiedSurfaceTexCoords )
+        unifiedSurfaceTexCoords->resize( k );
+    for( RenderLayerVector::iterator r = renderLayers.begin(); r != renderLayers.end(); ++r )
+    {
+        if ( r->_ownsTexCoords )
+            r->_texCoords->resize( k );
+    }
+
 
     for (MaskRecordVector::iterator mr = masks.begin(); mr != masks.end(); ++mr)
     {
@@ -1609,16 +1918,33 @@ SinglePassTerrainTechnique::createGeometry( const TileFrame& tilef )
     // populate primitive sets
     bool swapOrientation = !(_masterLocator->orientationOpenGL());
 
-    osg::ref_ptr<osg::DrawElementsUInt> elements = new osg::DrawElementsUInt(GL_TRIANGLES);
-    elements->reserve((numRows-1) * (numColumns-1) * 6);
+    // If every sample made it into the surface and the triangulation does not depend on
+    // the elevation values, the topology is identical to every other tile of this size
+    // and we can use a shared index buffer instead of building our own.
+    bool useSharedIndices =
+        masks.empty() &&
+        !_optimizeTriangleOrientation &&
+        surfaceVerts->size() == numVerticesInSurface;
 
-    surface->addPrimitiveSet(elements.get());
+    osg::ref_ptr<osg::DrawElementsUInt> elements;
+    if ( useSharedIndices )
+    {
+        surface->addPrimitiveSet( s_sharedIndices.getSurface(numRows, numColumns, swapOrientation) );
+    }
+    else
+    {
+        elements = new osg::DrawElementsUInt(GL_TRIANGLES);
+        elements->reserve((numRows-1) * (numColumns-1) * 6);
+        surface->addPrimitiveSet(elements.get());
+    }
     
     osg::ref_ptr<osg::Vec3Array> skirtVectors = new osg::Vec3Array( *normals );
 
           if (!normals)
         createSkirt = false;
     
+    bool sharedSkirt = false;
+
     // New separated skirts.
     if ( createSkirt )
     {        
@@ -1779,8 +2105,17 @@ SinglePassTerrainTechnique::createGeometry( const TileFrame& tilef )
 
         //Add a primative set for each continuous skirt strip
         skirtBreaks.push_back(skirtVerts->size());
-        for (int p=1; p < (int)skirtBreaks.size(); p++)
-          skirt->addPrimitiveSet( new osg::DrawArrays( GL_TRIANGLE_STRIP, skirtBreaks[p-1], skirtBreaks[p] - skirtBreaks[p-1] ) );
+        if ( skirtBreaks.size() == 2 && skirtVerts->size() > 2 )
+        {
+          // one unbroken strip around the tile; share the triangulated indices.
+          skirt->addPrimitiveSet( s_sharedIndices.getSkirt(skirtVerts->size()) );
+          sharedSkirt = true;
+        }
+        else
+        {
+          for (int p=1; p < (int)skirtBreaks.size(); p++)
+            skirt->addPrimitiveSet( new osg::DrawArrays( GL_TRIANGLE_STRIP, skirtBreaks[p-1], skirtBreaks[p] - skirtBreaks[p-1] ) );
+        }
     }
     
     bool recalcNormals = elevationLayer != NULL;
@@ -1859,13 +2194,16 @@ SinglePassTerrainTechnique::createGeometry( const TileFrame& tilef )
 
                 if (!_optimizeTriangleOrientation || (e00-e11)<fabsf(e01-e10))
                 {
-                    elements->push_back(i01);
-                    elements->push_back(i00);
-                    elements->push_back(i11);
+                    if (elements.valid())
+                    {
+                        elements->push_back(i01);
+                        elements->push_back(i00);
+                        elements->push_back(i11);
 
-                    elements->push_back(i00);
-                    elements->push_back(i10);
-                    elements->push_back(i11);
+                        elements->push_back(i00);
+                        elements->push_back(i10);
+                        elements->push_back(i11);
+                    }
 
                     if (recalcNormals)
                     {                        
@@ -1882,13 +2220,16 @@ SinglePassTerrainTechnique::createGeometry( const TileFrame& tilef )
                 }
                 else
                 {
-                    elements->push_back(i01);
-                    elements->push_back(i00);
-                    elements->push_back(i10);
+                    if (elements.valid())
+                    {
+                        elements->push_back(i01);
+                        elements->push_back(i00);
+                        elements->push_back(i10);
 
-                    elements->push_back(i01);
-                    elements->push_back(i10);
-                    elements->push_back(i11);
+                        elements->push_back(i01);
+                        elements->push_back(i10);
+                        elements->push_back(i11);
+                    }
 
                     if (recalcNormals)
                     {                       
@@ -1962,9 +2303,11 @@ SinglePassTerrainTechnique::createGeometry( const TileFrame& tilef )
 
   
 
-    MeshConsolidator::convertToTriangles( *surface );
+    // shared index sets are already triangle lists, and must not be replaced.
+    if ( !useSharedIndices )
+        MeshConsolidator::convertToTriangles( *surface );
 
-    if ( skirt )
+    if ( skirt && !sharedSkirt )
         MeshConsolidator::convertToTriangles( *skirt );
 
     for (MaskRecordVector::iterator mr = masks.begin(); mr != masks.end(); ++mr)
@@ -1977,6 +2320,22 @@ SinglePassTerrainTechnique::createGeometry( const TileFrame& tilef )
         osg::ref_ptr<osg::KdTreeBuilder> builder = osgDB::Registry::instance()->getKdTreeBuilder()->clone();
         geode->accept(*builder);
     }
+    else
+    {
+        // build a triangle hierarchy for each drawable so that intersections against
+        // the tile (camera collision, picking, clamping) don't have to test every
+        // triangle. This runs on the thread compiling the tile.
+        for( unsigned i = 0; i < geode->getNumDrawables(); ++i )
+        {
+            osg::Geometry* geom = geode->getDrawable(i)->asGeometry();
+            if ( geom && !geom->getShape() )
+            {
+                osg::ref_ptr<TriangleBVH> bvh = new TriangleBVH();
+                if ( bvh->build(geom) )
+                    geom->setShape( bvh.get() );
+            }
+        }
+    }
 
     return geode;
 }
@@ -2000,6 +2359,8 @@ SinglePassTerrainTechnique::releaseGLObjects(osg::State* state) const
 
     Threading::ScopedWriteLock lock( static_cast<Tile*>(ncThis->_tile)->getTileLayersMutex() );
 
+    // note: index sets from the shared cache ignore this; the terrain releases them
+    // (see releaseSharedIndexGLObjects).
     if ( _transform.valid() )
     {
         _transform->releaseGLObjects( state );
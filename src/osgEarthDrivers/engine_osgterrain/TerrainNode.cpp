@@ -19,6 +19,7 @@
 #include "TerrainNode"
 #include "Tile"
 #include "TransparentLayer"
+#include "SinglePassTerrainTechnique"
 
 #include <osgEarth/Registry>
 #include <osgEarth/Map>
@@ -110,6 +111,8 @@ _verticalScale( 1.0f )
 
     // register for events in order to support ON_DEMAND frame scheme
     setNumChildrenRequiringEventTraversal( 1 );    
+
+    SinglePassTerrainTechnique::addSharedIndexUser();
 }
 
 TerrainNode::~TerrainNode()
@@ -121,6 +124,18 @@ TerrainNode::~TerrainNode()
         i->second->attachToTerrain( 0L );
     }
     _tiles.clear();
+
+    SinglePassTerrainTechnique::removeSharedIndexUser();
+}
+
+void
+TerrainNode::releaseGLObjects( osg::State* state ) const
+{
+    osg::Group::releaseGLObjects( state );
+
+    // called when a graphics context closes; the tiles leave the shared index
+    // sets alone, so release them here.
+    SinglePassTerrainTechnique::releaseSharedIndexGLObjects( state );
 }
 
 void
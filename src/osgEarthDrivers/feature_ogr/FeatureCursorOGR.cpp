@@ -35,7 +35,8 @@ FeatureCursorOGR::FeatureCursorOGR(OGRDataSourceH           dsHandle,
                                    const FeatureSource*     source,
                                    const FeatureProfile*    profile,
                                    const Symbology::Query&  query,
-                                   const FeatureFilterList& filters ) :
+                                   const FeatureFilterList& filters,
+                                   bool                     columnarAttributes ) :
 _source           ( source ),
 _dsHandle         ( dsHandle ),
 _layerHandle      ( layerHandle ),
@@ -45,7 +46,8 @@ _query            ( query ),
 _chunkSize        ( 500 ),
 _nextHandleToQueue( 0L ),
 _profile          ( profile ),
-_filters          ( filters )
+_filters          ( filters ),
+_columnarAttributes( columnarAttributes )
 {
     {
         OGR_SCOPED_LOCK;
@@ -173,9 +175,15 @@ FeatureCursorOGR::readChunk()
     
     OGR_SCOPED_LOCK;
 
+    // Each chunk gets its own attribute store, which is complete (and never
+    // modified again) by the time its features leave the cursor.
+    osg::ref_ptr<AttributeStore> store;
+    if ( _columnarAttributes )
+        store = OgrUtils::createAttributeStore( OGR_L_GetLayerDefn(_resultSetHandle) );
+
     if ( _nextHandleToQueue )
     {
-        osg::ref_ptr<Feature> f = OgrUtils::createFeature( _nextHandleToQueue, _profile->getSRS() );
+        osg::ref_ptr<Feature> f = OgrUtils::createFeature( _nextHandleToQueue, _profile->getSRS(), store.get() );
         if ( f.valid() && !_source->isBlacklisted(f->getFID()) )
         {
             _queue.push( f );
@@ -194,7 +202,7 @@ FeatureCursorOGR::readChunk()
         OGRFeatureH handle = OGR_L_GetNextFeature( _resultSetHandle );
         if ( handle )
         {
-            osg::ref_ptr<Feature> f = OgrUtils::createFeature( handle, _profile->getSRS() );
+            osg::ref_ptr<Feature> f = OgrUtils::createFeature( handle, _profile->getSRS(), store.get() );
             if ( f.valid() && !_source->isBlacklisted(f->getFID()) )
             {
                 _queue.push( f );
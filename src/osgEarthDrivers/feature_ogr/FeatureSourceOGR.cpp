@@ -295,7 +295,8 @@ public:
                     this,
                     getFeatureProfile(),
                     query, 
-                    _options.filters() );
+                    _options.filters(),
+                    _options.columnarAttributes() == true );
             }
             else
             {
@@ -357,7 +358,8 @@ public:
         OGRFeatureH feature_handle = OGR_F_Create( OGR_L_GetLayerDefn( _layerHandle ) );
         if ( feature_handle )
         {
-            const AttributeTable& attrs = feature->getAttrs();
+            AttributeTable attrs;
+            feature->copyAttrs( attrs );
 
             // assign the attributes:
             int num_fields = OGR_F_GetFieldCount( feature_handle );
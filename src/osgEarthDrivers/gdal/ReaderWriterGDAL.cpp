@@ -22,6 +22,9 @@
 #include <osgEarth/Registry>
 #include <osgEarth/ImageUtils>
 #include <osgEarth/URI>
+#include <osgEarth/Cache>
+#include <osgEarth/IOTypes>
+#include <osgEarth/StringUtils>
 
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
@@ -31,6 +34,9 @@
 #include <osgDB/ImageOptions>
 
 #include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
 #include <stdlib.h>
 #include <memory.h>
 
@@ -114,6 +120,27 @@ typedef struct
     double                 noDataValue;
 } BandProperty;
 
+// Band characteristics of one file in a mosaic.
+struct MosaicBand
+{
+    int    colorInterpretation;
+    int    dataType;
+    int    colorTableSize;      // -1 if the band has no color table
+    int    bHasNoData;
+    double noDataValue;
+};
+
+// Everything build_vrt needs to know about one file in a mosaic. Gathering
+// it means opening the file, so the mosaic index caches these between runs.
+struct MosaicFile
+{
+    std::string             name;
+    time_t                  modTime;
+    std::string             projection;
+    DatasetProperty         properties;
+    std::vector<MosaicBand> bands;
+};
+
 static void
 getFiles(const std::string &file, const std::vector<std::string> &exts, std::vector<std::string> &files)
 {
@@ -181,12 +208,85 @@ getFiles(const std::string &file, const std::vector<std::string> &exts, std::vec
  * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
  * DEALINGS IN THE SOFTWARE.
  ****************************************************************************/
+// Opens a file and reads the georeferencing and band information that
+// build_vrt needs. Sets properties.isFileOK to FALSE if the file is unusable.
+static void
+scan_file(MosaicFile& file)
+{
+    const char* dsFileName = file.name.c_str();
+    DatasetProperty& props = file.properties;
+    props.isFileOK = FALSE;
+    file.projection.clear();
+    file.bands.clear();
+
+    GDALDatasetH hDS = GDALOpen(dsFileName, GA_ReadOnly );
+    if (!hDS)
+    {
+        fprintf( stderr, "Warning : can't open %s. Skipping it\n", dsFileName);
+        return;
+    }
+
+    const char* proj = GDALGetProjectionRef(hDS);
+    if (proj && strlen(proj) > 0)
+    {
+        file.projection = proj;
+    }
+    else
+    {
+        std::string prjLocation = osgDB::getNameLessExtension( file.name ) + std::string(".prj");
+        ReadResult r = URI(prjLocation).readString();
+        if ( r.succeeded() )
+        {
+            file.projection = r.getString();
+        }
+    }
+
+    GDALGetGeoTransform(hDS, props.adfGeoTransform);
+    if (props.adfGeoTransform[GEOTRSFRM_ROTATION_PARAM1] != 0 ||
+        props.adfGeoTransform[GEOTRSFRM_ROTATION_PARAM2] != 0)
+    {
+        fprintf( stderr, "GDAL Driver does not support rotated geo transforms. Skipping %s\n",
+                     dsFileName);
+        GDALClose(hDS);
+        return;
+    }
+    if (props.adfGeoTransform[GEOTRSFRM_NS_RES] >= 0)
+    {
+        fprintf( stderr, "GDAL Driver does not support positive NS resolution. Skipping %s\n",
+                     dsFileName);
+        GDALClose(hDS);
+        return;
+    }
+    props.nRasterXSize = GDALGetRasterXSize(hDS);
+    props.nRasterYSize = GDALGetRasterYSize(hDS);
+
+    GDALGetBlockSize(GDALGetRasterBand( hDS, 1 ),
+                     &props.nBlockXSize,
+                     &props.nBlockYSize);
+
+    int nBands = GDALGetRasterCount(hDS);
+    file.bands.resize(nBands);
+    for(int j=0;j<nBands;j++)
+    {
+        GDALRasterBandH hRasterBand = GDALGetRasterBand( hDS, j+1 );
+        MosaicBand& band = file.bands[j];
+        band.colorInterpretation = GDALGetRasterColorInterpretation(hRasterBand);
+        band.dataType = GDALGetRasterDataType(hRasterBand);
+        GDALColorTableH colorTable = GDALGetRasterColorTable(hRasterBand);
+        band.colorTableSize = colorTable ? GDALGetColorEntryCount(colorTable) : -1;
+        band.noDataValue = GDALGetRasterNoDataValue(hRasterBand, &band.bHasNoData);
+    }
+
+    props.isFileOK = TRUE;
+    GDALClose(hDS);
+}
+
 static GDALDatasetH
-build_vrt(std::vector<std::string> &files, ResolutionStrategy resolutionStrategy)
+build_vrt(std::vector<MosaicFile> &files, ResolutionStrategy resolutionStrategy)
 {
     GDAL_SCOPED_LOCK;
 
-    char* projectionRef = NULL;
+    std::string projectionRef;
     int nBands = 0;
     BandProperty* bandProperties = NULL;
     double minX = 0, minY = 0, maxX = 0, maxY = 0;
@@ -201,172 +301,136 @@ build_vrt(std::vector<std::string> &files, ResolutionStrategy resolutionStrategy
 
     int nInputFiles = files.size();
 
-    DatasetProperty* psDatasetProperties =
-            (DatasetProperty*) CPLMalloc(nInputFiles*sizeof(DatasetProperty));
+    // files that pass the homogeneity checks against the first one:
+    std::vector<bool> included(nInputFiles, false);
 
     for(i=0;i<nInputFiles;i++)
     {
-        const char* dsFileName = files[i].c_str();
+        const MosaicFile& file = files[i];
+        const DatasetProperty& props = file.properties;
+        const char* dsFileName = file.name.c_str();
 
-        GDALTermProgress( 1.0 * (i+1) / nInputFiles, NULL, NULL);
+        if (!props.isFileOK)
+            continue;
 
-        GDALDatasetH hDS = GDALOpen(dsFileName, GA_ReadOnly );
-        psDatasetProperties[i].isFileOK = FALSE;
+        double product_minX = props.adfGeoTransform[GEOTRSFRM_TOPLEFT_X];
+        double product_maxY = props.adfGeoTransform[GEOTRSFRM_TOPLEFT_Y];
+        double product_maxX = product_minX +
+                    props.nRasterXSize * props.adfGeoTransform[GEOTRSFRM_WE_RES];
+        double product_minY = product_maxY +
+                    props.nRasterYSize * props.adfGeoTransform[GEOTRSFRM_NS_RES];
 
-        if (hDS)
+        if (bFirst)
         {
-            const char* proj = GDALGetProjectionRef(hDS);
-            if (!proj || strlen(proj) == 0)
-            {                
-                std::string prjLocation = osgDB::getNameLessExtension( std::string(dsFileName) ) + std::string(".prj");
-                ReadResult r = URI(prjLocation).readString();
-                if ( r.succeeded() )
-                {
-                    proj = CPLStrdup( r.getString().c_str() );
-                }                
-            }
-
-            GDALGetGeoTransform(hDS, psDatasetProperties[i].adfGeoTransform);
-            if (psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_ROTATION_PARAM1] != 0 ||
-                psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_ROTATION_PARAM2] != 0)
-            {
-                fprintf( stderr, "GDAL Driver does not support rotated geo transforms. Skipping %s\n",
-                             dsFileName);
-                GDALClose(hDS);
-                continue;
-            }
-            if (psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_NS_RES] >= 0)
+            projectionRef = file.projection;
+            minX = product_minX;
+            minY = product_minY;
+            maxX = product_maxX;
+            maxY = product_maxY;
+            nBands = file.bands.size();
+            bandProperties = (BandProperty*)CPLMalloc(nBands*sizeof(BandProperty));
+            for(j=0;j<nBands;j++)
             {
-                fprintf( stderr, "GDAL Driver does not support positive NS resolution. Skipping %s\n",
-                             dsFileName);
-                GDALClose(hDS);
-                continue;
+                bandProperties[j].colorInterpretation = (GDALColorInterp)file.bands[j].colorInterpretation;
+                bandProperties[j].dataType = (GDALDataType)file.bands[j].dataType;
+                bandProperties[j].colorTable = 0;
+                bandProperties[j].bHasNoData = file.bands[j].bHasNoData;
+                bandProperties[j].noDataValue = file.bands[j].noDataValue;
             }
-            psDatasetProperties[i].nRasterXSize = GDALGetRasterXSize(hDS);
-            psDatasetProperties[i].nRasterYSize = GDALGetRasterYSize(hDS);
-            double product_minX = psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_TOPLEFT_X];
-            double product_maxY = psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_TOPLEFT_Y];
-            double product_maxX = product_minX +
-                        GDALGetRasterXSize(hDS) * psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_WE_RES];
-            double product_minY = product_maxY +
-                        GDALGetRasterYSize(hDS) * psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_NS_RES];
-
-            GDALGetBlockSize(GDALGetRasterBand( hDS, 1 ),
-                             &psDatasetProperties[i].nBlockXSize,
-                             &psDatasetProperties[i].nBlockYSize);
 
-            if (bFirst)
+            // the index only records the size of a color table, so open the
+            // file to copy the palette itself.
+            bool hasPalette = false;
+            for(j=0;j<nBands;j++)
+                hasPalette = hasPalette || (bandProperties[j].colorInterpretation == GCI_PaletteIndex && file.bands[j].colorTableSize >= 0);
+            if (hasPalette)
             {
-                if (proj)
-                    projectionRef = CPLStrdup(proj);
-                minX = product_minX;
-                minY = product_minY;
-                maxX = product_maxX;
-                maxY = product_maxY;
-                nBands = GDALGetRasterCount(hDS);
-                bandProperties = (BandProperty*)CPLMalloc(nBands*sizeof(BandProperty));
-                for(j=0;j<nBands;j++)
+                GDALDatasetH hDS = GDALOpen(dsFileName, GA_ReadOnly );
+                for(j=0;j<nBands && hDS;j++)
                 {
-                    GDALRasterBandH hRasterBand = GDALGetRasterBand( hDS, j+1 );
-                    bandProperties[j].colorInterpretation = GDALGetRasterColorInterpretation(hRasterBand);
-                    bandProperties[j].dataType = GDALGetRasterDataType(hRasterBand);
                     if (bandProperties[j].colorInterpretation == GCI_PaletteIndex)
                     {
-                        bandProperties[j].colorTable = GDALGetRasterColorTable( hRasterBand );
-                        if (bandProperties[j].colorTable)
-                        {
-                            bandProperties[j].colorTable = GDALCloneColorTable(bandProperties[j].colorTable);
-                        }
+                        GDALColorTableH colorTable = GDALGetRasterColorTable( GDALGetRasterBand( hDS, j+1 ) );
+                        if (colorTable)
+                            bandProperties[j].colorTable = GDALCloneColorTable(colorTable);
                     }
-                    else
-                        bandProperties[j].colorTable = 0;
-                    bandProperties[j].noDataValue = GDALGetRasterNoDataValue(hRasterBand, &bandProperties[j].bHasNoData);
                 }
+                if (hDS)
+                    GDALClose(hDS);
             }
-            else
+        }
+        else
+        {
+            if (file.projection != projectionRef &&
+                (file.projection.empty() || projectionRef.empty() || EQUAL(file.projection.c_str(), projectionRef.c_str()) == FALSE))
             {
-                if ((proj != NULL && projectionRef == NULL) ||
-                    (proj == NULL && projectionRef != NULL) ||
-                    (proj != NULL && projectionRef != NULL && EQUAL(proj, projectionRef) == FALSE))
-                {
-                    fprintf( stderr, "gdalbuildvrt does not support heterogenous projection. Skipping %s\n",dsFileName);
-                    GDALClose(hDS);
-                    continue;
-                }
-                int _nBands = GDALGetRasterCount(hDS);
-                if (nBands != _nBands)
+                fprintf( stderr, "gdalbuildvrt does not support heterogenous projection. Skipping %s\n",dsFileName);
+                continue;
+            }
+            int _nBands = file.bands.size();
+            if (nBands != _nBands)
+            {
+                fprintf( stderr, "gdalbuildvrt does not support heterogenous band numbers. Skipping %s\n",
+                         dsFileName);
+                continue;
+            }
+            for(j=0;j<nBands;j++)
+            {
+                const MosaicBand& band = file.bands[j];
+                if (bandProperties[j].colorInterpretation != band.colorInterpretation ||
+                    bandProperties[j].dataType != band.dataType)
                 {
-                    fprintf( stderr, "gdalbuildvrt does not support heterogenous band numbers. Skipping %s\n",
-                             dsFileName);
-                    GDALClose(hDS);
-                    continue;
+                    fprintf( stderr, "gdalbuildvrt does not support heterogenous band characteristics. Skipping %s\n",
+                         dsFileName);
+                    break;
                 }
-                for(j=0;j<nBands;j++)
+                if (bandProperties[j].colorTable)
                 {
-                    GDALRasterBandH hRasterBand = GDALGetRasterBand( hDS, j+1 );
-                    if (bandProperties[j].colorInterpretation != GDALGetRasterColorInterpretation(hRasterBand) ||
-                        bandProperties[j].dataType != GDALGetRasterDataType(hRasterBand))
+                    if (band.colorTableSize != GDALGetColorEntryCount(bandProperties[j].colorTable))
                     {
                         fprintf( stderr, "gdalbuildvrt does not support heterogenous band characteristics. Skipping %s\n",
-                             dsFileName);
-                        GDALClose(hDS);
-                    }
-                    if (bandProperties[j].colorTable)
-                    {
-                        GDALColorTableH colorTable = GDALGetRasterColorTable( hRasterBand );
-                        if (colorTable == NULL ||
-                            GDALGetColorEntryCount(colorTable) != GDALGetColorEntryCount(bandProperties[j].colorTable))
-                        {
-                            fprintf( stderr, "gdalbuildvrt does not support heterogenous band characteristics. Skipping %s\n",
-                             dsFileName);
-                            GDALClose(hDS);
-                            break;
-                        }
-                        /* We should check that the palette are the same too ! */
+                         dsFileName);
+                        break;
                     }
+                    /* We should check that the palette are the same too ! */
                 }
-                if (j != nBands)
-                    continue;
-                if (product_minX < minX) minX = product_minX;
-                if (product_minY < minY) minY = product_minY;
-                if (product_maxX > maxX) maxX = product_maxX;
-                if (product_maxY > maxY) maxY = product_maxY;
             }
-            if (resolutionStrategy == AVERAGE_RESOLUTION)
+            if (j != nBands)
+                continue;
+            if (product_minX < minX) minX = product_minX;
+            if (product_minY < minY) minY = product_minY;
+            if (product_maxX > maxX) maxX = product_maxX;
+            if (product_maxY > maxY) maxY = product_maxY;
+        }
+        if (resolutionStrategy == AVERAGE_RESOLUTION)
+        {
+            we_res += props.adfGeoTransform[GEOTRSFRM_WE_RES];
+            ns_res += props.adfGeoTransform[GEOTRSFRM_NS_RES];
+        }
+        else
+        {
+            if (bFirst)
+            {
+                we_res = props.adfGeoTransform[GEOTRSFRM_WE_RES];
+                ns_res = props.adfGeoTransform[GEOTRSFRM_NS_RES];
+            }
+            else if (resolutionStrategy == HIGHEST_RESOLUTION)
             {
-                we_res += psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_WE_RES];
-                ns_res += psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_NS_RES];
+                we_res = MIN(we_res, props.adfGeoTransform[GEOTRSFRM_WE_RES]);
+                /* Yes : as ns_res is negative, the highest resolution is the max value */
+                ns_res = MAX(ns_res, props.adfGeoTransform[GEOTRSFRM_NS_RES]);
             }
             else
             {
-                if (bFirst)
-                {
-                    we_res = psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_WE_RES];
-                    ns_res = psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_NS_RES];
-                }
-                else if (resolutionStrategy == HIGHEST_RESOLUTION)
-                {
-                    we_res = MIN(we_res, psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_WE_RES]);
-                    /* Yes : as ns_res is negative, the highest resolution is the max value */
-                    ns_res = MAX(ns_res, psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_NS_RES]);
-                }
-                else
-                {
-                    we_res = MAX(we_res, psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_WE_RES]);
-                    /* Yes : as ns_res is negative, the lowest resolution is the min value */
-                    ns_res = MIN(ns_res, psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_NS_RES]);
-                }
+                we_res = MAX(we_res, props.adfGeoTransform[GEOTRSFRM_WE_RES]);
+                /* Yes : as ns_res is negative, the lowest resolution is the min value */
+                ns_res = MIN(ns_res, props.adfGeoTransform[GEOTRSFRM_NS_RES]);
             }
-
-            psDatasetProperties[i].isFileOK = 1;
-            nCount ++;
-            bFirst = FALSE;
-            GDALClose(hDS);
-        }
-        else
-        {
-            fprintf( stderr, "Warning : can't open %s. Skipping it\n", dsFileName);
         }
+
+        included[i] = true;
+        nCount ++;
+        bFirst = FALSE;
     }
     
     if (nCount == 0)
@@ -383,10 +447,10 @@ build_vrt(std::vector<std::string> &files, ResolutionStrategy resolutionStrategy
     
     hVRTDS = VRTCreate(rasterXSize, rasterYSize);
     
-    if (projectionRef)
+    if (!projectionRef.empty())
     {
         //OE_NOTICE << "Setting projection to " << projectionRef << std::endl;
-        GDALSetProjection(hVRTDS, projectionRef);
+        GDALSetProjection(hVRTDS, projectionRef.c_str());
     }
     
     double adfGeoTransform[6];
@@ -414,9 +478,10 @@ build_vrt(std::vector<std::string> &files, ResolutionStrategy resolutionStrategy
 
     for(i=0;i<nInputFiles;i++)
     {
-        if (psDatasetProperties[i].isFileOK == 0)
+        if (!included[i])
             continue;
-        const char* dsFileName = files[i].c_str();
+        const char* dsFileName = files[i].name.c_str();
+        DatasetProperty& props = files[i].properties;
 
         bool isProxy = true;
 
@@ -425,17 +490,18 @@ build_vrt(std::vector<std::string> &files, ResolutionStrategy resolutionStrategy
         //Use a proxy dataset if possible.  This helps with huge amount of files to keep the # of handles down
         GDALProxyPoolDatasetH hDS =
                GDALProxyPoolDatasetCreate(dsFileName,
-                                         psDatasetProperties[i].nRasterXSize,
-                                         psDatasetProperties[i].nRasterYSize,
-                                         GA_ReadOnly, TRUE, projectionRef,
-                                         psDatasetProperties[i].adfGeoTransform);
+                                         props.nRasterXSize,
+                                         props.nRasterYSize,
+                                         GA_ReadOnly, TRUE,
+                                         projectionRef.empty() ? NULL : projectionRef.c_str(),
+                                         props.adfGeoTransform);
 
         for(j=0;j<nBands;j++)
         {
             GDALProxyPoolDatasetAddSrcBandDescription(hDS,
                                             bandProperties[j].dataType,
-                                            psDatasetProperties[i].nBlockXSize,
-                                            psDatasetProperties[i].nBlockYSize);
+                                            props.nBlockXSize,
+                                            props.nBlockYSize);
         }
         isProxy = true;
         OE_DEBUG << LC << "Using GDALProxyPoolDatasetH" << std::endl;
@@ -450,13 +516,13 @@ build_vrt(std::vector<std::string> &files, ResolutionStrategy resolutionStrategy
 #endif
 
         int xoffset = (int)
-                (0.5 + (psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_TOPLEFT_X] - minX) / we_res);
+                (0.5 + (props.adfGeoTransform[GEOTRSFRM_TOPLEFT_X] - minX) / we_res);
         int yoffset = (int)
-                (0.5 + (maxY - psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_TOPLEFT_Y]) / -ns_res);
+                (0.5 + (maxY - props.adfGeoTransform[GEOTRSFRM_TOPLEFT_Y]) / -ns_res);
         int dest_width = (int)
-                (0.5 + psDatasetProperties[i].nRasterXSize * psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_WE_RES] / we_res);
+                (0.5 + props.nRasterXSize * props.adfGeoTransform[GEOTRSFRM_WE_RES] / we_res);
         int dest_height = (int)
-                (0.5 + psDatasetProperties[i].nRasterYSize * psDatasetProperties[i].adfGeoTransform[GEOTRSFRM_NS_RES] / ns_res);
+                (0.5 + props.nRasterYSize * props.adfGeoTransform[GEOTRSFRM_NS_RES] / ns_res);
 
         for(j=0;j<nBands;j++)
         {
@@ -465,8 +531,8 @@ build_vrt(std::vector<std::string> &files, ResolutionStrategy resolutionStrategy
             /* Place the raster band at the right position in the VRT */
             VRTAddSimpleSource(hVRTBand, GDALGetRasterBand((GDALDatasetH)hDS, j + 1),
                                0, 0,
-                               psDatasetProperties[i].nRasterXSize,
-                               psDatasetProperties[i].nRasterYSize,
+                               props.nRasterXSize,
+                               props.nRasterYSize,
                                xoffset, yoffset,
                                dest_width, dest_height, "near",
                                VRT_NODATA_UNSET);
@@ -478,16 +544,156 @@ build_vrt(std::vector<std::string> &files, ResolutionStrategy resolutionStrategy
         }
     }
 end:
-    CPLFree(psDatasetProperties);
     for(j=0;j<nBands;j++)
     {
-        GDALDestroyColorTable(bandProperties[j].colorTable);
+        if (bandProperties[j].colorTable)
+            GDALDestroyColorTable(bandProperties[j].colorTable);
     }
     CPLFree(bandProperties);
-    CPLFree(projectionRef);
     return hVRTDS;
 }
 
+// The mosaic index caches the result of scan_file() for every file in a
+// multi-file layer, so that a warm start only has to open the files that
+// were added or modified since the index was written.
+#define MOSAIC_INDEX_HEADER "osgearth_gdal_mosaic_index 2"
+
+static void
+writeIndexString(std::ostream& out, const std::string& str)
+{
+    out << str.size() << "\n" << str << "\n";
+}
+
+static bool
+readIndexString(std::istream& in, std::string& str)
+{
+    unsigned len;
+    if ( !(in >> len) || in.get() != '\n' )
+        return false;
+    str.resize(len);
+    if ( len > 0 && !in.read(&str[0], len) )
+        return false;
+    return in.get() == '\n';
+}
+
+// Doubles that may not be finite (no-data values are often NaN or +/-Inf) do not
+// survive a trip through << and >>, so store their raw 64-bit pattern in hex.
+static void
+writeIndexDouble(std::ostream& out, double value)
+{
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    out << std::hex << bits << std::dec;
+}
+
+static bool
+readIndexDouble(std::istream& in, double& value)
+{
+    unsigned long long bits;
+    if ( !(in >> std::hex >> bits >> std::dec) )
+        return false;
+    memcpy(&value, &bits, sizeof(value));
+    return true;
+}
+
+static std::string
+writeMosaicIndex(const std::vector<MosaicFile>& files)
+{
+    // projections are usually shared by every file, so store each once.
+    std::vector<std::string> projections;
+    std::vector<unsigned>    projIndex(files.size());
+    for(unsigned i=0; i<files.size(); ++i)
+    {
+        unsigned p = std::find(projections.begin(), projections.end(), files[i].projection) - projections.begin();
+        if ( p == projections.size() )
+            projections.push_back( files[i].projection );
+        projIndex[i] = p;
+    }
+
+    std::stringstream buf;
+    buf << std::setprecision(17);
+    buf << MOSAIC_INDEX_HEADER << "\n" << projections.size() << "\n";
+    for(unsigned i=0; i<projections.size(); ++i)
+        writeIndexString(buf, projections[i]);
+
+    buf << files.size() << "\n";
+    for(unsigned i=0; i<files.size(); ++i)
+    {
+        const MosaicFile& file = files[i];
+        const DatasetProperty& props = file.properties;
+        writeIndexString(buf, file.name);
+        buf << (long long)file.modTime << " " << projIndex[i] << " " << props.isFileOK;
+        for(unsigned k=0; k<6; ++k)
+            buf << " " << props.adfGeoTransform[k];
+        buf << " " << props.nRasterXSize << " " << props.nRasterYSize
+            << " " << props.nBlockXSize  << " " << props.nBlockYSize
+            << " " << file.bands.size();
+        for(unsigned j=0; j<file.bands.size(); ++j)
+        {
+            const MosaicBand& band = file.bands[j];
+            buf << " " << band.colorInterpretation << " " << band.dataType
+                << " " << band.colorTableSize << " " << band.bHasNoData << " ";
+            writeIndexDouble(buf, band.noDataValue);
+        }
+        buf << "\n";
+    }
+    return buf.str();
+}
+
+static bool
+readMosaicIndex(const std::string& str, std::vector<MosaicFile>& out_files)
+{
+    std::stringstream buf(str);
+    std::string header;
+    if ( !std::getline(buf, header) || header != MOSAIC_INDEX_HEADER )
+        return false;
+
+    unsigned numProjections;
+    if ( !(buf >> numProjections) )
+        return false;
+    std::vector<std::string> projections(numProjections);
+    for(unsigned i=0; i<numProjections; ++i)
+    {
+        if ( !readIndexString(buf, projections[i]) )
+            return false;
+    }
+
+    unsigned numFiles;
+    if ( !(buf >> numFiles) || numFiles > str.size() )
+        return false;
+    out_files.resize(numFiles);
+    for(unsigned i=0; i<numFiles; ++i)
+    {
+        MosaicFile& file = out_files[i];
+        DatasetProperty& props = file.properties;
+        long long modTime;
+        unsigned  p, nBands;
+        if ( !readIndexString(buf, file.name) )
+            return false;
+        buf >> modTime >> p >> props.isFileOK;
+        for(unsigned k=0; k<6; ++k)
+            buf >> props.adfGeoTransform[k];
+        buf >> props.nRasterXSize >> props.nRasterYSize
+            >> props.nBlockXSize  >> props.nBlockYSize
+            >> nBands;
+        if ( !buf || p >= projections.size() || nBands > str.size() )
+            return false;
+        file.modTime = (time_t)modTime;
+        file.projection = projections[p];
+        file.bands.resize(nBands);
+        for(unsigned j=0; j<nBands; ++j)
+        {
+            MosaicBand& band = file.bands[j];
+            buf >> band.colorInterpretation >> band.dataType
+                >> band.colorTableSize >> band.bHasNoData;
+            if ( !readIndexDouble(buf, band.noDataValue) )
+                return false;
+        }
+        if ( !buf )
+            return false;
+    }
+    return true;
+}
 
 // This is simply the method GDALAutoCreateWarpedVRT() with the GDALSuggestedWarpOutput
 // logic replaced with something that will work properly for polar projections.
@@ -695,7 +901,69 @@ public:
         //If we found more than one file, try to combine them into a single logical dataset
         if (files.size() > 1)
         {
-            _srcDS = (GDALDataset*)build_vrt(files, HIGHEST_RESOLUTION);
+            // Opening every file is the slow part, so reuse the cached index
+            // entries for files whose modification time has not changed.
+            // The index follows the layer's cache policy (usage and max age).
+            CachePolicy indexPolicy( CachePolicy::USAGE_DEFAULT );
+            optional<CachePolicy> layerPolicy;
+            if ( CachePolicy::fromOptions(dbOptions, layerPolicy) )
+            {
+                if ( layerPolicy->usage().isSet() )
+                    indexPolicy.usage() = *layerPolicy->usage();
+                if ( layerPolicy->maxAge().isSet() )
+                    indexPolicy.maxAge() = *layerPolicy->maxAge();
+            }
+
+            osg::ref_ptr<CacheBin> indexBin;
+            std::string indexKey;
+            Cache* cache = Cache::get( dbOptions );
+            if ( cache && indexPolicy.usage() != CachePolicy::USAGE_NO_CACHE )
+            {
+                indexBin = cache->getOrCreateDefaultBin();
+                indexKey = Stringify() << "gdal_mosaic_" << std::hex << hashString(uri.full() + ";" + *_options.extensions());
+            }
+
+            std::map<std::string, MosaicFile> indexed;
+            if ( indexBin.valid() && indexPolicy.isCacheReadable() )
+            {
+                ReadResult r = indexBin->readString( indexKey, *indexPolicy.maxAge() );
+                std::vector<MosaicFile> cached;
+                if ( r.succeeded() && readMosaicIndex(r.getString(), cached) )
+                {
+                    for(unsigned i=0; i<cached.size(); ++i)
+                        indexed[cached[i].name] = cached[i];
+                }
+            }
+
+            std::vector<MosaicFile> mosaic(files.size());
+            unsigned numScanned = 0;
+            for(unsigned i=0; i<files.size(); ++i)
+            {
+                MosaicFile& file = mosaic[i];
+                file.name = files[i];
+                if ( !getLastModifiedTime(file.name, file.modTime) )
+                    file.modTime = 0;
+
+                std::map<std::string, MosaicFile>::const_iterator itr = indexed.find(file.name);
+                if ( itr != indexed.end() && file.modTime != 0 && itr->second.modTime == file.modTime )
+                {
+                    file = itr->second;
+                }
+                else
+                {
+                    scan_file(file);
+                    ++numScanned;
+                }
+            }
+
+            OE_INFO << LC << "Scanned " << numScanned << " of " << files.size() << " files for the mosaic index" << std::endl;
+
+            if ( indexBin.valid() && indexPolicy.isCacheWriteable() && (numScanned > 0 || indexed.size() != files.size()) )
+            {
+                indexBin->write( indexKey, new StringObject(writeMosaicIndex(mosaic)) );
+            }
+
+            _srcDS = (GDALDataset*)build_vrt(mosaic, HIGHEST_RESOLUTION);
             if (!_srcDS)
             {
                 OE_WARN << "[osgEarth::GDAL] Failed to build VRT from input datasets" << std::endl;
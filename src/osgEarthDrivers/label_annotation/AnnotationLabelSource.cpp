@@ -115,13 +115,23 @@ public:
             {
                 const std::string& value = i->first;
                 const Feature* feature = i->second.second.get();
-                group->addChild( makeLabelNode(context, feature, value, text, priorityExpr) );
+                double priority = text->priority().isSet() ? feature->eval(priorityExpr, &context) : 0.0;
+                group->addChild( makeLabelNode(context, feature, value, text, priority) );
             }
         }
 
         else
         {
-            for( FeatureList::const_iterator i = input.begin(); i != input.end(); ++i )
+            // evaluate the label expressions up front, so scripts run in a batch.
+            std::vector<std::string> values;
+            Feature::eval( contentExpr, input, &context, values );
+
+            std::vector<double> priorities;
+            if ( text->priority().isSet() )
+                Feature::eval( priorityExpr, input, &context, priorities );
+
+            unsigned n = 0;
+            for( FeatureList::const_iterator i = input.begin(); i != input.end(); ++i, ++n )
             {
                 const Feature* feature = i->get();
                 if ( !feature )
@@ -131,11 +141,11 @@ public:
                 if ( !geom )
                     continue;
 
-                const std::string& value = feature->eval( contentExpr, &context );
+                const std::string& value = values[n];
                 if ( value.empty() )
                     continue;
 
-                group->addChild( makeLabelNode(context, feature, value, text, priorityExpr) );
+                group->addChild( makeLabelNode(context, feature, value, text, priorities.empty() ? 0.0 : priorities[n]) );
             }
         }
 
@@ -153,7 +163,7 @@ public:
                              const Feature*       feature, 
                              const std::string&   value, 
                              const TextSymbol*    text, 
-                             NumericExpression&   priorityExpr )
+                             double               priority )
     {
         LabelNode* labelNode = new LabelNode(
             context.getSession()->getMapInfo().getProfile()->getSRS(),
@@ -164,7 +174,7 @@ public:
         if ( text->priority().isSet() )
         {
             AnnotationData* data = new AnnotationData();
-            data->setPriority( feature->eval(priorityExpr, &context) );
+            data->setPriority( priority );
             labelNode->setAnnotationData( data );
         }
 
@@ -105,7 +105,15 @@ public:
             makeECEF = context.getSession()->getMapInfo().isGeocentric();
         }
 
-        for( FeatureList::const_iterator i = input.begin(); i != input.end(); ++i )
+        // evaluate the label expressions up front, so scripts run in a batch.
+        std::vector<std::string> values;
+        Feature::eval( contentExpr, input, &context, values );
+
+        std::vector<double> priorities;
+        Feature::eval( priorityExpr, input, &context, priorities );
+
+        unsigned n = 0;
+        for( FeatureList::const_iterator i = input.begin(); i != input.end(); ++i, ++n )
         {
             const Feature* feature = i->get();
             if ( !feature )
@@ -122,7 +130,7 @@ public:
                 context.profile()->getSRS()->transformToECEF( centroid, centroid );
             }
 
-            const std::string& value = feature->eval( contentExpr, &context );
+            const std::string& value = values[n];
 
             if ( !value.empty() && (!skipDupes || used.find(value) == used.end()) )
             {
@@ -131,7 +139,7 @@ public:
                     group = new osg::Group();
                 }
 
-                double priority = feature->eval( priorityExpr, &context );
+                double priority = priorities[n];
 
                 Controls::LabelControl* label = new Controls::LabelControl( value );
                 if ( text->fill().isSet() )
@@ -83,24 +83,24 @@ JSFeature::GetAttributesObjectTemplate()
 v8::Handle<v8::Value>
 JSFeature::GetFeatureAttr(const std::string& attr, Feature const* feature)
 {
-  AttributeTable::const_iterator it = feature->getAttrs().find(attr);
+  AttributeValue value;
 
   // If the key is not present return an empty handle as signal
-  if (it == feature->getAttrs().end())
+  if (!feature->getAttr(attr, value))
     return v8::Handle<v8::Value>();
 
   // Otherwise fetch the value and wrap it in a JavaScript string
-  osgEarth::Features::AttributeType atype = (*it).second.first;
+  osgEarth::Features::AttributeType atype = value.first;
   switch (atype)
   {
     case osgEarth::Features::ATTRTYPE_BOOL:
-      return v8::Boolean::New((*it).second.getBool());
+      return v8::Boolean::New(value.getBool());
     case osgEarth::Features::ATTRTYPE_DOUBLE:
-      return v8::Number::New((*it).second.getDouble());
+      return v8::Number::New(value.getDouble());
     case osgEarth::Features::ATTRTYPE_INT:
-      return v8::Integer::New((*it).second.getInt());
+      return v8::Integer::New(value.getInt());
     default:
-      std::string val = (*it).second.getString();
+      std::string val = value.getString();
       return v8::String::New(val.c_str(), val.length());
   }
 }
@@ -167,6 +167,69 @@ JavascriptEngineV8::run(const std::string& code, osgEarth::Features::Feature con
   return result;
 }
 
+bool
+JavascriptEngineV8::run(const std::string& code, const osgEarth::Features::FeatureList& features, osgEarth::Features::ScriptResultVector& results, osgEarth::Features::FilterContext const* context)
+{
+  results.reserve(results.size() + features.size());
+
+  if (code.empty())
+  {
+    results.resize(results.size() + features.size(), ScriptResult(EMPTY_STRING, false, "Script is empty."));
+    return features.empty();
+  }
+
+  // Lock, enter the context and compile once for the whole batch
+  v8::Locker locker;
+  v8::HandleScope handle_scope;
+  v8::Context::Scope context_scope(_globalContext);
+
+  v8::Handle<v8::Object> cObj = JSFilterContext::WrapFilterContext(const_cast<FilterContext*>(context));
+  _globalContext->Global()->Set(v8::String::New("context"), cObj);
+
+  v8::TryCatch try_catch;
+
+  v8::Handle<v8::Script> compiled_script = v8::Script::Compile(v8::String::New(code.c_str(), code.length()));
+  if (compiled_script.IsEmpty())
+  {
+    v8::String::AsciiValue error(try_catch.Exception());
+    results.resize(results.size() + features.size(), ScriptResult(EMPTY_STRING, false, std::string("Script compile error: ") + std::string(*error)));
+    return features.empty();
+  }
+
+  // Use a single feature wrapper and just point it at each feature in turn.
+  // (Scripts must not hold on to the "feature" object between runs.)
+  v8::Handle<v8::Object> fObj = JSFeature::WrapFeature(0L);
+  _globalContext->Global()->Set(v8::String::New("feature"), fObj);
+
+  bool ok = true;
+  for (FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+  {
+    v8::HandleScope iteration_scope;
+
+    fObj->SetInternalField(0, v8::External::New(i->get()));
+
+    v8::Handle<v8::Value> result = compiled_script->Run();
+    if (result.IsEmpty())
+    {
+      v8::String::AsciiValue error(try_catch.Exception());
+      results.push_back(ScriptResult(EMPTY_STRING, false, std::string("Script result was empty: ") + std::string(*error)));
+      try_catch.Reset();
+      ok = false;
+    }
+    else
+    {
+      v8::String::AsciiValue ascii(result);
+      results.push_back(ScriptResult(std::string(*ascii)));
+    }
+  }
+
+  // The features belong to the caller; don't leave the global wrapper pointing at one.
+  fObj->SetInternalField(0, v8::External::New(0L));
+  _globalContext->Global()->Set(v8::String::New("feature"), v8::Null());
+
+  return ok;
+}
+
 ScriptResult
 JavascriptEngineV8::call(const std::string& function, osgEarth::Features::Feature const* feature, osgEarth::Features::FilterContext const* context)
 {
@@ -67,7 +67,7 @@ public:
         }
 
 		// Attempt to read the tile map parameters from a TMS TileMap XML tile on the server:
-        _tileMap = TMS::TileMapReaderWriter::read( tmsURI.full(), 0L );
+        _tileMap = TMS::TileMapReaderWriter::read( tmsURI.full(), dbOptions, getMetadataCachePolicy(dbOptions) );
         if (!_tileMap.valid())
         {
             OE_NOTICE << "Failed to read tilemap from " << tmsURI.full() << std::endl;
@@ -19,6 +19,7 @@
 
 #include <osgEarth/VerticalDatum>
 #include <osgEarth/Geoid>
+#include <osgEarth/GeoidGrid>
 #include <osgEarth/Units>
 #include <osgDB/ReaderWriter>
 #include <osgDB/Registry>
@@ -38,37 +39,23 @@ namespace
             "EGM2008",                                  // readable name
             "egm2008" )                                 // initialization string
         {
-            // build a heightfield from the data.
-
-            unsigned cols = 1441, rows = 721;
-            float colStep = 0.25f, rowStep = 0.25f;
-
-            osg::HeightField* hf = new osg::HeightField();
-            hf->allocate( cols, rows );
-            osg::Vec3 origin(-180.f, -90.f, 0.f);
-            hf->setOrigin( origin );
-            hf->setXInterval( colStep );
-            hf->setYInterval( rowStep );
+            _geoid = new Geoid();
 
-            for( unsigned c=0; c<cols-1; ++c )
+            // a precompiled grid is memory-mapped, which is near-instant. Failing
+            // that, build the grid from the embedded data and precompile it for
+            // next time (if OSGEARTH_GEOID_PATH is set).
+            osg::ref_ptr<GeoidGrid> grid = GeoidGrid::load( "egm2008" );
+            if ( grid.valid() )
             {
-                float inputLon = 0.0f + float(c) * colStep;
-                if ( inputLon > 180.0 ) inputLon -= 360.0;
-
-                for( unsigned r=0; r<rows; ++r )
-                {
-                    float inputLat = 90.0f - float(r) * rowStep;
-
-                    unsigned outc = unsigned( (inputLon-origin.x())/colStep );
-                    unsigned outr = unsigned( (inputLat-origin.y())/rowStep );
-
-                    Linear h( (double)s_egm2008grid[r*cols+c], Units::CENTIMETERS );
-                    hf->setHeight( outc, outr, float(h.as(Units::METERS)) );
-                }
+                _geoid->setGrid( grid.get() );
+            }
+            else
+            {
+                osg::HeightField* hf = GeoidGrid::createHeightField( s_egm2008grid, 1441, 721, 0.25f );
+                GeoidGrid::store( hf, "egm2008" );
+                _geoid->setHeightField( hf );
             }
 
-            _geoid = new Geoid();
-            _geoid->setHeightField( hf );
             _geoid->setUnits( Units::METERS );
             _geoid->setName( "EGM2008" );
         }
@@ -98,8 +98,17 @@ public:
                 std::string("&REQUEST=GetCapabilities") );
         }
 
+        // cache policy for the service metadata; a warm cache avoids the round trips.
+        CachePolicy metadataCachePolicy = getMetadataCachePolicy( options );
+
         //Try to read the WMS capabilities
-        osg::ref_ptr<WMSCapabilities> capabilities = WMSCapabilitiesReader::read( capUrl.full(), 0L ); //getOptions() );
+        osg::ref_ptr<WMSCapabilities> capabilities;
+        ReadResult capResult = capUrl.readString( options, metadataCachePolicy );
+        if ( capResult.succeeded() )
+        {
+            std::istringstream in( capResult.getString() );
+            capabilities = WMSCapabilitiesReader::read( in );
+        }
         if ( !capabilities.valid() )
         {
             OE_WARN << "[osgEarth::WMS] Unable to read WMS GetCapabilities." << std::endl;
@@ -225,7 +234,12 @@ public:
         }
 
         OE_INFO << "[osgEarth::WMS] Testing for JPL/TileService at " << tsUrl.full() << std::endl;
-        _tileService = TileServiceReader::read(tsUrl.full(), 0L); //getOptions());
+        ReadResult tsResult = tsUrl.readString( options, metadataCachePolicy );
+        if ( tsResult.succeeded() )
+        {
+            std::istringstream in( tsResult.getString() );
+            _tileService = TileServiceReader::read( in );
+        }
         if (_tileService.valid())
         {
             OE_INFO << "[osgEarth::WMS] Found JPL/TileService spec" << std::endl;
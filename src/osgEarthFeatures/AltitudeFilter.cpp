@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthFeatures/AltitudeFilter>
+#include <osgEarthFeatures/GeometryBatch>
 #include <osgEarth/ElevationQuery>
 #include <osgEarth/GeoData>
 
@@ -143,7 +144,47 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
     bool vertEquiv =
         featureSRS->isVertEquivalentTo( mapSRS );
 
-    for( FeatureList::iterator i = features.begin(); i != features.end(); ++i )
+    // evaluate the expressions for all the features at once, so scripts run in a batch.
+    std::vector<double> scales, offsets;
+    if ( _altitude->verticalScale().isSet() )
+        Feature::eval( scaleExpr, features, &cx, scales );
+    if ( _altitude->verticalOffset().isSet() )
+        Feature::eval( offsetExpr, features, &cx, offsets );
+
+    osg::ref_ptr<const SpatialReference> featureSRSwithMapVertDatum = !vertEquiv ?
+        SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString()) : 0L;
+
+    // gather the points of all the features, so that the terrain is sampled with
+    // one elevation query for the whole list instead of one per geometry part.
+    GeometryBatch batch( features );
+    Vec3dVector&  points = batch.getPoints();
+
+    std::vector<double> elevations;
+    bool haveElevations = false;
+
+    // Clamp - replace the geometry's Z with the terrain height.
+    if ( _altitude->clamping() == AltitudeSymbol::CLAMP_TO_TERRAIN )
+    {
+        eq.getElevations( points, featureSRS, true, _maxRes );
+
+        // if necessary, transform the Z values (which are now in the map SRS) back
+        // into the feature's SRS.
+        if ( !vertEquiv )
+        {
+            for( Vec3dVector::iterator p = points.begin(); p != points.end(); ++p )
+                featureSRSwithMapVertDatum->transform(*p, featureSRS, *p);
+        }
+    }
+    else
+    {
+        elevations.reserve( points.size() );
+        haveElevations = eq.getElevations( points, featureSRS, elevations, _maxRes );
+    }
+
+    const std::vector<GeometryBatch::Part>& parts = batch.getParts();
+
+    unsigned n = 0;
+    for( FeatureList::iterator i = features.begin(); i != features.end(); ++i, ++n )
     {
         Feature* feature = i->get();
         //double maxGeomZ     = -DBL_MAX;
@@ -153,123 +194,79 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
         double minHAT       =  DBL_MAX;
         double maxHAT       = -DBL_MAX;
 
-        double scaleZ = 1.0;
-        if ( _altitude.valid() && _altitude->verticalScale().isSet() )
-            scaleZ = feature->eval( scaleExpr, &cx );
+        double scaleZ = scales.empty() ? 1.0 : scales[n];
+        double offsetZ = offsets.empty() ? 0.0 : offsets[n];
 
-        double offsetZ = 0.0;
-        if ( _altitude.valid() && _altitude->verticalOffset().isSet() )
-            offsetZ = feature->eval( offsetExpr, &cx );
-        
-        GeometryIterator gi( feature->getGeometry() );
-        while( gi.hasMore() )
+        // the feature's points are contiguous in the batch.
+        unsigned firstPart = batch.getFirstPart(n), endPart = batch.getFirstPart(n+1);
+        unsigned first = firstPart < endPart ? parts[firstPart].first : 0;
+        unsigned end   = firstPart < endPart ? parts[endPart-1].first + parts[endPart-1].count : 0;
+
+        for( unsigned k = first; k < end; ++k )
         {
-            Geometry* geom = gi.next();
+            osg::Vec3d& p = points[k];
 
             // Absolute heights in Z. Only need to collect the HATs; the geometry
             // remains unchanged.
             if ( _altitude->clamping() == AltitudeSymbol::CLAMP_ABSOLUTE )
             {
-                std::vector<double> elevations;
-                elevations.reserve( geom->size() );
+                if ( !haveElevations )
+                    continue;
+
+                double z = p.z();
 
-                if ( eq.getElevations( geom->asVector(), featureSRS, elevations, _maxRes ) )
+                if ( !vertEquiv )
                 {
-                    for( unsigned i=0; i<geom->size(); ++i )
-                    {
-                        osg::Vec3d& p = (*geom)[i];
-                        double z = p.z();
-
-                        if ( !vertEquiv )
-                        {
-                            osg::Vec3d tempgeo;
-                            if ( !featureSRS->transform(p, mapSRS->getGeographicSRS(), tempgeo) )
-                                z = tempgeo.z();
-                        }
-
-                        double hat = z - elevations[i];
-
-                        if ( hat > maxHAT )
-                            maxHAT = hat;
-                        if ( hat < minHAT )
-                            minHAT = hat;
-
-                        if ( elevations[i] > maxTerrainZ )
-                            maxTerrainZ = elevations[i];
-                        if ( elevations[i] < minTerrainZ )
-                            minTerrainZ = elevations[i];
-                    }
+                    osg::Vec3d tempgeo;
+                    if ( !featureSRS->transform(p, mapSRS->getGeographicSRS(), tempgeo) )
+                        z = tempgeo.z();
                 }
+
+                double hat = z - elevations[k];
+
+                if ( hat > maxHAT )
+                    maxHAT = hat;
+                if ( hat < minHAT )
+                    minHAT = hat;
+
+                if ( elevations[k] > maxTerrainZ )
+                    maxTerrainZ = elevations[k];
+                if ( elevations[k] < minTerrainZ )
+                    minTerrainZ = elevations[k];
             }
 
             // Heights-above-ground in Z. Need to resolve this to an absolute number
             // and record HATs along the way.
             else if ( _altitude->clamping() == AltitudeSymbol::CLAMP_RELATIVE_TO_TERRAIN )
             {
-                osg::ref_ptr<const SpatialReference> featureSRSwithMapVertDatum = !vertEquiv ?
-                    SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString()) : 0L;
+                if ( !haveElevations )
+                    continue;
 
-                std::vector<double> elevations;
-                elevations.reserve( geom->size() );
+                double hat = p.z();
+                p.z() = elevations[k] + p.z();
 
-                if ( eq.getElevations( geom->asVector(), featureSRS, elevations, _maxRes ) )
+                // if necessary, convert the Z value (which is now in the map's SRS) back to
+                // the feature's SRS.
+                if ( !vertEquiv )
                 {
-                    for( unsigned i=0; i<geom->size(); ++i )
-                    {
-                        osg::Vec3d& p = (*geom)[i];
-
-                        double hat = p.z();
-                        p.z() = elevations[i] + p.z();
-
-                        // if necessary, convert the Z value (which is now in the map's SRS) back to
-                        // the feature's SRS.
-                        if ( !vertEquiv )
-                        {
-                            featureSRSwithMapVertDatum->transform(p, featureSRS, p);
-                        }
-
-                        if ( hat > maxHAT )
-                            maxHAT = hat;
-                        if ( hat < minHAT )
-                            minHAT = hat;
-
-                        if ( elevations[i] > maxTerrainZ )
-                            maxTerrainZ = elevations[i];
-                        if ( elevations[i] < minTerrainZ )
-                            minTerrainZ = elevations[i];
-                    }
+                    featureSRSwithMapVertDatum->transform(p, featureSRS, p);
                 }
 
-            }
-
-            // Clamp - replace the geometry's Z with the terrain height.
-            else // CLAMP_TO_TERRAIN
-            {
-                eq.getElevations( geom->asVector(), featureSRS, true, _maxRes );
-                
-                // if necessary, transform the Z values (which are now in the map SRS) back
-                // into the feature's SRS.
-                if ( !vertEquiv )
-                {
-                    osg::ref_ptr<const SpatialReference> featureSRSwithMapVertDatum = !vertEquiv ?
-                        SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString()) : 0L;
+                if ( hat > maxHAT )
+                    maxHAT = hat;
+                if ( hat < minHAT )
+                    minHAT = hat;
 
-                    osg::Vec3d tempgeo;
-                    for( unsigned i=0; i<geom->size(); ++i )
-                    {
-                        osg::Vec3d& p = (*geom)[i];
-                        featureSRSwithMapVertDatum->transform(p, featureSRS, p);
-                    }
-                }
+                if ( elevations[k] > maxTerrainZ )
+                    maxTerrainZ = elevations[k];
+                if ( elevations[k] < minTerrainZ )
+                    minTerrainZ = elevations[k];
             }
 
             if ( !collectHATs )
             {
-                for( Geometry::iterator i = geom->begin(); i != geom->end(); ++i )
-                {
-                    i->z() *= scaleZ;
-                    i->z() += offsetZ;
-                }
+                p.z() *= scaleZ;
+                p.z() += offsetZ;
             }
         }
 
@@ -285,4 +282,8 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
             feature->set( "__max_terrain_z", maxTerrainZ );
         }
     }
+
+    // absolute heights leave the geometry unchanged.
+    if ( _altitude->clamping() != AltitudeSymbol::CLAMP_ABSOLUTE )
+        batch.scatter( features );
 }
@@ -24,6 +24,7 @@
 #include <osgEarthSymbology/PolygonSymbol>
 #include <osgEarthSymbology/MeshSubdivider>
 #include <osgEarthSymbology/MeshConsolidator>
+#include <osgEarthSymbology/PolygonTriangulator>
 #include <osgEarth/ECEF>
 #include <osg/Geode>
 #include <osg/Geometry>
@@ -101,7 +102,13 @@ BuildGeometryFilter::process( FeatureList& features, const FilterContext& contex
         mapSRS     = context.getSession()->getMapInfo().getProfile()->getSRS();
     }
 
-    for( FeatureList::iterator f = features.begin(); f != features.end(); ++f )
+    // evaluate the feature names up front, so scripts run in a batch.
+    std::vector<std::string> names;
+    if ( _featureNameExpr.isSet() )
+        Feature::eval( _featureNameExpr.mutable_value(), features, &context, names );
+
+    unsigned n = 0;
+    for( FeatureList::iterator f = features.begin(); f != features.end(); ++f, ++n )
     {
         Feature* input = f->get();
 
@@ -180,10 +187,9 @@ BuildGeometryFilter::process( FeatureList& features, const FilterContext& contex
             osg::Geometry* osgGeom = new osg::Geometry();
             osgGeom->setUseVertexBufferObjects(true);
 
-            if ( _featureNameExpr.isSet() )
+            if ( !names.empty() )
             {
-                const std::string& name = input->eval( _featureNameExpr.mutable_value(), &context );
-                osgGeom->setName( name );
+                osgGeom->setName( names[n] );
             }
 
             // build the geometry:
@@ -342,8 +348,9 @@ BuildGeometryFilter::buildPolygon(Geometry*               ring,
     }
     osgGeom->setVertexArray( allPoints );
 
-    if ( tessellate )
+    if ( tessellate && !PolygonTriangulator::run(*osgGeom) )
     {
+        // the native triangulator couldn't handle it; fall back on GLU.
         osgUtil::Tessellator tess;
         tess.setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
         tess.setWindingType( osgUtil::Tessellator::TESS_WINDING_POSITIVE );
@@ -364,7 +371,9 @@ BuildGeometryFilter::push( FeatureList& input, FilterContext& context )
     // convert all geom to triangles and consolidate into minimal set of Geometries
     if ( !_featureNameExpr.isSet() )
     {
+        FilterStats::Sample sample( context, "MeshConsolidator", _geode.get() );
         MeshConsolidator::run( *_geode.get() );
+        sample.done( _geode.get() );
     }
 
     osg::Node* result = 0L;
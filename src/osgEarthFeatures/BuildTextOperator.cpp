@@ -91,17 +91,23 @@ osg::Node* BuildTextOperator::operator()(const FeatureList&   features,
 
     StringExpression contentExpr = *symbol->content();
 
+    //Get the text from the specified content and referenced attributes, all at
+    //once so that scripts run in a batch
+    std::vector<std::string> content;
+    if (symbol->content().isSet())
+        Feature::eval( contentExpr, features, &context, content );
+
     osg::Geode* result = new osg::Geode;
-    for (FeatureList::const_iterator itr = features.begin(); itr != features.end(); ++itr)
+    unsigned n = 0;
+    for (FeatureList::const_iterator itr = features.begin(); itr != features.end(); ++itr, ++n)
     {
         Feature* feature = itr->get();
         if (!feature->getGeometry()) continue;
 
         std::string text;
-        if (symbol->content().isSet())
+        if (!content.empty())
         {
-            //Get the text from the specified content and referenced attributes
-            text = feature->eval( contentExpr, &context );
+            text = content[n];
         }
 
         if (text.empty()) continue;
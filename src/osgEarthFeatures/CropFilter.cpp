@@ -73,13 +73,11 @@ CropFilter::push( FeatureList& input, FilterContext& context )
         }
     }
 
-    else // METHOD_CROPPING (requires GEOS)
+    else // METHOD_CROPPING
     {
-#ifdef OSGEARTH_HAVE_GEOS
+        // crop natively to the axis-aligned extent; no need to round-trip through GEOS.
+        Bounds cropBounds( extent.xMin(), extent.yMin(), extent.xMax(), extent.yMax() );
 
-        // create the intersection polygon:
-        osg::ref_ptr<Symbology::Polygon> poly;
-        
         for( FeatureList::iterator i = input.begin(); i != input.end();  )
         {
             bool keepFeature = false;
@@ -105,17 +103,8 @@ CropFilter::push( FeatureList& input, FilterContext& context )
                 // then move on to the cropping operation:
                 else
                 {
-                    if ( !poly.valid() )
-                    {
-                        poly = new Symbology::Polygon();
-                        poly->push_back( osg::Vec3d( extent.xMin(), extent.yMin(), 0 ));
-                        poly->push_back( osg::Vec3d( extent.xMax(), extent.yMin(), 0 ));
-                        poly->push_back( osg::Vec3d( extent.xMax(), extent.yMax(), 0 ));
-                        poly->push_back( osg::Vec3d( extent.xMin(), extent.yMax(), 0 ));
-                    }
-
                     osg::ref_ptr<Geometry> croppedGeometry;
-                    if ( featureGeom->crop( poly.get(), croppedGeometry ) )
+                    if ( featureGeom->crop( cropBounds, croppedGeometry ) )
                     {
                         if ( croppedGeometry->isValid() )
                         {
@@ -131,14 +120,7 @@ CropFilter::push( FeatureList& input, FilterContext& context )
                 ++i;
             else
                 i = input.erase( i );
-        }  
-
-#else // OSGEARTH_HAVE_GEOS
-
-        OE_WARN << "CropFilter - METHOD_CROPPING not available - please compile osgEarth with GEOS" << std::endl;
-        return context;
-
-#endif
+        }
     }
 
     FilterContext newContext = context;
@@ -20,6 +20,7 @@
 #include <osgEarthFeatures/FeatureSourceIndexNode>
 #include <osgEarthSymbology/MeshSubdivider>
 #include <osgEarthSymbology/MeshConsolidator>
+#include <osgEarthSymbology/PolygonTriangulator>
 #include <osgEarth/ECEF>
 #include <osg/Geode>
 #include <osg/Geometry>
@@ -647,7 +648,19 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
     Random wallSkinPRNG( _wallSkinSymbol.valid()? *_wallSkinSymbol->randomSeed() : 0, Random::METHOD_FAST );
     Random roofSkinPRNG( _roofSkinSymbol.valid()? *_roofSkinSymbol->randomSeed() : 0, Random::METHOD_FAST );
 
-    for( FeatureList::iterator f = features.begin(); f != features.end(); ++f )
+    // evaluate the per-feature expressions up front, so scripts run in a batch.
+    std::vector<double> heights, offsets;
+    if ( !_heightCallback.valid() && _heightExpr.isSet() )
+        Feature::eval( _heightExpr.mutable_value(), features, &context, heights );
+    if ( _heightOffsetExpr.isSet() )
+        Feature::eval( _heightOffsetExpr.mutable_value(), features, &context, offsets );
+
+    std::vector<std::string> names;
+    if ( !_featureNameExpr.empty() )
+        Feature::eval( _featureNameExpr, features, &context, names );
+
+    unsigned n = 0;
+    for( FeatureList::iterator f = features.begin(); f != features.end(); ++f, ++n )
     {
         Feature* input = f->get();
 
@@ -695,7 +708,7 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
             }
             else if ( _heightExpr.isSet() )
             {
-                height = input->eval( _heightExpr.mutable_value(), &context );
+                height = heights[n];
             }
             else
             {
@@ -706,7 +719,7 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
             float offset = 0.0;
             if ( _heightOffsetExpr.isSet() )
             {
-                offset = input->eval( _heightOffsetExpr.mutable_value(), &context );
+                offset = offsets[n];
             }
 
             osg::StateSet* wallStateSet = 0L;
@@ -789,15 +802,19 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
                 // tessellate and add the roofs if necessary:
                 if ( rooflines.valid() )
                 {
-                    osgUtil::Tessellator tess;
-                    tess.setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
-                    tess.setWindingType( osgUtil::Tessellator::TESS_WINDING_ODD );
-                    tess.retessellatePolygons( *(rooflines.get()) );
-
-                    // generate default normals (no crease angle necessary; they are all pointing up)
-                    // TODO do this manually; probably faster
-                    if ( !_makeStencilVolume )
-                        osgUtil::SmoothingVisitor::smooth( *rooflines.get() );
+                    // try the native triangulator first, which also generates the normals.
+                    // Fall back on the GLU tessellator for input it can't handle.
+                    if ( !PolygonTriangulator::run(*rooflines.get(), !_makeStencilVolume) )
+                    {
+                        osgUtil::Tessellator tess;
+                        tess.setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
+                        tess.setWindingType( osgUtil::Tessellator::TESS_WINDING_ODD );
+                        tess.retessellatePolygons( *(rooflines.get()) );
+
+                        // generate default normals (no crease angle necessary; they are all pointing up)
+                        if ( !_makeStencilVolume )
+                            osgUtil::SmoothingVisitor::smooth( *rooflines.get() );
+                    }
 
                     // texture the rooflines if necessary
                     //applyOverlayTexturing( rooflines.get(), input, env );
@@ -812,7 +829,7 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
                     }
                 }
 
-                if ( baselines.valid() )
+                if ( baselines.valid() && !PolygonTriangulator::run(*baselines.get()) )
                 {
                     osgUtil::Tessellator tess;
                     tess.setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
@@ -821,8 +838,8 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
                 }
 
                 std::string name;
-                if ( !_featureNameExpr.empty() )
-                    name = input->eval( _featureNameExpr, &context );
+                if ( !names.empty() )
+                    name = names[n];
 
                 FeatureSourceIndex* index = context.featureIndex();
                 FeatureID fid = input->getFID();
@@ -903,7 +920,9 @@ ExtrudeGeometryFilter::push( FeatureList& input, FilterContext& context )
     {
         for( SortedGeodeMap::iterator i = _geodes.begin(); i != _geodes.end(); ++i )
         {
+            FilterStats::Sample sample( context, "MeshConsolidator", i->second.get() );
             MeshConsolidator::run( *i->second.get() );
+            sample.done( i->second.get() );
         }
     }
 
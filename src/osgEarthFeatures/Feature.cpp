@@ -141,18 +141,247 @@ AttributeValue::getBool( bool defaultValue ) const
 
 //----------------------------------------------------------------------------
 
+AttributeStore::AttributeStore() :
+_numRows( 0 )
+{
+    // string index 0 is always the empty string.
+    intern( EMPTY_STRING );
+}
+
+unsigned
+AttributeStore::intern( const std::string& value )
+{
+    std::map<std::string, unsigned>::const_iterator i = _stringIndex.find( value );
+    if ( i != _stringIndex.end() )
+        return i->second;
+
+    unsigned index = _strings.size();
+    _strings.push_back( value );
+    _stringIndex[value] = index;
+    return index;
+}
+
+unsigned
+AttributeStore::addColumn( const std::string& name, AttributeType type )
+{
+    std::string key = toLower( name );
+    std::map<std::string, unsigned>::const_iterator i = _columnIndex.find( key );
+    if ( i != _columnIndex.end() )
+        return i->second;
+
+    unsigned col = _columns.size();
+    _columns.push_back( Column() );
+    Column& c = _columns.back();
+    c._name = key;
+    c._type = type;
+    c._isSet.resize( _numRows, false );
+    switch( type ) {
+        case ATTRTYPE_DOUBLE: c._doubles.resize( _numRows, 0.0 ); break;
+        case ATTRTYPE_INT:    c._ints.resize( _numRows, 0 ); break;
+        case ATTRTYPE_BOOL:   c._bools.resize( _numRows, false ); break;
+        default:              c._strings.resize( _numRows, 0 ); break;
+    }
+    _columnIndex[key] = col;
+    return col;
+}
+
+int
+AttributeStore::getColumn( const std::string& name ) const
+{
+    std::map<std::string, unsigned>::const_iterator i = _columnIndex.find( name );
+    return i != _columnIndex.end() ? (int)i->second : -1;
+}
+
+unsigned
+AttributeStore::addRow()
+{
+    for( std::vector<Column>::iterator c = _columns.begin(); c != _columns.end(); ++c )
+    {
+        c->_isSet.push_back( false );
+        switch( c->_type ) {
+            case ATTRTYPE_DOUBLE: c->_doubles.push_back( 0.0 ); break;
+            case ATTRTYPE_INT:    c->_ints.push_back( 0 ); break;
+            case ATTRTYPE_BOOL:   c->_bools.push_back( false ); break;
+            default:              c->_strings.push_back( 0 ); break;
+        }
+    }
+    return _numRows++;
+}
+
+void
+AttributeStore::set( unsigned row, unsigned col, const AttributeValue& value )
+{
+    Column& c = _columns[col];
+    c._isSet[row] = true;
+    switch( c._type ) {
+        case ATTRTYPE_DOUBLE: c._doubles[row] = value.getDouble(); break;
+        case ATTRTYPE_INT:    c._ints[row]    = value.getInt(); break;
+        case ATTRTYPE_BOOL:   c._bools[row]   = value.getBool(); break;
+        default:              c._strings[row] = intern( value.getString() ); break;
+    }
+}
+
+void
+AttributeStore::set( unsigned row, unsigned col, const std::string& value )
+{
+    Column& c = _columns[col];
+    if ( c._type == ATTRTYPE_STRING || c._type == ATTRTYPE_UNSPECIFIED )
+    {
+        c._isSet[row] = true;
+        c._strings[row] = intern( value );
+    }
+    else
+    {
+        AttributeValue a;
+        a.first = ATTRTYPE_STRING;
+        a.second.stringValue = value;
+        set( row, col, a );
+    }
+}
+
+void
+AttributeStore::set( unsigned row, unsigned col, double value )
+{
+    Column& c = _columns[col];
+    if ( c._type == ATTRTYPE_DOUBLE )
+    {
+        c._isSet[row] = true;
+        c._doubles[row] = value;
+    }
+    else
+    {
+        AttributeValue a;
+        a.first = ATTRTYPE_DOUBLE;
+        a.second.doubleValue = value;
+        set( row, col, a );
+    }
+}
+
+void
+AttributeStore::set( unsigned row, unsigned col, int value )
+{
+    Column& c = _columns[col];
+    if ( c._type == ATTRTYPE_INT )
+    {
+        c._isSet[row] = true;
+        c._ints[row] = value;
+    }
+    else
+    {
+        AttributeValue a;
+        a.first = ATTRTYPE_INT;
+        a.second.intValue = value;
+        set( row, col, a );
+    }
+}
+
+void
+AttributeStore::set( unsigned row, unsigned col, bool value )
+{
+    Column& c = _columns[col];
+    if ( c._type == ATTRTYPE_BOOL )
+    {
+        c._isSet[row] = true;
+        c._bools[row] = value;
+    }
+    else
+    {
+        AttributeValue a;
+        a.first = ATTRTYPE_BOOL;
+        a.second.boolValue = value;
+        set( row, col, a );
+    }
+}
+
+AttributeValue
+AttributeStore::getValue( unsigned row, unsigned col ) const
+{
+    const Column& c = _columns[col];
+    AttributeValue a;
+    a.first = c._type == ATTRTYPE_UNSPECIFIED ? ATTRTYPE_STRING : c._type;
+    switch( c._type ) {
+        case ATTRTYPE_DOUBLE: a.second.doubleValue = c._doubles[row]; break;
+        case ATTRTYPE_INT:    a.second.intValue    = c._ints[row]; break;
+        case ATTRTYPE_BOOL:   a.second.boolValue   = c._bools[row]; break;
+        default:              a.second.stringValue = _strings[c._strings[row]]; break;
+    }
+    return a;
+}
+
+std::string
+AttributeStore::getString( unsigned row, unsigned col ) const
+{
+    const Column& c = _columns[col];
+    switch( c._type ) {
+        case ATTRTYPE_DOUBLE: return osgEarth::toString(c._doubles[row]);
+        case ATTRTYPE_INT:    return osgEarth::toString(c._ints[row]);
+        case ATTRTYPE_BOOL:   return osgEarth::toString((bool)c._bools[row]);
+        default:              return _strings[c._strings[row]];
+    }
+}
+
+double
+AttributeStore::getDouble( unsigned row, unsigned col, double defaultValue ) const
+{
+    const Column& c = _columns[col];
+    switch( c._type ) {
+        case ATTRTYPE_DOUBLE: return c._doubles[row];
+        case ATTRTYPE_INT:    return (double)c._ints[row];
+        case ATTRTYPE_BOOL:   return c._bools[row] ? 1.0 : 0.0;
+        default:              return osgEarth::as<double>(_strings[c._strings[row]], defaultValue);
+    }
+}
+
+int
+AttributeStore::getInt( unsigned row, unsigned col, int defaultValue ) const
+{
+    const Column& c = _columns[col];
+    switch( c._type ) {
+        case ATTRTYPE_DOUBLE: return (int)c._doubles[row];
+        case ATTRTYPE_INT:    return c._ints[row];
+        case ATTRTYPE_BOOL:   return c._bools[row] ? 1 : 0;
+        default:              return osgEarth::as<int>(_strings[c._strings[row]], defaultValue);
+    }
+}
+
+bool
+AttributeStore::getBool( unsigned row, unsigned col, bool defaultValue ) const
+{
+    const Column& c = _columns[col];
+    switch( c._type ) {
+        case ATTRTYPE_DOUBLE: return c._doubles[row] != 0.0;
+        case ATTRTYPE_INT:    return c._ints[row] != 0;
+        case ATTRTYPE_BOOL:   return c._bools[row];
+        default:              return osgEarth::as<bool>(_strings[c._strings[row]], defaultValue);
+    }
+}
+
+void
+AttributeStore::getRow( unsigned row, AttributeTable& out_attrs ) const
+{
+    for( unsigned col=0; col<_columns.size(); ++col )
+    {
+        if ( _columns[col]._isSet[row] )
+            out_attrs[_columns[col]._name] = getValue( row, col );
+    }
+}
+
+//----------------------------------------------------------------------------
+
 Feature::Feature( FeatureID fid ) :
 _fid( fid ),
 _srs( 0L ),
+_storeRow( 0 ),
 _cachedBoundingPolytopeValid( false )
 {
     //NOP
 }
 
 Feature::Feature( Geometry* geom, const SpatialReference* srs, const Style& style, FeatureID fid ) :
-_geom ( geom ),
-_srs  ( srs ),
-_fid  ( fid )
+_geom     ( geom ),
+_srs      ( srs ),
+_fid      ( fid ),
+_storeRow ( 0 )
 {
     if ( !style.empty() )
         _style = style;
@@ -163,6 +392,8 @@ _fid  ( fid )
 Feature::Feature( const Feature& rhs, const osg::CopyOp& copyOp ) :
 _fid      ( rhs._fid ),
 _attrs    ( rhs._attrs ),
+_store    ( rhs._store.get() ),
+_storeRow ( rhs._storeRow ),
 _style    ( rhs._style ),
 _geoInterp( rhs._geoInterp ),
 _srs      ( rhs._srs.get() )
@@ -204,6 +435,9 @@ Feature::dirty()
 void
 Feature::set( const std::string& name, const std::string& value )
 {
+    if ( _store.valid() )
+        detachAttributeStore();
+
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_STRING;
     a.second.stringValue = value;
@@ -212,6 +446,9 @@ Feature::set( const std::string& name, const std::string& value )
 void
 Feature::set( const std::string& name, double value )
 {
+    if ( _store.valid() )
+        detachAttributeStore();
+
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_DOUBLE;
     a.second.doubleValue = value;
@@ -220,6 +457,9 @@ Feature::set( const std::string& name, double value )
 void
 Feature::set( const std::string& name, int value )
 {
+    if ( _store.valid() )
+        detachAttributeStore();
+
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_INT;
     a.second.intValue = value;
@@ -228,20 +468,96 @@ Feature::set( const std::string& name, int value )
 void
 Feature::set( const std::string& name, bool value )
 {
+    if ( _store.valid() )
+        detachAttributeStore();
+
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_BOOL;
     a.second.boolValue = value;
 }
 
+const AttributeTable&
+Feature::getAttrs()
+{
+    if ( _store.valid() )
+        detachAttributeStore();
+    return _attrs;
+}
+
+void
+Feature::copyAttrs( AttributeTable& out_attrs ) const
+{
+    if ( _store.valid() )
+    {
+        out_attrs.clear();
+        _store->getRow( _storeRow, out_attrs );
+    }
+    else
+    {
+        out_attrs = _attrs;
+    }
+}
+
+bool
+Feature::getAttr( const std::string& name, AttributeValue& out_value ) const
+{
+    if ( _store.valid() )
+    {
+        int col = getStoreColumn(name);
+        if ( col < 0 )
+            return false;
+        out_value = _store->getValue( _storeRow, col );
+        return true;
+    }
+
+    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    if ( i == _attrs.end() )
+        return false;
+    out_value = i->second;
+    return true;
+}
+
+void
+Feature::setAttributeStore( AttributeStore* store, unsigned row )
+{
+    _attrs.clear();
+    _store    = store;
+    _storeRow = row;
+}
+
+void
+Feature::detachAttributeStore()
+{
+    _attrs.clear();
+    _store->getRow( _storeRow, _attrs );
+    _store = 0L;
+}
+
+int
+Feature::getStoreColumn( const std::string& name ) const
+{
+    int col = _store->getColumn( toLower(name) );
+    return col >= 0 && _store->isSet(_storeRow, col) ? col : -1;
+}
+
 bool
 Feature::hasAttr( const std::string& name ) const
 {
+    if ( _store.valid() )
+        return getStoreColumn(name) >= 0;
+
     return _attrs.find(toLower(name)) != _attrs.end();
 }
 
 std::string
 Feature::getString( const std::string& name ) const
 {
+    if ( _store.valid() )
+    {
+        int col = getStoreColumn(name);
+        return col >= 0 ? _store->getString(_storeRow, col) : EMPTY_STRING;
+    }
+
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.getString() : EMPTY_STRING;
 }
@@ -249,6 +565,12 @@ Feature::getString( const std::string& name ) const
 double
 Feature::getDouble( const std::string& name, double defaultValue ) const 
 {
+    if ( _store.valid() )
+    {
+        int col = getStoreColumn(name);
+        return col >= 0 ? _store->getDouble(_storeRow, col, defaultValue) : defaultValue;
+    }
+
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.getDouble(defaultValue) : defaultValue;
 }
@@ -256,6 +578,12 @@ Feature::getDouble( const std::string& name, double defaultValue ) const
 int
 Feature::getInt( const std::string& name, int defaultValue ) const 
 {
+    if ( _store.valid() )
+    {
+        int col = getStoreColumn(name);
+        return col >= 0 ? _store->getInt(_storeRow, col, defaultValue) : defaultValue;
+    }
+
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.getInt(defaultValue) : defaultValue;
 }
@@ -263,6 +591,12 @@ Feature::getInt( const std::string& name, int defaultValue ) const
 bool
 Feature::getBool( const std::string& name, bool defaultValue ) const 
 {
+    if ( _store.valid() )
+    {
+        int col = getStoreColumn(name);
+        return col >= 0 ? _store->getBool(_storeRow, col, defaultValue) : defaultValue;
+    }
+
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.getBool(defaultValue) : defaultValue;
 }
@@ -274,8 +608,18 @@ Feature::eval( NumericExpression& expr, FilterContext const* context ) const
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
       double val = 0.0;
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
+      int col = -1;
+      AttributeTable::const_iterator ai = _attrs.end();
+      if (_store.valid())
+        col = getStoreColumn(i->first);
+      else
+        ai = _attrs.find(toLower(i->first));
+
+      if (col >= 0)
+      {
+        val = _store->getDouble(_storeRow, col, 0.0);
+      }
+      else if (ai != _attrs.end())
       {
         val = ai->second.getDouble(0.0);
       }
@@ -306,8 +650,18 @@ Feature::eval( StringExpression& expr, FilterContext const* context ) const
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
       std::string val = "";
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
+      int col = -1;
+      AttributeTable::const_iterator ai = _attrs.end();
+      if (_store.valid())
+        col = getStoreColumn(i->first);
+      else
+        ai = _attrs.find(toLower(i->first));
+
+      if (col >= 0)
+      {
+        val = _store->getString(_storeRow, col);
+      }
+      else if (ai != _attrs.end())
       {
         val = ai->second.getString();
       }
@@ -332,6 +686,110 @@ Feature::eval( StringExpression& expr, FilterContext const* context ) const
     return expr.eval();
 }
 
+namespace
+{
+    void getAttrValue( const Feature* feature, const std::string& name, double& out )      { out = feature->getDouble(name, 0.0); }
+    void getAttrValue( const Feature* feature, const std::string& name, std::string& out ) { out = feature->getString(name); }
+
+    void getScriptValue( ScriptResult& result, double& out )      { out = result.asDouble(); }
+    void getScriptValue( ScriptResult& result, std::string& out ) { out = result.asString(); }
+
+    // Gets the value of one expression variable for each feature in a list. Features
+    // without that attribute run it as a script, all in a single call to the engine.
+    // NULL entries keep the default value.
+    template<typename T>
+    void getVariableValues(const std::string&   name,
+                           const FeatureList&   features,
+                           FilterContext const* context,
+                           std::vector<T>&      out_values )
+    {
+        out_values.assign( features.size(), T() );
+
+        FeatureList           scripted;
+        std::vector<unsigned> scriptedIndex;
+
+        unsigned f = 0;
+        for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i, ++f )
+        {
+            if ( !i->valid() )
+                continue;
+
+            if ( (*i)->hasAttr(name) )
+            {
+                getAttrValue( i->get(), name, out_values[f] );
+            }
+            else
+            {
+                scripted.push_back( *i );
+                scriptedIndex.push_back( f );
+            }
+        }
+
+        if ( scripted.empty() || !context )
+            return;
+
+        //No attr found, look for script
+        ScriptEngine* engine = context->getSession()->getScriptEngine();
+        if ( engine )
+        {
+            ScriptResultVector results;
+            engine->run( name, scripted, results, context );
+
+            for( unsigned k=0; k<results.size() && k<scriptedIndex.size(); ++k )
+            {
+                if ( results[k].success() )
+                    getScriptValue( results[k], out_values[scriptedIndex[k]] );
+                else
+                    OE_WARN << LC << "Script error:" << results[k].message() << std::endl;
+            }
+        }
+    }
+}
+
+void
+Feature::eval( NumericExpression& expr, const FeatureList& features, FilterContext const* context, std::vector<double>& out_values )
+{
+    const NumericExpression::Variables& vars = expr.variables();
+
+    std::vector< std::vector<double> > values( vars.size() );
+    unsigned v = 0;
+    for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i, ++v )
+        getVariableValues( i->first, features, context, values[v] );
+
+    out_values.reserve( out_values.size() + features.size() );
+    for( unsigned f=0; f<features.size(); ++f )
+    {
+        v = 0;
+        for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i, ++v )
+            expr.set( *i, values[v][f] );
+
+        out_values.push_back( expr.eval() );
+    }
+}
+
+void
+Feature::eval( StringExpression& expr, const FeatureList& features, FilterContext const* context, std::vector<std::string>& out_values )
+{
+    const StringExpression::Variables& vars = expr.variables();
+
+    std::vector< std::vector<std::string> > values( vars.size() );
+    unsigned v = 0;
+    for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i, ++v )
+        getVariableValues( i->first, features, context, values[v] );
+
+    out_values.reserve( out_values.size() + features.size() );
+    for( unsigned f=0; f<features.size(); ++f )
+    {
+        v = 0;
+        // always set each variable, even to an empty string, so a feature never
+        // picks up the value left over from the one before it.
+        for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i, ++v )
+            expr.set( *i, values[v][f] );
+
+        out_values.push_back( expr.eval() );
+    }
+}
+
 #if 0
 #define SIGN_OF(x) double(int(x > 0.0) - int(x < 0.0))
 
@@ -24,8 +24,11 @@
 #include <osgEarth/CullingUtils>
 #include <osgEarth/NodeUtils>
 #include <osgEarth/ElevationQuery>
+#include <osgEarth/Cache>
+#include <osgEarth/StringUtils>
 #include <osg/PagedLOD>
 #include <osg/ProxyNode>
+#include <osg/Geode>
 #include <osgDB/FileNameUtils>
 #include <osgDB/ReaderWriter>
 #include <osgDB/WriteFile>
@@ -60,7 +63,37 @@ namespace
         return str;
     }
 
-    osg::Group* createPagedNode( const osg::BoundingSphered& bs, const std::string& uri, float minRange, float maxRange, float priOffset, float priScale )
+    // A PagedLOD that keeps a feature index up to date as its tiles page in and out.
+    struct FeaturePagedLOD : public osg::PagedLOD
+    {
+        FeaturePagedLOD( FeatureSourceIndexNode* index ) : _index( index ) { }
+
+        virtual bool addChild( osg::Node* child )
+        {
+            bool ok = osg::PagedLOD::addChild( child );
+            osg::ref_ptr<FeatureSourceIndexNode> index = _index.get();
+            if ( ok && index.valid() )
+                index->index( child );
+            return ok;
+        }
+
+        virtual bool removeExpiredChildren( double expiryTime, unsigned expiryFrame, osg::NodeList& removedChildren )
+        {
+            unsigned first = removedChildren.size();
+            bool removed = osg::PagedLOD::removeExpiredChildren( expiryTime, expiryFrame, removedChildren );
+            osg::ref_ptr<FeatureSourceIndexNode> index = _index.get();
+            if ( index.valid() )
+            {
+                for( unsigned i = first; i < removedChildren.size(); ++i )
+                    index->unindex( removedChildren[i].get() );
+            }
+            return removed;
+        }
+
+        osg::observer_ptr<FeatureSourceIndexNode> _index;
+    };
+
+    osg::Group* createPagedNode( const osg::BoundingSphered& bs, const std::string& uri, float minRange, float maxRange, float priOffset, float priScale, FeatureSourceIndexNode* index )
     {
 #ifdef USE_PROXY_NODE_FOR_TESTING
         osg::ProxyNode* p = new osg::ProxyNode();
@@ -68,7 +101,7 @@ namespace
         p->setRadius( bs.radius() );
         p->setFileName( 0, uri );
 #else
-        osg::PagedLOD* p = new osg::PagedLOD();
+        osg::PagedLOD* p = index ? new FeaturePagedLOD( index ) : new osg::PagedLOD();
         p->setCenter( bs.center() );
         //p->setRadius( bs.radius() );
         p->setRadius(std::max((float)bs.radius(),maxRange));
@@ -153,6 +186,76 @@ namespace
             fullExtent.xMin() + w * (double)(tileX+1),
             fullExtent.yMin() + h * (double)(tileY+1) );
     }
+
+    std::string
+    s_makeCacheKey( unsigned lod, unsigned tileX, unsigned tileY )
+    {
+        return Stringify() << lod << "_" << tileX << "_" << tileY;
+    }
+
+    /**
+     * Checks whether a compiled subgraph will survive a round trip through the
+     * native OSG serializer. Objects from other libraries (osgEarth node kits,
+     * custom callbacks, etc) may not have serializer wrappers, so we don't try
+     * to cache those tiles.
+     */
+    struct CanSerializeVisitor : public osg::NodeVisitor
+    {
+        bool _ok;
+
+        CanSerializeVisitor() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), _ok(true) { }
+
+        bool isCore( const osg::Object* obj ) const
+        {
+            if ( !obj )
+                return true;
+            std::string lib( obj->libraryName() );
+            return lib == "osg" || lib == "osgText" || lib == "osgSim";
+        }
+
+        void check( const osg::Object* obj )
+        {
+            if ( _ok && !isCore(obj) )
+                _ok = false;
+        }
+
+        void check( const osg::StateSet* ss )
+        {
+            if ( !ss || !_ok )
+                return;
+
+            const osg::StateSet::AttributeList& attrs = ss->getAttributeList();
+            for( osg::StateSet::AttributeList::const_iterator i = attrs.begin(); i != attrs.end(); ++i )
+                check( i->second.first.get() );
+
+            const osg::StateSet::TextureAttributeList& texAttrs = ss->getTextureAttributeList();
+            for( unsigned unit = 0; unit < texAttrs.size(); ++unit )
+                for( osg::StateSet::AttributeList::const_iterator i = texAttrs[unit].begin(); i != texAttrs[unit].end(); ++i )
+                    check( i->second.first.get() );
+        }
+
+        void apply( osg::Node& node )
+        {
+            check( &node );
+            check( node.getStateSet() );
+            check( node.getUpdateCallback() );
+            check( node.getCullCallback() );
+            check( node.getEventCallback() );
+            if ( _ok )
+                traverse( node );
+        }
+
+        void apply( osg::Geode& geode )
+        {
+            for( unsigned i = 0; i < geode.getNumDrawables() && _ok; ++i )
+            {
+                const osg::Drawable* d = geode.getDrawable(i);
+                check( d );
+                check( d->getStateSet() );
+            }
+            apply( static_cast<osg::Node&>(geode) );
+        }
+    };
 }
 
 
@@ -235,6 +338,16 @@ _pendingUpdate( false )
 
     ADJUST_EVENT_TRAV_COUNT( this, 1 );
 
+    // with feature indexing on, all the tiles live under one index node that
+    // tracks them as they page in and out.
+    if ( _options.featureIndexing() == true )
+    {
+        _featureIndex = new FeatureSourceIndexNode( session->getFeatureSource() );
+        addChild( _featureIndex.get() );
+    }
+
+    initCache();
+
     redraw();
 }
 
@@ -312,9 +425,10 @@ FeatureModelGraph::setupPaging()
         0.0f, 
         maxRange, 
         *_options.layout()->priorityOffset(), 
-        *_options.layout()->priorityScale() );
+        *_options.layout()->priorityScale(),
+        _featureIndex.get() );
 
-    this->addChild( pagedNode );
+    getContentRoot()->addChild( pagedNode );
 }
 
 osg::Node*
@@ -352,7 +466,7 @@ FeatureModelGraph::load( unsigned lod, unsigned tileX, unsigned tileY, const std
             
             // Construct a tile key that will be used to query the source for this tile.
             TileKey key(lod, tileX, tileY, featureProfile->getProfile());
-            geometry = build( level, tileExtent, &key );
+            geometry = build( level, tileExtent, &key, s_makeCacheKey(lod, tileX, tileY) );
             result = geometry;
         }
 
@@ -385,7 +499,7 @@ FeatureModelGraph::load( unsigned lod, unsigned tileX, unsigned tileY, const std
         // we simply want to load all features at once and make them visible at
         // maximum camera range.
         FeatureLevel all( 0.0f, FLT_MAX );
-        result = build( all, GeoExtent::INVALID, 0 );
+        result = build( all, GeoExtent::INVALID, 0, "all" );
     }
 
     else if ( (int)lod < _lodmap.size() )
@@ -406,7 +520,7 @@ FeatureModelGraph::load( unsigned lod, unsigned tileX, unsigned tileY, const std
                 s_getTileExtent( lod, tileX, tileY, _usableFeatureExtent ) :
                 _usableFeatureExtent;
 
-            geometry = build( *level, tileExtent, 0 );
+            geometry = build( *level, tileExtent, 0, s_makeCacheKey(lod, tileX, tileY) );
             result = geometry;
         }
 
@@ -498,7 +612,8 @@ FeatureModelGraph::buildSubTilePagedLODs(unsigned        parentLOD,
                     uri, 
                     0.0f, maxRange, 
                     *_options.layout()->priorityOffset(), 
-                    *_options.layout()->priorityScale() );
+                    *_options.layout()->priorityScale(),
+                    _featureIndex.get() );
 
                 parent->addChild( pagedNode );
             }
@@ -507,62 +622,34 @@ FeatureModelGraph::buildSubTilePagedLODs(unsigned        parentLOD,
 }
 
 osg::Group*
-FeatureModelGraph::build( const FeatureLevel& level, const GeoExtent& extent, const TileKey* key )
+FeatureModelGraph::build(const FeatureLevel& level,
+                         const GeoExtent&    extent,
+                         const TileKey*      key,
+                         const std::string&  cacheKey )
 {
-    // set up for feature indexing if appropriate:
-    osg::ref_ptr<osg::Group> group;
-    FeatureSourceIndexNode* index = 0L;
-    if ( _session->getFeatureSource() && (_options.featureIndexing() == true) )
-    {
-        index = new FeatureSourceIndexNode( _session->getFeatureSource() );
-        group = index;
-    }
-    else
+    // tag features for the shared index if appropriate; the tile is indexed
+    // when it's added to the graph.
+    FeatureSourceIndex* index = _featureIndex.get();
+    osg::ref_ptr<osg::Group> group = new osg::Group();
+
+    // try the cache first; a hit skips the query and compile entirely.
+    osg::ref_ptr<osg::Group> cached = readTileFromCache( cacheKey );
+    if ( cached.valid() )
     {
-        group = new osg::Group();
+        for( unsigned i = 0; i < cached->getNumChildren(); ++i )
+            group->addChild( cached->getChild(i) );
     }
 
-    // form the baseline query, which does a spatial query based on the working extent.
-    Query query;
-    if ( extent.isValid() )
-        query.bounds() = extent.bounds();
-
-    // add a tile key to the query if there is one, to support TFS-style queries
-    if ( key )
-        query.tileKey() = *key;
-
-    // now, go through any level-based selectors.
-    const StyleSelectorVector& levelSelectors = level.selectors();
-    
-    // if there are none, just build once with the default style and query.
-    if ( levelSelectors.size() == 0 )
+    // in cache-only mode, a miss means there is no data for this tile.
+    else if ( isCacheOnly() )
     {
-        // attempt to glean the style from the feature source name:
-        const Style style = *_session->styles()->getStyle( 
-            *_session->getFeatureSource()->getFeatureSourceOptions().name() );
-
-        osg::Node* node = build( style, query, extent, index );
-        if ( node )
-            group->addChild( node );
+        return 0L;
     }
 
     else
     {
-        for( StyleSelectorVector::const_iterator i = levelSelectors.begin(); i != levelSelectors.end(); ++i )
-        {
-            const StyleSelector& selector = *i;
-
-            // fetch the selector's style:
-            const Style* selectorStyle = _session->styles()->getStyle( selector.getSelectedStyleName() );
-
-            // combine the selector's query, if it has one:
-            Query selectorQuery = 
-                selector.query().isSet() ? query.combineWith( *selector.query() ) : query;
-
-            osg::Node* node = build( *selectorStyle, selectorQuery, extent, index );
-            if ( node )
-                group->addChild( node );
-        }
+        buildStyleGroups( level, extent, key, index, group.get() );
+        writeTileToCache( cacheKey, group.get() );
     }
 
     if ( group->getNumChildren() > 0 )
@@ -598,10 +685,6 @@ FeatureModelGraph::build( const FeatureLevel& level, const GeoExtent& extent, co
             }
         }
 
-        // if indexing is enabled, build the index now.
-        if ( index )
-            index->reindex();
-
         return group.release();
     }
 
@@ -611,6 +694,57 @@ FeatureModelGraph::build( const FeatureLevel& level, const GeoExtent& extent, co
     }
 }
 
+void
+FeatureModelGraph::buildStyleGroups(const FeatureLevel& level,
+                                    const GeoExtent&    extent,
+                                    const TileKey*      key,
+                                    FeatureSourceIndex* index,
+                                    osg::Group*         group )
+{
+    // form the baseline query, which does a spatial query based on the working extent.
+    Query query;
+    if ( extent.isValid() )
+        query.bounds() = extent.bounds();
+
+    // add a tile key to the query if there is one, to support TFS-style queries
+    if ( key )
+        query.tileKey() = *key;
+
+    // now, go through any level-based selectors.
+    const StyleSelectorVector& levelSelectors = level.selectors();
+    
+    // if there are none, just build once with the default style and query.
+    if ( levelSelectors.size() == 0 )
+    {
+        // attempt to glean the style from the feature source name:
+        const Style* style = _session->styles()->getStyle( 
+            *_session->getFeatureSource()->getFeatureSourceOptions().name() );
+
+        osg::Node* node = build( *style, query, extent, index );
+        if ( node )
+            group->addChild( node );
+    }
+
+    else
+    {
+        for( StyleSelectorVector::const_iterator i = levelSelectors.begin(); i != levelSelectors.end(); ++i )
+        {
+            const StyleSelector& selector = *i;
+
+            // fetch the selector's style:
+            const Style* selectorStyle = _session->styles()->getStyle( selector.getSelectedStyleName() );
+
+            // combine the selector's query, if it has one:
+            Query selectorQuery = 
+                selector.query().isSet() ? query.combineWith( *selector.query() ) : query;
+
+            osg::Node* node = build( *selectorStyle, selectorQuery, extent, index );
+            if ( node )
+                group->addChild( node );
+        }
+    }
+}
+
 osg::Group*
 FeatureModelGraph::build(const Style&        baseStyle, 
                          const Query&        baseQuery, 
@@ -636,7 +770,9 @@ FeatureModelGraph::build(const Style&        baseStyle,
                 list.push_back( feature );
                 osg::ref_ptr<FeatureCursor> cursor = new FeatureListCursor(list);
 
-                FilterContext context( _session.get(), featureProfile, workingExtent, index );                
+                FilterContext context( _session.get(), featureProfile, workingExtent, index );
+                if ( baseQuery.tileKey().isSet() )
+                    context.tileName() = baseQuery.tileKey()->str();
 
                 // note: gridding is not supported for embedded styles.
                 osg::ref_ptr<osg::Node> node;
@@ -676,9 +812,9 @@ FeatureModelGraph::build(const Style&        baseStyle,
                 // pull the selected style...
                 const StyleSelector& sel = *i;
 
-                // combine the selection style with the incoming base style:
-                Style selectedStyle = *styles->getStyle( sel.getSelectedStyleName() );
-                Style combinedStyle = baseStyle.combineWith( selectedStyle );
+                // combine the selection style with the incoming base style. The sheet
+                // caches the combination so we don't rebuild it for every tile.
+                Style combinedStyle = styles->getCombinedStyle( baseStyle.getName(), sel.getSelectedStyleName() );
 
                 // .. and merge it's query into the existing query
                 Query combinedQuery = baseQuery.combineWith( *sel.query() );
@@ -694,13 +830,13 @@ FeatureModelGraph::build(const Style&        baseStyle,
         // otherwise, render all the features with a single style
         else
         {
-            Style combinedStyle = baseStyle;
+            const Style* combinedStyle = &baseStyle;
 
             // if there's no base style defined, choose a "default" style from the stylesheet.
             if ( baseStyle.empty() )
-                combinedStyle = *styles->getDefaultStyle();
+                combinedStyle = styles->getDefaultStyle();
 
-            osg::Group* styleGroup = createNodeForStyle( combinedStyle, baseQuery, index );
+            osg::Group* styleGroup = createNodeForStyle( *combinedStyle, baseQuery, index );
 
             if ( styleGroup && !group->containsNode(styleGroup) )
                 group->addChild( styleGroup );
@@ -732,6 +868,8 @@ FeatureModelGraph::createNodeForStyle(const Style&        style,
             query.bounds().isSet() ? *query.bounds() : extent.bounds();
 
         FilterContext context( _session.get(), featureProfile, GeoExtent(featureProfile->getSRS(), cellBounds), index );
+        if ( query.tileKey().isSet() )
+            context.tileName() = query.tileKey()->str();
 
         // start by culling our feature list to the working extent. By default, this is done by
         // checking feature centroids. But the user can override this to crop feature geometry to
@@ -813,7 +951,32 @@ FeatureModelGraph::traverse(osg::NodeVisitor& nv)
 void
 FeatureModelGraph::redraw()
 {
-    removeChildren( 0, getNumChildren() );
+    // removing the children from the index node unindexes them too.
+    osg::Group* root = getContentRoot();
+    root->removeChildren( 0, root->getNumChildren() );
+
+    // if the feature data changed since the last draw, any cached tiles are stale.
+    osg::ref_ptr<CacheBin> bin;
+    CachePolicy            policy;
+    getCache( bin, policy );
+
+    if ( bin.valid() && (int)_revision >= 0 && _session->getFeatureSource()->outOfSyncWith(_revision) )
+    {
+        if ( policy.isCacheWriteable() )
+        {
+            OE_INFO << LC << "Feature source changed; purging compiled tile cache" << std::endl;
+            bin->purge();
+
+            // re-records the source fingerprint in the bin metadata.
+            initCache();
+        }
+        else
+        {
+            Threading::ScopedMutexLock lock( _cacheMutex );
+            _cacheBin = 0L;
+        }
+    }
+
     // if there's a display schema in place, set up for quadtree paging.
     if ( _options.layout().isSet() || _useTiledSource )
     {
@@ -824,9 +987,13 @@ FeatureModelGraph::redraw()
         FeatureLevel defaultLevel( 0.0f, FLT_MAX );
         
         //Remove all current children        
-        osg::Node* node = build( defaultLevel, GeoExtent::INVALID, 0 );
+        osg::Node* node = build( defaultLevel, GeoExtent::INVALID, 0, "all" );
         if ( node )
-            addChild( node );
+        {
+            root->addChild( node );
+            if ( _featureIndex.valid() )
+                _featureIndex->index( node );
+        }
     }
 
     _session->getFeatureSource()->sync( _revision );
@@ -837,5 +1004,133 @@ void
 FeatureModelGraph::setStyles( StyleSheet* styles )
 {
     _session->setStyles( styles );
+    initCache();
     dirty();
 }
+
+void
+FeatureModelGraph::initCache()
+{
+    {
+        Threading::ScopedMutexLock lock( _cacheMutex );
+        _cacheBin = 0L;
+    }
+
+    // compiled tiles are only cached when the layer explicitly asks for it.
+    if ( !_options.cachePolicy().isSet() || _options.cachePolicy()->usage() == CachePolicy::USAGE_NO_CACHE )
+        return;
+
+    // FID tags on primitive sets do not serialize, so a cached tile could not be indexed.
+    if ( _options.featureIndexing() == true )
+    {
+        OE_INFO << LC << "Feature indexing is enabled; compiled tile caching is disabled" << std::endl;
+        return;
+    }
+
+    Cache* cache = Cache::get( _session->getDBOptions() );
+    if ( !cache || !cache->isOK() )
+        return;
+
+    CachePolicy policy = *_options.cachePolicy();
+
+    // the bin is tied to the feature data and the tiling layout:
+    Config sourceConf = _session->getFeatureSource()->getFeatureSourceOptions().getConfig();
+    Config layoutConf = _options.layout().isSet() ? _options.layout()->getConfig() : Config();
+    std::string binId = Stringify() << std::hex << hashString(sourceConf.toJSON() + layoutConf.toJSON()) << "_fmg";
+
+    osg::ref_ptr<CacheBin> bin = cache->addBin( binId );
+    if ( !bin.valid() )
+        return;
+
+    // the stylesheet is recorded in the metadata so that a style change invalidates the bin.
+    std::string stylesHash = Stringify() << std::hex << 
+        hashString( _session->styles() ? _session->styles()->getConfig().toJSON() : "" );
+
+    // so is the source data's fingerprint, so that tiles compiled in an earlier
+    // session from data that has since changed are not read back.
+    std::string fingerprint = _session->getFeatureSource()->getFingerprint();
+
+    Config meta = bin->readMetadata();
+    if ( meta.value("styles") != stylesHash || meta.value("fingerprint") != fingerprint )
+    {
+        if ( !policy.isCacheWriteable() )
+        {
+            OE_INFO << LC << "Compiled tile cache " << binId << " is out of date; ignoring it" << std::endl;
+            return;
+        }
+
+        if ( !meta.empty() )
+        {
+            OE_INFO << LC << "Stylesheet or source data changed; purging compiled tile cache " << binId << std::endl;
+            bin->purge();
+        }
+
+        Config newMeta( "feature_model_cache" );
+        newMeta.add( "source", sourceConf );
+        newMeta.add( "styles", stylesHash );
+        newMeta.add( "fingerprint", fingerprint );
+        bin->writeMetadata( newMeta );
+    }
+
+    Threading::ScopedMutexLock lock( _cacheMutex );
+    _cacheBin    = bin.get();
+    _cachePolicy = policy;
+}
+
+void
+FeatureModelGraph::getCache( osg::ref_ptr<CacheBin>& bin, CachePolicy& policy ) const
+{
+    Threading::ScopedMutexLock lock( _cacheMutex );
+    bin    = _cacheBin.get();
+    policy = _cachePolicy;
+}
+
+bool
+FeatureModelGraph::isCacheOnly() const
+{
+    Threading::ScopedMutexLock lock( _cacheMutex );
+    return _cacheBin.valid() && _cachePolicy.usage() == CachePolicy::USAGE_CACHE_ONLY;
+}
+
+osg::Group*
+FeatureModelGraph::readTileFromCache( const std::string& cacheKey )
+{
+    osg::ref_ptr<CacheBin> bin;
+    CachePolicy            policy;
+    getCache( bin, policy );
+    if ( !bin.valid() || cacheKey.empty() || !policy.isCacheReadable() )
+        return 0L;
+
+    ReadResult r = bin->readObject( cacheKey, policy.maxAge().value() );
+    if ( r.succeeded() )
+    {
+        OE_DEBUG << LC << "Read tile " << cacheKey << " from cache" << std::endl;
+        return r.release<osg::Group>();
+    }
+    return 0L;
+}
+
+void
+FeatureModelGraph::writeTileToCache( const std::string& cacheKey, osg::Group* group )
+{
+    osg::ref_ptr<CacheBin> bin;
+    CachePolicy            policy;
+    getCache( bin, policy );
+    if ( !bin.valid() || cacheKey.empty() || !policy.isCacheWriteable() || group->getNumChildren() == 0 )
+        return;
+
+    CanSerializeVisitor check;
+    group->accept( check );
+    if ( !check._ok )
+    {
+        OE_DEBUG << LC << "Tile " << cacheKey << " contains non-serializable objects; not caching" << std::endl;
+        return;
+    }
+
+    // write a plain group so the cached tile doesn't depend on the index node type.
+    osg::ref_ptr<osg::Group> record = new osg::Group();
+    for( unsigned i = 0; i < group->getNumChildren(); ++i )
+        record->addChild( group->getChild(i) );
+
+    bin->write( cacheKey, record.get() );
+}
@@ -21,6 +21,7 @@
 #include <osgEarthFeatures/BufferFilter>
 #include <osgEarthFeatures/ConvertTypeFilter>
 #include <osgEarth/Registry>
+#include <osgEarth/FileUtils>
 #include <osg/Notify>
 #include <osgDB/ReadFile>
 #include <OpenThreads/ScopedLock>
@@ -167,6 +168,19 @@ FeatureSource::getFeatureProfile() const
     return _featureProfile.get();
 }
 
+std::string
+FeatureSource::getFingerprint() const
+{
+    optional<URI> url;
+    if ( _options.getConfig().getIfSet("url", url) && !url->isRemote() )
+    {
+        time_t modified;
+        if ( getLastModifiedTime(url->full(), modified) )
+            return Stringify() << url->full() << ";" << modified;
+    }
+    return "";
+}
+
 const FeatureFilterList&
 FeatureSource::getFilters() const
 {
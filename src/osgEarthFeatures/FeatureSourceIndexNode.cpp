@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthFeatures/FeatureSourceIndexNode>
+#include <osg/Geode>
 #include <osg/MatrixTransform>
 #include <algorithm>
 
@@ -31,22 +32,73 @@ using namespace osgEarth::Features;
 
 //-----------------------------------------------------------------------------
 
-FeatureSourceIndexNode::Collect::Collect( FeatureIDDrawSetMap& index ) :
+namespace
+{
+    template<typename T>
+    struct LessFirst
+    {
+        bool operator()( const T& lhs, const T& rhs ) const { return lhs.first < rhs.first; }
+    };
+
+    template<typename T>
+    struct LessDrawable
+    {
+        bool operator()( const T& lhs, const T& rhs ) const { return lhs.drawable.get() < rhs.drawable.get(); }
+        bool operator()( const T& lhs, const osg::Drawable* rhs ) const { return lhs.drawable.get() < rhs; }
+    };
+
+    template<typename T>
+    struct LessFirstPrim
+    {
+        bool operator()( unsigned prim, const T& range ) const { return prim < range.firstPrim; }
+    };
+
+    bool getTaggedFID( const osg::Referenced* userData, FeatureID& output )
+    {
+        const RefFeatureID* fid = dynamic_cast<const RefFeatureID*>( userData );
+        if ( fid )
+            output = *fid;
+        return fid != 0L;
+    }
+
+    // finds the primitive set holding a primitive by walking the geometry's
+    // current primitive set list, and reads its tag.
+    bool getFIDFromPrimitiveSets( const osg::Geometry* geom, unsigned primIndex, FeatureID& output )
+    {
+        const osg::Geometry::PrimitiveSetList& geomPrimSets = geom->getPrimitiveSetList();
+
+        unsigned encounteredPrims = 0;
+        for( osg::Geometry::PrimitiveSetList::const_iterator p = geomPrimSets.begin(); p != geomPrimSets.end(); ++p )
+        {
+            const osg::PrimitiveSet* pset = p->get();
+            encounteredPrims += pset->getNumPrimitives();
+
+            if ( encounteredPrims > primIndex )
+                return getTaggedFID( pset->getUserData(), output );
+        }
+        return false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+FeatureSourceIndexNode::Collect::Collect( DrawableEntries& drawables, FIDNodes& nodes ) :
 osg::NodeVisitor( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN ),
-_index          ( index ),
+_drawables      ( drawables ),
+_nodes          ( nodes ),
 _psets          ( 0 )
 {
-    _index.clear();
+    // visit hidden nodes too; a hidden draw set turns its nodes off.
+    setNodeMaskOverride( ~0 );
 }
 
 void
 FeatureSourceIndexNode::Collect::apply( osg::Node& node )
 {
-    RefFeatureID* fid = dynamic_cast<RefFeatureID*>( node.getUserData() );
-    if ( fid )
+    FeatureID fid;
+    if ( getTaggedFID(node.getUserData(), fid) )
     {
-        FeatureDrawSet& drawSet = _index[*fid];
-        drawSet.nodes().push_back( &node );
+        _nodes.push_back( FIDNode(fid, &node) );
     }
     traverse(node);
 }
@@ -54,11 +106,10 @@ FeatureSourceIndexNode::Collect::apply( osg::Node& node )
 void
 FeatureSourceIndexNode::Collect::apply( osg::Geode& geode )
 {
-    RefFeatureID* fid = dynamic_cast<RefFeatureID*>( geode.getUserData() );
-    if ( fid )
+    FeatureID fid;
+    if ( getTaggedFID(geode.getUserData(), fid) )
     {
-        FeatureDrawSet& drawSet = _index[*fid];
-        drawSet.nodes().push_back( &geode );
+        _nodes.push_back( FIDNode(fid, &geode) );
     }
     else
     {
@@ -67,18 +118,44 @@ FeatureSourceIndexNode::Collect::apply( osg::Geode& geode )
             osg::Geometry* geom = dynamic_cast<osg::Geometry*>( geode.getDrawable(i) );
             if ( geom )
             {
+                _allDrawables.push_back( geom );
+
+                DrawableEntry entry;
+                entry.drawable = geom;
+
                 osg::Geometry::PrimitiveSetList& psets = geom->getPrimitiveSetList();
+                entry.numPsets = psets.size();
+
+                // record runs of consecutive primitive sets tagged with the same FID.
+                unsigned numPrims = 0;
                 for( unsigned p = 0; p < psets.size(); ++p )
                 {
-                    osg::PrimitiveSet* pset = psets[p];
-                    RefFeatureID* fid = dynamic_cast<RefFeatureID*>( pset->getUserData() );
-                    if ( fid )
+                    unsigned psetPrims = psets[p]->getNumPrimitives();
+                    if ( getTaggedFID(psets[p]->getUserData(), fid) )
                     {
-                        FeatureDrawSet& drawSet = _index[*fid];
-                        drawSet.getOrCreateSlice(geom).push_back(pset);
+                        FIDRanges& ranges = entry.ranges;
+                        if ( !ranges.empty() && ranges.back().fid == fid && ranges.back().endPset == p )
+                        {
+                            ranges.back().endPrim = numPrims + psetPrims;
+                            ranges.back().endPset = p + 1;
+                        }
+                        else
+                        {
+                            FIDRange range;
+                            range.firstPrim = numPrims;
+                            range.endPrim   = numPrims + psetPrims;
+                            range.firstPset = p;
+                            range.endPset   = p + 1;
+                            range.fid       = fid;
+                            ranges.push_back( range );
+                        }
                         _psets++;
                     }
+                    numPrims += psetPrims;
                 }
+
+                if ( !entry.ranges.empty() )
+                    _drawables.push_back( entry );
             }
         }
     }
@@ -99,12 +176,212 @@ _featureSource( featureSource )
 void
 FeatureSourceIndexNode::reindex()
 {
-    _drawSets.clear();
-
-    Collect c(_drawSets);
+    DrawableEntries drawables;
+    FIDNodes        nodes;
+    Collect c( drawables, nodes );
     this->accept( c );
 
-    OE_DEBUG << LC << "Reindexed; draw sets = " << _drawSets.size() << std::endl;
+    Threading::ScopedMutexLock lock( _mutex );
+
+    _drawables.clear();
+    _fidDrawables.clear();
+    _fidNodes.clear();
+
+    addToIndex( c );
+
+    // Keep the draw sets handed out earlier whose contents are still in the graph. A
+    // hidden draw set holds the only reference to its primitive sets, so dropping it
+    // would make the feature impossible to show again.
+    std::sort( c._allDrawables.begin(), c._allDrawables.end() );
+    for( FeatureIDDrawSetMap::iterator i = _drawSets.begin(); i != _drawSets.end(); )
+    {
+        if ( isInGraph(i->first, i->second, c._allDrawables) )
+            ++i;
+        else
+            _drawSets.erase( i++ );
+    }
+
+    OE_DEBUG << LC << "Reindexed; drawables = " << _drawables.size() << ", features = " << _fidDrawables.size() << std::endl;
+}
+
+
+void
+FeatureSourceIndexNode::index( osg::Node* subgraph )
+{
+    if ( !subgraph )
+        return;
+
+    DrawableEntries drawables;
+    FIDNodes        nodes;
+    Collect c( drawables, nodes );
+    subgraph->accept( c );
+
+    Threading::ScopedMutexLock lock( _mutex );
+
+    // indexing a subgraph again replaces its old entries; its draw sets are still
+    // in the graph, so they stay.
+    removeFromIndex( c, false );
+    addToIndex( c );
+
+    OE_DEBUG << LC << "Indexed " << drawables.size() << " drawables, " << nodes.size() << " nodes" << std::endl;
+}
+
+
+void
+FeatureSourceIndexNode::unindex( osg::Node* subgraph )
+{
+    if ( !subgraph )
+        return;
+
+    DrawableEntries drawables;
+    FIDNodes        nodes;
+    Collect c( drawables, nodes );
+    subgraph->accept( c );
+
+    Threading::ScopedMutexLock lock( _mutex );
+    removeFromIndex( c, true );
+}
+
+
+bool
+FeatureSourceIndexNode::removeChildren( unsigned pos, unsigned numChildrenToRemove )
+{
+    for( unsigned i = pos; i < pos + numChildrenToRemove && i < getNumChildren(); ++i )
+        unindex( getChild(i) );
+
+    return osg::Group::removeChildren( pos, numChildrenToRemove );
+}
+
+
+// merges collected entries into the sorted tables. Call with the mutex held.
+void
+FeatureSourceIndexNode::addToIndex( const Collect& c )
+{
+    for( DrawableEntries::const_iterator d = c._drawables.begin(); d != c._drawables.end(); ++d )
+    {
+        for( FIDRanges::const_iterator r = d->ranges.begin(); r != d->ranges.end(); ++r )
+            _fidDrawables.push_back( FIDDrawable(r->fid, d->drawable.get()) );
+    }
+    _drawables.insert( _drawables.end(), c._drawables.begin(), c._drawables.end() );
+    _fidNodes.insert( _fidNodes.end(), c._nodes.begin(), c._nodes.end() );
+
+    std::sort( _drawables.begin(), _drawables.end(), LessDrawable<DrawableEntry>() );
+    std::sort( _fidDrawables.begin(), _fidDrawables.end() );
+    _fidDrawables.erase( std::unique(_fidDrawables.begin(), _fidDrawables.end()), _fidDrawables.end() );
+    std::stable_sort( _fidNodes.begin(), _fidNodes.end(), LessFirst<FIDNode>() );
+}
+
+
+// removes everything a Collect pass found from the tables. Call with the mutex held.
+void
+FeatureSourceIndexNode::removeFromIndex( Collect& c, bool pruneDrawSets )
+{
+    // every drawable, not just the tagged ones: a drawable whose primitive sets are
+    // all hidden carries no tags at the moment, but it is still in the tables.
+    std::vector<const osg::Drawable*>& deadDrawables = c._allDrawables;
+    std::sort( deadDrawables.begin(), deadDrawables.end() );
+
+    std::vector<const osg::Node*> deadNodes;
+    deadNodes.reserve( c._nodes.size() );
+    for( FIDNodes::const_iterator n = c._nodes.begin(); n != c._nodes.end(); ++n )
+        deadNodes.push_back( n->second.get() );
+    std::sort( deadNodes.begin(), deadNodes.end() );
+
+    if ( deadDrawables.empty() && deadNodes.empty() )
+        return;
+
+    // compact each table in place, preserving the sort order.
+    unsigned out = 0;
+    for( unsigned i = 0; i < _drawables.size(); ++i )
+    {
+        if ( !std::binary_search(deadDrawables.begin(), deadDrawables.end(), (const osg::Drawable*)_drawables[i].drawable.get()) )
+        {
+            if ( out != i )
+                _drawables[out] = _drawables[i];
+            ++out;
+        }
+    }
+    _drawables.resize( out );
+
+    out = 0;
+    for( unsigned i = 0; i < _fidDrawables.size(); ++i )
+    {
+        if ( !std::binary_search(deadDrawables.begin(), deadDrawables.end(), (const osg::Drawable*)_fidDrawables[i].second) )
+            _fidDrawables[out++] = _fidDrawables[i];
+    }
+    _fidDrawables.resize( out );
+
+    out = 0;
+    for( unsigned i = 0; i < _fidNodes.size(); ++i )
+    {
+        if ( !std::binary_search(deadNodes.begin(), deadNodes.end(), (const osg::Node*)_fidNodes[i].second.get()) )
+        {
+            if ( out != i )
+                _fidNodes[out] = _fidNodes[i];
+            ++out;
+        }
+    }
+    _fidNodes.resize( out );
+
+    if ( !pruneDrawSets )
+        return;
+
+    // drop only the draw sets that reference the removed contents.
+    for( FeatureIDDrawSetMap::iterator i = _drawSets.begin(); i != _drawSets.end(); )
+    {
+        if ( references(i->second, deadDrawables, deadNodes) )
+            _drawSets.erase( i++ );
+        else
+            ++i;
+    }
+}
+
+
+bool
+FeatureSourceIndexNode::isInGraph(FeatureID                                fid,
+                                  const FeatureDrawSet&                    drawSet,
+                                  const std::vector<const osg::Drawable*>& drawables ) const
+{
+    for( FeatureDrawSet::DrawableSlices::const_iterator d = drawSet.slices().begin(); d != drawSet.slices().end(); ++d )
+    {
+        if ( !std::binary_search(drawables.begin(), drawables.end(), (const osg::Drawable*)d->drawable.get()) )
+            return false;
+    }
+
+    std::pair<FIDNodes::const_iterator, FIDNodes::const_iterator> nodes =
+        std::equal_range( _fidNodes.begin(), _fidNodes.end(), FIDNode(fid, (osg::Node*)0L), LessFirst<FIDNode>() );
+
+    for( FeatureDrawSet::Nodes::const_iterator n = drawSet.nodes().begin(); n != drawSet.nodes().end(); ++n )
+    {
+        bool found = false;
+        for( FIDNodes::const_iterator i = nodes.first; i != nodes.second && !found; ++i )
+            found = i->second.get() == n->get();
+        if ( !found )
+            return false;
+    }
+
+    return true;
+}
+
+
+bool
+FeatureSourceIndexNode::references(const FeatureDrawSet&                    drawSet,
+                                   const std::vector<const osg::Drawable*>& drawables,
+                                   const std::vector<const osg::Node*>&     nodes ) const
+{
+    for( FeatureDrawSet::DrawableSlices::const_iterator d = drawSet.slices().begin(); d != drawSet.slices().end(); ++d )
+    {
+        if ( std::binary_search(drawables.begin(), drawables.end(), (const osg::Drawable*)d->drawable.get()) )
+            return true;
+    }
+
+    for( FeatureDrawSet::Nodes::const_iterator n = drawSet.nodes().begin(); n != drawSet.nodes().end(); ++n )
+    {
+        if ( std::binary_search(nodes.begin(), nodes.end(), (const osg::Node*)n->get()) )
+            return true;
+    }
+
+    return false;
 }
 
 
@@ -142,82 +419,123 @@ FeatureSourceIndexNode::tagNode( osg::Node* node, FeatureID fid ) const
 bool
 FeatureSourceIndexNode::getFID(osg::PrimitiveSet* primSet, FeatureID& output) const
 {
-    const RefFeatureID* fid = dynamic_cast<const RefFeatureID*>( primSet->getUserData() );
-    if ( fid )
-    {
-        output = *fid;
+    if ( getTaggedFID(primSet->getUserData(), output) )
         return true;
-    }
 
     OE_DEBUG << LC << "getFID failed b/c the primSet was not tagged with a RefFeatureID" << std::endl;
     return false;
 }
 
 
+const FeatureSourceIndexNode::DrawableEntry*
+FeatureSourceIndexNode::findEntry( const osg::Drawable* drawable ) const
+{
+    DrawableEntries::const_iterator i = std::lower_bound( _drawables.begin(), _drawables.end(), drawable, LessDrawable<DrawableEntry>() );
+    return i != _drawables.end() && i->drawable.get() == drawable ? &(*i) : 0L;
+}
+
+
 bool
 FeatureSourceIndexNode::getFID(osg::Drawable* drawable, int primIndex, FeatureID& output) const
 {
     if ( drawable == 0L || primIndex < 0 )
         return false;
 
-    for( FeatureIDDrawSetMap::const_iterator i = _drawSets.begin(); i != _drawSets.end(); ++i )
+    Threading::ScopedMutexLock lock( _mutex );
+
+    const DrawableEntry* entry = findEntry( drawable );
+    const osg::Geometry* geom = drawable->asGeometry();
+    if ( entry && geom )
     {
-        const FeatureDrawSet& drawSet = i->second;
-        FeatureDrawSet::DrawableSlices::const_iterator d = drawSet.slice(drawable);
-        if ( d != drawSet.slices().end() )
+        // fast path: look the primitive up in the ranges recorded at index time, as long
+        // as the primitive set list still looks the way it did then. (Hiding a draw set,
+        // for example, removes primitive sets.)
+        FIDRanges::const_iterator r = std::upper_bound( entry->ranges.begin(), entry->ranges.end(), (unsigned)primIndex, LessFirstPrim<FIDRange>() );
+        if ( r != entry->ranges.begin() )
         {
-            const osg::Geometry* geom = drawable->asGeometry();
-            if ( geom )
+            --r;
+            FeatureID tagged;
+            if ((unsigned)primIndex < r->endPrim &&
+                geom->getNumPrimitiveSets() == entry->numPsets &&
+                getTaggedFID(geom->getPrimitiveSet(r->firstPset)->getUserData(), tagged) &&
+                tagged == r->fid )
             {
-                const osg::Geometry::PrimitiveSetList& geomPrimSets = geom->getPrimitiveSetList();
-
-                unsigned encounteredPrims = 0;
-                for( osg::Geometry::PrimitiveSetList::const_iterator p = geomPrimSets.begin(); p != geomPrimSets.end(); ++p )
-                {
-                    const osg::PrimitiveSet* pset = p->get();
-                    unsigned numPrims = pset->getNumPrimitives();
-                    encounteredPrims += numPrims;
-
-                    if ( encounteredPrims > (unsigned)primIndex )
-                    {
-                        const RefFeatureID* fid = dynamic_cast<const RefFeatureID*>( pset->getUserData() );
-                        if ( fid )
-                        {
-                            output = *fid;
-                            return true;
-                        }
-                        else
-                        {
-                            OE_DEBUG << LC << "INTERNAL: found primset, but it's not tagged with a FID" << std::endl;
-                            return false;
-                        }
-                    }
-                }
+                output = r->fid;
+                return true;
             }
         }
+
+        if ( getFIDFromPrimitiveSets(geom, primIndex, output) )
+            return true;
     }
 
     // see if we have a node in the path
-    for( osg::Node* node = drawable->getParent(0); node != 0L; node = (node->getNumParents()>0?node->getParent(0):0L) )
+    for( osg::Node* node = drawable->getNumParents() > 0 ? drawable->getParent(0) : 0L; node != 0L; node = (node->getNumParents()>0?node->getParent(0):0L) )
     {
-        RefFeatureID* fid = dynamic_cast<RefFeatureID*>( node->getUserData() );
-        if ( fid )
-        {
-            output = *fid;
+        if ( getTaggedFID(node->getUserData(), output) )
             return true;
-        }
     }
 
     return false;
 }
 
 
-
 FeatureDrawSet&
 FeatureSourceIndexNode::getDrawSet(const FeatureID& fid )
 {
     static FeatureDrawSet s_empty;
 
+    Threading::ScopedMutexLock lock( _mutex );
+
     FeatureIDDrawSetMap::iterator i = _drawSets.find(fid);
-    return i != _drawSets.end() ? i->second : s_empty;
+    if ( i != _drawSets.end() )
+        return i->second;
+
+    FeatureDrawSet drawSet;
+
+    std::pair<FIDNodes::const_iterator, FIDNodes::const_iterator> nodes =
+        std::equal_range( _fidNodes.begin(), _fidNodes.end(), FIDNode(fid, (osg::Node*)0L), LessFirst<FIDNode>() );
+
+    for( FIDNodes::const_iterator n = nodes.first; n != nodes.second; ++n )
+        drawSet.nodes().push_back( n->second.get() );
+
+    std::pair<FIDDrawables::const_iterator, FIDDrawables::const_iterator> drawables =
+        std::equal_range( _fidDrawables.begin(), _fidDrawables.end(), FIDDrawable(fid, (osg::Drawable*)0L), LessFirst<FIDDrawable>() );
+
+    for( FIDDrawables::const_iterator d = drawables.first; d != drawables.second; ++d )
+    {
+        const DrawableEntry* entry = findEntry( d->second );
+        osg::Geometry* geom = entry ? entry->drawable->asGeometry() : 0L;
+        if ( !geom )
+            continue;
+
+        FeatureDrawSet::PrimitiveSets& primSets = drawSet.getOrCreateSlice( geom );
+
+        if ( geom->getNumPrimitiveSets() == entry->numPsets )
+        {
+            for( FIDRanges::const_iterator r = entry->ranges.begin(); r != entry->ranges.end(); ++r )
+            {
+                if ( r->fid == fid )
+                {
+                    for( unsigned p = r->firstPset; p < r->endPset; ++p )
+                        primSets.push_back( geom->getPrimitiveSet(p) );
+                }
+            }
+        }
+        else
+        {
+            // the primitive set list changed since indexing; fall back on the tags.
+            FeatureID tagged;
+            for( unsigned p = 0; p < geom->getNumPrimitiveSets(); ++p )
+            {
+                if ( getTaggedFID(geom->getPrimitiveSet(p)->getUserData(), tagged) && tagged == fid )
+                    primSets.push_back( geom->getPrimitiveSet(p) );
+            }
+        }
+    }
+
+    if ( drawSet.empty() )
+        return s_empty;
+
+    return _drawSets.insert( std::make_pair(fid, drawSet) ).first->second;
 }
@@ -30,7 +30,8 @@ _session     ( session ),
 _profile     ( profile ),
 _extent      ( workingExtent, workingExtent ),
 _isGeocentric( false ),
-_index       ( index )
+_index       ( index ),
+_filterStats ( 0L )
 {
     _resourceCache = new ResourceCache( session ? session->getDBOptions() : 0L );
 
@@ -60,7 +61,9 @@ _referenceFrame       ( rhs._referenceFrame ),
 _inverseReferenceFrame( rhs._inverseReferenceFrame ),
 _optimizerHints       ( rhs._optimizerHints ),
 _resourceCache        ( rhs._resourceCache.get() ),
-_index                ( rhs._index )
+_index                ( rhs._index ),
+_tileName             ( rhs._tileName ),
+_filterStats          ( rhs._filterStats )
 {
     //nop
 }
@@ -71,6 +74,14 @@ FilterContext::getDBOptions() const
     return _session.valid() ? _session->getDBOptions() : 0L;
 }
 
+FilterStats*
+FilterContext::getFilterStats() const
+{
+    if ( _filterStats )
+        return _filterStats;
+    return _session.valid() ? _session->getFilterStats() : 0L;
+}
+
 void
 FilterContext::toLocal( Geometry* geom ) const
 {
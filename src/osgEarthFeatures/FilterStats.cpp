@@ -0,0 +1,302 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2012 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <osgEarthFeatures/FilterStats>
+#include <osgEarthFeatures/FilterContext>
+#include <osgEarth/StringUtils>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <stdlib.h>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    struct CountVertices : public osg::NodeVisitor
+    {
+        FilterStats::Counter _count;
+
+        CountVertices() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), _count(0) { }
+
+        void apply( osg::Geode& geode )
+        {
+            for( unsigned i = 0; i < geode.getNumDrawables(); ++i )
+            {
+                osg::Geometry* geom = geode.getDrawable(i)->asGeometry();
+                if ( geom && geom->getVertexArray() )
+                    _count += geom->getVertexArray()->getNumElements();
+            }
+        }
+    };
+
+    FilterStats* getEnabledStats( const FilterContext& context )
+    {
+        FilterStats* stats = context.getFilterStats();
+        return stats && stats->isEnabled() ? stats : 0L;
+    }
+
+    void addSample(FilterStats::Entry& e, double seconds,
+                   FilterStats::Counter featuresIn, FilterStats::Counter featuresOut,
+                   FilterStats::Counter verticesIn, FilterStats::Counter verticesOut )
+    {
+        e._samples++;
+        e._time        += seconds;
+        e._maxTime      = osg::maximum( e._maxTime, seconds );
+        e._featuresIn  += featuresIn;
+        e._featuresOut += featuresOut;
+        e._verticesIn  += verticesIn;
+        e._verticesOut += verticesOut;
+    }
+
+    void addEntries( const FilterStats::EntryMap& entries, Config& conf )
+    {
+        for( FilterStats::EntryMap::const_iterator i = entries.begin(); i != entries.end(); ++i )
+        {
+            const FilterStats::Entry& e = i->second;
+            Config filter( "filter" );
+            filter.add( "name",         i->first );
+            filter.add( "samples",      e._samples );
+            filter.add( "total_time",   e._time );
+            filter.add( "avg_time",     e._samples > 0 ? e._time / (double)e._samples : 0.0 );
+            filter.add( "max_time",     e._maxTime );
+            filter.add( "features_in",  e._featuresIn );
+            filter.add( "features_out", e._featuresOut );
+            filter.add( "vertices_in",  e._verticesIn );
+            filter.add( "vertices_out", e._verticesOut );
+            conf.add( filter );
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+FilterStats::Sample::Sample(const FilterContext& context,
+                            const std::string&   filter,
+                            const FeatureList&   input ) :
+_stats     ( getEnabledStats(context) ),
+_filter    ( filter ),
+_start     ( 0 ),
+_featuresIn( 0 ),
+_verticesIn( 0 )
+{
+    if ( _stats )
+    {
+        _tile       = context.tileName();
+        _featuresIn = input.size();
+        _verticesIn = FilterStats::countVertices( input );
+        _start      = osg::Timer::instance()->tick();
+    }
+}
+
+FilterStats::Sample::Sample(const FilterContext& context,
+                            const std::string&   filter,
+                            const FeatureList&   input,
+                            Counter              verticesIn ) :
+_stats     ( getEnabledStats(context) ),
+_filter    ( filter ),
+_start     ( 0 ),
+_featuresIn( 0 ),
+_verticesIn( 0 )
+{
+    if ( _stats )
+    {
+        _tile       = context.tileName();
+        _featuresIn = input.size();
+        _verticesIn = verticesIn;
+        _start      = osg::Timer::instance()->tick();
+    }
+}
+
+FilterStats::Sample::Sample(const FilterContext& context,
+                            const std::string&   filter,
+                            osg::Node*           input ) :
+_stats     ( getEnabledStats(context) ),
+_filter    ( filter ),
+_start     ( 0 ),
+_featuresIn( 0 ),
+_verticesIn( 0 )
+{
+    if ( _stats )
+    {
+        _tile       = context.tileName();
+        _verticesIn = FilterStats::countVertices( input );
+        _start      = osg::Timer::instance()->tick();
+    }
+}
+
+FilterStats::Counter
+FilterStats::Sample::done( const FeatureList& output )
+{
+    Counter verticesOut = 0;
+    if ( _stats )
+    {
+        osg::Timer_t end = osg::Timer::instance()->tick();
+        verticesOut = FilterStats::countVertices( output );
+        _stats->record(
+            _filter, _tile, osg::Timer::instance()->delta_s(_start, end),
+            _featuresIn, output.size(),
+            _verticesIn, verticesOut );
+        _stats = 0L;
+    }
+    return verticesOut;
+}
+
+void
+FilterStats::Sample::done( osg::Node* output )
+{
+    if ( _stats )
+    {
+        osg::Timer_t end = osg::Timer::instance()->tick();
+        _stats->record(
+            _filter, _tile, osg::Timer::instance()->delta_s(_start, end),
+            _featuresIn, 0,
+            _verticesIn, FilterStats::countVertices(output) );
+        _stats = 0L;
+    }
+}
+
+//------------------------------------------------------------------------
+
+FilterStats::FilterStats() :
+_enabled ( ::getenv("OSGEARTH_FILTER_STATS") != 0L ),
+_maxTiles( 256 )
+{
+    //nop
+}
+
+void
+FilterStats::setMaxTiles( unsigned value )
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    _maxTiles = value;
+    trimTiles();
+}
+
+// drops the oldest tiles past the limit. Call with the mutex held.
+void
+FilterStats::trimTiles()
+{
+    while( _tileOrder.size() > _maxTiles )
+    {
+        _tiles.erase( _tileOrder.front() );
+        _tileOrder.pop_front();
+    }
+}
+
+void
+FilterStats::record(const std::string& filter,
+                    const std::string& tile,
+                    double             seconds,
+                    Counter            featuresIn,
+                    Counter            featuresOut,
+                    Counter            verticesIn,
+                    Counter            verticesOut )
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    addSample( _entries[filter], seconds, featuresIn, featuresOut, verticesIn, verticesOut );
+
+    if ( !tile.empty() && _maxTiles > 0 )
+    {
+        TileMap::iterator t = _tiles.find( tile );
+        if ( t == _tiles.end() )
+        {
+            t = _tiles.insert( std::make_pair(tile, EntryMap()) ).first;
+            _tileOrder.push_back( tile );
+        }
+        addSample( t->second[filter], seconds, featuresIn, featuresOut, verticesIn, verticesOut );
+        trimTiles();
+    }
+}
+
+FilterStats::EntryMap
+FilterStats::getEntries() const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    return _entries;
+}
+
+FilterStats::TileMap
+FilterStats::getTileEntries() const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    return _tiles;
+}
+
+void
+FilterStats::reset()
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    _entries.clear();
+    _tiles.clear();
+    _tileOrder.clear();
+}
+
+Config
+FilterStats::getConfig() const
+{
+    EntryMap entries;
+    TileMap  tiles;
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+        entries = _entries;
+        tiles   = _tiles;
+    }
+
+    Config conf( "filter_stats" );
+    addEntries( entries, conf );
+
+    for( TileMap::const_iterator i = tiles.begin(); i != tiles.end(); ++i )
+    {
+        Config tile( "tile" );
+        tile.add( "name", i->first );
+        addEntries( i->second, tile );
+        conf.add( tile );
+    }
+    return conf;
+}
+
+FilterStats::Counter
+FilterStats::countVertices( const FeatureList& features )
+{
+    Counter count = 0;
+    for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i )
+    {
+        const Feature*  feature = i->get();
+        const Geometry* geom    = feature->getGeometry();
+        if ( geom )
+            count += geom->getTotalPointCount();
+    }
+    return count;
+}
+
+FilterStats::Counter
+FilterStats::countVertices( osg::Node* node )
+{
+    if ( !node )
+        return 0;
+
+    CountVertices visitor;
+    node->accept( visitor );
+    return visitor._count;
+}
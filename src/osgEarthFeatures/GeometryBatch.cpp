@@ -0,0 +1,226 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2012 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/GeometryBatch>
+#include <algorithm>
+
+#define LC "[GeometryBatch] "
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    void addPart( const Geometry* geom, GeometryBatch::PartType type, Vec3dVector& points, std::vector<GeometryBatch::Part>& parts )
+    {
+        GeometryBatch::Part part;
+        part.first = points.size();
+        part.count = geom->size();
+        part.type  = type;
+        parts.push_back( part );
+        points.insert( points.end(), geom->begin(), geom->end() );
+    }
+
+    // Walks a geometry in a fixed order: multi-geometry components in order,
+    // and each polygon followed by its holes. scatterGeometry must match.
+    void gatherGeometry( const Geometry* geom, Vec3dVector& points, std::vector<GeometryBatch::Part>& parts )
+    {
+        switch( geom->getType() )
+        {
+        case Geometry::TYPE_MULTI:
+            {
+                const GeometryCollection& comps = static_cast<const MultiGeometry*>(geom)->getComponents();
+                for( GeometryCollection::const_iterator i = comps.begin(); i != comps.end(); ++i )
+                    gatherGeometry( i->get(), points, parts );
+            }
+            break;
+        case Geometry::TYPE_POLYGON:
+            {
+                addPart( geom, GeometryBatch::PART_POLYGON, points, parts );
+                const RingCollection& holes = static_cast<const Polygon*>(geom)->getHoles();
+                for( RingCollection::const_iterator i = holes.begin(); i != holes.end(); ++i )
+                    addPart( i->get(), GeometryBatch::PART_HOLE, points, parts );
+            }
+            break;
+        case Geometry::TYPE_RING:
+            addPart( geom, GeometryBatch::PART_RING, points, parts );
+            break;
+        case Geometry::TYPE_LINESTRING:
+            addPart( geom, GeometryBatch::PART_LINESTRING, points, parts );
+            break;
+        default:
+            addPart( geom, GeometryBatch::PART_POINTSET, points, parts );
+            break;
+        }
+    }
+
+    void scatterPart( Geometry* geom, const Vec3dVector& points, const std::vector<GeometryBatch::Part>& parts, unsigned& partIndex )
+    {
+        const GeometryBatch::Part& part = parts[partIndex++];
+        std::copy( points.begin() + part.first, points.begin() + part.first + part.count, geom->begin() );
+    }
+
+    void scatterGeometry( Geometry* geom, const Vec3dVector& points, const std::vector<GeometryBatch::Part>& parts, unsigned& partIndex )
+    {
+        if ( geom->getType() == Geometry::TYPE_MULTI )
+        {
+            GeometryCollection& comps = static_cast<MultiGeometry*>(geom)->getComponents();
+            for( GeometryCollection::iterator i = comps.begin(); i != comps.end(); ++i )
+                scatterGeometry( i->get(), points, parts, partIndex );
+        }
+        else
+        {
+            scatterPart( geom, points, parts, partIndex );
+            if ( geom->getType() == Geometry::TYPE_POLYGON )
+            {
+                RingCollection& holes = static_cast<Polygon*>(geom)->getHoles();
+                for( RingCollection::iterator i = holes.begin(); i != holes.end(); ++i )
+                    scatterPart( i->get(), points, parts, partIndex );
+            }
+        }
+    }
+
+    template<typename T>
+    T* createPart( const Vec3dVector& points, const GeometryBatch::Part& part )
+    {
+        T* geom = new T( part.count );
+        geom->insert( geom->end(), points.begin() + part.first, points.begin() + part.first + part.count );
+        return geom;
+    }
+}
+
+//------------------------------------------------------------------------
+
+GeometryBatch::GeometryBatch() :
+_featureParts( 1, 0 )
+{
+    //nop
+}
+
+GeometryBatch::GeometryBatch( const FeatureList& features )
+{
+    gather( features );
+}
+
+void
+GeometryBatch::gather( const FeatureList& features )
+{
+    _points.clear();
+    _parts.clear();
+    _featureParts.clear();
+    _featureMulti.clear();
+
+    unsigned numPoints = 0;
+    for( FeatureList::const_iterator f = features.begin(); f != features.end(); ++f )
+    {
+        const Geometry* geom = static_cast<const Feature*>(f->get())->getGeometry();
+        if ( geom )
+            numPoints += geom->getTotalPointCount();
+    }
+    _points.reserve( numPoints );
+    _featureParts.reserve( features.size() + 1 );
+    _featureMulti.reserve( features.size() );
+
+    for( FeatureList::const_iterator f = features.begin(); f != features.end(); ++f )
+    {
+        const Geometry* geom = static_cast<const Feature*>(f->get())->getGeometry();
+        _featureParts.push_back( _parts.size() );
+        _featureMulti.push_back( geom && geom->getType() == Geometry::TYPE_MULTI );
+        if ( geom )
+            gatherGeometry( geom, _points, _parts );
+    }
+    _featureParts.push_back( _parts.size() );
+}
+
+void
+GeometryBatch::scatter( FeatureList& features ) const
+{
+    unsigned partIndex = 0;
+    for( FeatureList::iterator f = features.begin(); f != features.end() && partIndex < _parts.size(); ++f )
+    {
+        Geometry* geom = f->get()->getGeometry();
+        if ( geom )
+            scatterGeometry( geom, _points, _parts, partIndex );
+    }
+}
+
+Geometry*
+GeometryBatch::createGeometry( unsigned featureIndex ) const
+{
+    unsigned first = _featureParts[featureIndex];
+    unsigned last  = _featureParts[featureIndex+1];
+
+    GeometryCollection comps;
+    for( unsigned p = first; p < last; ++p )
+    {
+        const Part& part = _parts[p];
+        switch( part.type )
+        {
+        case PART_POLYGON:
+            comps.push_back( createPart<Polygon>(_points, part) );
+            break;
+        case PART_HOLE:
+            if ( !comps.empty() && comps.back()->getType() == Geometry::TYPE_POLYGON )
+                static_cast<Polygon*>(comps.back().get())->getHoles().push_back( createPart<Ring>(_points, part) );
+            break;
+        case PART_RING:
+            comps.push_back( createPart<Ring>(_points, part) );
+            break;
+        case PART_LINESTRING:
+            comps.push_back( createPart<LineString>(_points, part) );
+            break;
+        default:
+            comps.push_back( createPart<PointSet>(_points, part) );
+            break;
+        }
+    }
+
+    if ( _featureMulti[featureIndex] || comps.size() > 1 )
+        return new MultiGeometry( comps );
+    else if ( comps.size() == 1 )
+        return comps.front().release();
+    else
+        return 0L;
+}
+
+void
+GeometryBatch::transform( const osg::Matrixd& matrix )
+{
+    for( Vec3dVector::iterator i = _points.begin(); i != _points.end(); ++i )
+        *i = *i * matrix;
+}
+
+bool
+GeometryBatch::transform( const SpatialReference* fromSRS, const SpatialReference* toSRS )
+{
+    if ( !fromSRS || !toSRS )
+        return false;
+    return _points.empty() || fromSRS->transform( _points, toSRS );
+}
+
+osg::BoundingBoxd
+GeometryBatch::getBounds() const
+{
+    osg::BoundingBoxd box;
+    for( Vec3dVector::const_iterator i = _points.begin(); i != _points.end(); ++i )
+        box.expandBy( *i );
+    return box;
+}
@@ -25,7 +25,12 @@
 #include <osgEarthFeatures/ScatterFilter>
 #include <osgEarthFeatures/SubstituteModelFilter>
 #include <osgEarthFeatures/TessellateOperator>
+#include <osgEarthSymbology/MeshConsolidator>
+#include <osgEarth/TaskService>
 #include <osg/MatrixTransform>
+#include <OpenThreads/Thread>
+#include <typeinfo>
+#include <set>
 #include <osg/Timer>
 #include <osgDB/WriteFile>
 
@@ -42,6 +47,119 @@ namespace
     osg::ref_ptr<PointSymbol>   s_defaultPointSymbol   = new PointSymbol();
     osg::ref_ptr<LineSymbol>    s_defaultLineSymbol    = new LineSymbol();
     osg::ref_ptr<PolygonSymbol> s_defaultPolygonSymbol = new PolygonSymbol();
+
+    // Shared thread pool for chunked compilation.
+    TaskService* getCompileService()
+    {
+        static Threading::Mutex           s_mutex;
+        static osg::ref_ptr<TaskService>  s_service;
+
+        Threading::ScopedMutexLock lock( s_mutex );
+        if ( !s_service.valid() )
+        {
+            int numThreads = osg::maximum( 1, OpenThreads::GetNumberOfProcessors() );
+            s_service = new TaskService( "GeometryCompiler", numThreads );
+        }
+        return s_service.get();
+    }
+
+    // Compiles one chunk of a large working set.
+    struct CompileChunk
+    {
+        void init( GeometryCompiler* compiler, FeatureList* features, const Style* style, const FilterContext* context )
+        {
+            _compiler = compiler;
+            _features = features;
+            _style    = style;
+            _context  = context;
+        }
+
+        void execute()
+        {
+            _output = _compiler->compile( *_features, *_style, *_context );
+        }
+
+        GeometryCompiler*       _compiler;
+        FeatureList*            _features;
+        const Style*            _style;
+        const FilterContext*    _context;
+        osg::ref_ptr<osg::Node> _output;
+    };
+
+    bool isMergeable( const osg::Node* a, const osg::Node* b )
+    {
+        if ( typeid(*a) != typeid(*b) || a->getName() != b->getName() )
+            return false;
+
+        // tagged nodes (feature IDs, etc) must stay separate.
+        if ( a->getUserData() || b->getUserData() )
+            return false;
+
+        const osg::StateSet* sa = a->getStateSet();
+        const osg::StateSet* sb = b->getStateSet();
+        if ( sa != sb && (!sa || !sb || sa->compare(*sb, true) != 0) )
+            return false;
+
+        const osg::MatrixTransform* ma = dynamic_cast<const osg::MatrixTransform*>(a);
+        if ( ma && ma->getMatrix() != static_cast<const osg::MatrixTransform*>(b)->getMatrix() )
+            return false;
+
+        return true;
+    }
+
+    /**
+     * Folds the output of one chunk into the output of another. At the top level,
+     * groups and delocalization transforms with matching state are fused; below that,
+     * geodes with equivalent state are combined. Everything else is appended in order.
+     */
+    void mergeChunk( osg::Group* dest, osg::Group* src, bool topLevel, std::set<osg::Geode*>& mergedGeodes )
+    {
+        std::vector<osg::Geode*> destGeodes;
+        std::vector<osg::Group*> destGroups;
+        for( unsigned i = 0; i < dest->getNumChildren(); ++i )
+        {
+            osg::Node* child = dest->getChild(i);
+            if ( dynamic_cast<osg::Geode*>(child) )
+                destGeodes.push_back( static_cast<osg::Geode*>(child) );
+            else if ( topLevel && child->asGroup() )
+                destGroups.push_back( child->asGroup() );
+        }
+
+        for( unsigned i = 0; i < src->getNumChildren(); ++i )
+        {
+            osg::Node* child = src->getChild(i);
+            bool merged = false;
+
+            osg::Geode* geode = dynamic_cast<osg::Geode*>( child );
+            if ( geode )
+            {
+                for( unsigned g = 0; g < destGeodes.size() && !merged; ++g )
+                {
+                    if ( isMergeable(destGeodes[g], geode) )
+                    {
+                        for( unsigned d = 0; d < geode->getNumDrawables(); ++d )
+                            destGeodes[g]->addDrawable( geode->getDrawable(d) );
+                        mergedGeodes.insert( destGeodes[g] );
+                        merged = true;
+                    }
+                }
+            }
+            else if ( topLevel && child->asGroup() )
+            {
+                for( unsigned g = 0; g < destGroups.size() && !merged; ++g )
+                {
+                    if ( isMergeable(destGroups[g], child) )
+                    {
+                        mergeChunk( destGroups[g], child->asGroup(), false, mergedGeodes );
+                        merged = true;
+                    }
+                }
+            }
+
+            if ( !merged )
+                dest->addChild( child );
+        }
+    }
 }
 
 //-----------------------------------------------------------------------
@@ -51,7 +169,9 @@ ConfigOptions      ( conf ),
 _maxGranularity_deg( 1.0 ),
 _mergeGeometry     ( false ),
 _clustering        ( true ),
-_ignoreAlt         ( false )
+_ignoreAlt         ( false ),
+_parallelCompile   ( false ),
+_parallelChunkSize ( 1000u )
 {
     fromConfig(_conf);
 }
@@ -64,6 +184,8 @@ GeometryCompilerOptions::fromConfig( const Config& conf )
     conf.getIfSet   ( "clustering",       _clustering );
     conf.getObjIfSet( "feature_name",     _featureNameExpr );
     conf.getIfSet   ( "ignore_altitude",  _ignoreAlt );
+    conf.getIfSet   ( "parallel_compile",    _parallelCompile );
+    conf.getIfSet   ( "parallel_chunk_size", _parallelChunkSize );
     conf.getIfSet   ( "geo_interpolation", "great_circle", _geoInterp, GEOINTERP_GREAT_CIRCLE );
     conf.getIfSet   ( "geo_interpolation", "rhumb_line",   _geoInterp, GEOINTERP_RHUMB_LINE );
 }
@@ -77,6 +199,8 @@ GeometryCompilerOptions::getConfig() const
     conf.addIfSet   ( "clustering",       _clustering );
     conf.addObjIfSet( "feature_name",     _featureNameExpr );
     conf.addIfSet   ( "ignore_altitude",  _ignoreAlt );
+    conf.addIfSet   ( "parallel_compile",    _parallelCompile );
+    conf.addIfSet   ( "parallel_chunk_size", _parallelChunkSize );
     conf.addIfSet   ( "geo_interpolation", "great_circle", _geoInterp, GEOINTERP_GREAT_CIRCLE );
     conf.addIfSet   ( "geo_interpolation", "rhumb_line",   _geoInterp, GEOINTERP_RHUMB_LINE );
     return conf;
@@ -153,10 +277,169 @@ GeometryCompiler::compile(FeatureList&          workingSet,
                           const Style&          style,
                           const FilterContext&  context)
 {
-#ifdef PROFILING
-    osg::Timer_t p_start = osg::Timer::instance()->tick();
-    unsigned p_features = workingSet.size();
-#endif
+    if (_options.parallelCompile() == true &&
+        workingSet.size() > 2 * osg::maximum(1u, *_options.parallelChunkSize()) )
+    {
+        return compileParallel( workingSet, style, context );
+    }
+    else
+    {
+        return compileFeatures( workingSet, style, context );
+    }
+}
+
+osg::Node*
+GeometryCompiler::compileParallel(FeatureList&          workingSet,
+                                  const Style&          style,
+                                  const FilterContext&  context)
+{
+    // resolve the default symbology up front so that every chunk agrees on it,
+    // regardless of which feature happens to come first in the chunk.
+    Style chunkStyle( style, osg::CopyOp::SHALLOW_COPY );
+    if (!style.has<PointSymbol>()   && !style.has<LineSymbol>()      && 
+        !style.has<PolygonSymbol>() && !style.has<MarkerSymbol>()    &&
+        !style.has<TextSymbol>()    && !style.has<ExtrusionSymbol>() &&
+        workingSet.size() > 0 )
+    {
+        Geometry* geom = workingSet.front()->getGeometry();
+        if ( geom )
+        {
+            switch( geom->getComponentType() )
+            {
+            case Geometry::TYPE_LINESTRING:
+            case Geometry::TYPE_RING:
+                chunkStyle.add( s_defaultLineSymbol.get() ); break;
+            case Geometry::TYPE_POINTSET:
+                chunkStyle.add( s_defaultPointSymbol.get() ); break;
+            case Geometry::TYPE_POLYGON:
+                chunkStyle.add( s_defaultPolygonSymbol.get() ); break;
+            default: break;
+            }
+        }
+    }
+
+    // split the working set into contiguous chunks. Output order follows chunk
+    // order, so the result is deterministic no matter how the tasks get scheduled.
+    unsigned chunkSize = osg::maximum( 1u, *_options.parallelChunkSize() );
+    unsigned numChunks = (workingSet.size() + chunkSize - 1) / chunkSize;
+
+    std::vector<FeatureList> chunks( numChunks );
+    for( unsigned c = 0; c < numChunks; ++c )
+    {
+        FeatureList::iterator end = workingSet.begin();
+        for( unsigned k = 0; k < chunkSize && end != workingSet.end(); ++k )
+            ++end;
+        chunks[c].splice( chunks[c].end(), workingSet, workingSet.begin(), end );
+    }
+
+    // each chunk gets its own filter context since the filters modify it.
+    std::vector<FilterContext> contexts( numChunks, context );
+
+    // with statistics on, each chunk records into a collector of its own, so that
+    // the pass can be recorded as one sample per filter once all the chunks finish.
+    FilterStats* stats = context.getFilterStats();
+    std::vector< osg::ref_ptr<FilterStats> > chunkStats;
+    if ( stats && stats->isEnabled() )
+    {
+        chunkStats.resize( numChunks );
+        for( unsigned c = 0; c < numChunks; ++c )
+        {
+            chunkStats[c] = new FilterStats();
+            chunkStats[c]->setEnabled( true );
+            chunkStats[c]->setMaxTiles( 0 );
+            contexts[c].setFilterStats( chunkStats[c].get() );
+        }
+    }
+
+    GeometryCompiler serial( _options );
+    serial.options().parallelCompile() = false;
+
+    // queue up all but the first chunk; the calling thread compiles that one.
+    std::vector< osg::ref_ptr< ParallelTask<CompileChunk> > > tasks( numChunks );
+    Threading::MultiEvent semaphore( numChunks-1 );
+    TaskService* service = getCompileService();
+
+    for( unsigned c = 1; c < numChunks; ++c )
+    {
+        tasks[c] = new ParallelTask<CompileChunk>( &semaphore );
+        tasks[c]->init( &serial, &chunks[c], &chunkStyle, &contexts[c] );
+        service->add( tasks[c].get() );
+    }
+
+    CompileChunk first;
+    first.init( &serial, &chunks[0], &chunkStyle, &contexts[0] );
+    first.execute();
+
+    semaphore.wait();
+
+    if ( !chunkStats.empty() )
+    {
+        // the time of a sample is the total across chunks, i.e. the work done,
+        // rather than the elapsed time.
+        FilterStats::EntryMap pass;
+        for( unsigned c = 0; c < numChunks; ++c )
+        {
+            FilterStats::EntryMap entries = chunkStats[c]->getEntries();
+            for( FilterStats::EntryMap::const_iterator i = entries.begin(); i != entries.end(); ++i )
+            {
+                FilterStats::Entry& e = pass[i->first];
+                e._time        += i->second._time;
+                e._featuresIn  += i->second._featuresIn;
+                e._featuresOut += i->second._featuresOut;
+                e._verticesIn  += i->second._verticesIn;
+                e._verticesOut += i->second._verticesOut;
+            }
+        }
+
+        for( FilterStats::EntryMap::const_iterator i = pass.begin(); i != pass.end(); ++i )
+        {
+            const FilterStats::Entry& e = i->second;
+            stats->record( i->first, context.tileName(), e._time, e._featuresIn, e._featuresOut, e._verticesIn, e._verticesOut );
+        }
+    }
+
+    // merge the chunk results in order.
+    osg::ref_ptr<osg::Group> result = dynamic_cast<osg::Group*>( first._output.get() );
+    std::set<osg::Geode*> mergedGeodes;
+
+    for( unsigned c = 1; c < numChunks; ++c )
+    {
+        osg::Group* chunkResult = dynamic_cast<osg::Group*>( tasks[c]->_output.get() );
+        if ( !chunkResult )
+            continue;
+
+        if ( !result.valid() )
+            result = chunkResult;
+        else
+            mergeChunk( result.get(), chunkResult, true, mergedGeodes );
+    }
+
+    // re-consolidate the combined geodes, just like the filters do for a single chunk.
+    if ( !_options.featureName().isSet() )
+    {
+        for( std::set<osg::Geode*>::iterator i = mergedGeodes.begin(); i != mergedGeodes.end(); ++i )
+            MeshConsolidator::run( **i );
+    }
+
+    // hand the (munged) features back to the caller.
+    for( unsigned c = 0; c < numChunks; ++c )
+        workingSet.splice( workingSet.end(), chunks[c] );
+
+    OE_DEBUG << LC << "Compiled " << workingSet.size() << " features in " << numChunks << " chunks" << std::endl;
+
+    return result.release();
+}
+
+osg::Node*
+GeometryCompiler::compileFeatures(FeatureList&          workingSet,
+                                  const Style&          style,
+                                  const FilterContext&  context)
+{
+    // per-filter statistics (no-op unless enabled in the session)
+    FilterStats::Sample compileSample( context, "GeometryCompiler", workingSet );
+
+    // vertex count of the working set, handed from one sample to the next.
+    FilterStats::Counter vertices = compileSample.verticesIn();
 
     osg::ref_ptr<osg::Group> resultGroup = new osg::Group();
 
@@ -191,7 +474,9 @@ GeometryCompiler::compile(FeatureList&          workingSet,
     {
         TemplateFeatureFilter<TessellateOperator> filter;
         filter.setNumPartitions( *line->tessellation() );
+        FilterStats::Sample sample( context, "TessellateOperator", workingSet, vertices );
         sharedCX = filter.push( workingSet, sharedCX );
+        vertices = sample.done( workingSet );
     }
 
     // if the style was empty, use some defaults based on the geometry type of the
@@ -225,7 +510,9 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         {
             resample.maxLength() = *_options.resampleMaxLength();
         }                   
-        sharedCX = resample.push( workingSet, sharedCX );        
+        FilterStats::Sample sample( context, "ResampleFilter", workingSet, vertices );
+        sharedCX = resample.push( workingSet, sharedCX );
+        vertices = sample.done( workingSet );
     }    
     
     bool altRequired =
@@ -248,19 +535,25 @@ GeometryCompiler::compile(FeatureList&          workingSet,
             scatter.setDensity( *marker->density() );
             scatter.setRandom( marker->placement() == MarkerSymbol::PLACEMENT_RANDOM );
             scatter.setRandomSeed( *marker->randomSeed() );
+            FilterStats::Sample sample( context, "ScatterFilter", workingSet, vertices );
             markerCX = scatter.push( workingSet, markerCX );
+            vertices = sample.done( workingSet );
         }
         else if ( marker->placement() == MarkerSymbol::PLACEMENT_CENTROID )
         {
             CentroidFilter centroid;
+            FilterStats::Sample sample( context, "CentroidFilter", workingSet, vertices );
             centroid.push( workingSet, markerCX );
+            vertices = sample.done( workingSet );
         }
 
         if ( altRequired )
         {
             AltitudeFilter clamp;
             clamp.setPropertiesFromStyle( style );
+            FilterStats::Sample sample( context, "AltitudeFilter", workingSet, vertices );
             markerCX = clamp.push( workingSet, markerCX );
+            vertices = sample.done( workingSet );
 
             // don't set this; we changed the input data.
             //altRequired = false;
@@ -278,7 +571,9 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         if ( _options.featureName().isSet() )
             sub.setFeatureNameExpr( *_options.featureName() );
 
+        FilterStats::Sample sample( context, "SubstituteModelFilter", workingSet, vertices );
         osg::Node* node = sub.push( workingSet, markerCX );
+        sample.done( node );
         if ( node )
         {
             resultGroup->addChild( node );
@@ -292,7 +587,9 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         {
             AltitudeFilter clamp;
             clamp.setPropertiesFromStyle( style );
+            FilterStats::Sample sample( context, "AltitudeFilter", workingSet, vertices );
             sharedCX = clamp.push( workingSet, sharedCX );
+            vertices = sample.done( workingSet );
             altRequired = false;
         }
 
@@ -303,7 +600,9 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         if ( _options.featureName().isSet() )
             extrude.setFeatureNameExpr( *_options.featureName() );
 
+        FilterStats::Sample sample( context, "ExtrudeGeometryFilter", workingSet, vertices );
         osg::Node* node = extrude.push( workingSet, sharedCX );
+        sample.done( node );
         if ( node )
         {
             resultGroup->addChild( node );
@@ -317,7 +616,9 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         {
             AltitudeFilter clamp;
             clamp.setPropertiesFromStyle( style );
+            FilterStats::Sample sample( context, "AltitudeFilter", workingSet, vertices );
             sharedCX = clamp.push( workingSet, sharedCX );
+            vertices = sample.done( workingSet );
             altRequired = false;
         }
 
@@ -331,7 +632,9 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         if ( _options.featureName().isSet() )
             filter.featureName() = *_options.featureName();
 
+        FilterStats::Sample sample( context, "BuildGeometryFilter", workingSet, vertices );
         osg::Node* node = filter.push( workingSet, sharedCX );
+        sample.done( node );
         if ( node )
         {
             resultGroup->addChild( node );
@@ -344,12 +647,16 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         {
             AltitudeFilter clamp;
             clamp.setPropertiesFromStyle( style );
+            FilterStats::Sample sample( context, "AltitudeFilter", workingSet, vertices );
             sharedCX = clamp.push( workingSet, sharedCX );
+            vertices = sample.done( workingSet );
             altRequired = false;
         }
 
         BuildTextFilter filter( style );
+        FilterStats::Sample sample( context, "BuildTextFilter", workingSet, vertices );
         osg::Node* node = filter.push( workingSet, sharedCX );
+        sample.done( node );
         if ( node )
         {
             resultGroup->addChild( node );
@@ -360,12 +667,7 @@ GeometryCompiler::compile(FeatureList&          workingSet,
 
     //osgDB::writeNodeFile( *(resultGroup.get()), "out.osg" );
 
-#ifdef PROFILING
-    osg::Timer_t p_end = osg::Timer::instance()->tick();
-    OE_INFO << LC
-        << "features = " << p_features <<
-        << " ,time = " << osg::Timer::instance()->delta_s(p_start, p_end) << " s." << std::endl;
-#endif
+    compileSample.done( resultGroup.get() );
 
     return resultGroup.release();
 }
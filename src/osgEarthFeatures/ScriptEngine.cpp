@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthFeatures/ScriptEngine>
+#include <osgEarthFeatures/Feature>
 #include <osgEarth/Notify>
 #include <osgEarth/Registry>
 #include <osgDB/ReadFile>
@@ -66,6 +67,22 @@ ScriptEngineOptions::getConfig() const
 
 //------------------------------------------------------------------------
 
+bool
+ScriptEngine::run(const std::string& code, const FeatureList& features, ScriptResultVector& results, FilterContext const* context)
+{
+    bool ok = true;
+    results.reserve( results.size() + features.size() );
+    for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i )
+    {
+        results.push_back( run(code, i->get(), context) );
+        if ( !results.back().success() )
+            ok = false;
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------
+
 #undef  LC
 #define LC "[ScriptEngineFactory] "
 #define SCRIPT_ENGINE_OPTIONS_TAG "__osgEarth::Features::ScriptEngineOptions"
@@ -40,7 +40,8 @@ osg::Referenced( true ),
 _map           ( map ),
 _mapInfo       ( map ),
 _featureSource ( source ),
-_dbOptions     ( dbOptions )
+_dbOptions     ( dbOptions ),
+_filterStats   ( new FilterStats() )
 {
     if ( styles )
         setStyles( styles );
@@ -21,6 +21,7 @@
 #include <osgEarthSymbology/MeshConsolidator>
 #include <osgEarth/HTTPClient>
 #include <osgEarth/ECEF>
+#include <osgEarth/InstanceGroup>
 #include <osg/AutoTransform>
 #include <osg/Drawable>
 #include <osg/Geode>
@@ -29,6 +30,7 @@
 #include <osgUtil/Optimizer>
 #include <list>
 #include <deque>
+#include <map>
 
 #define LC "[SubstituteModelFilter] "
 
@@ -41,6 +43,14 @@ using namespace osgEarth::Symbology;
 namespace
 {
     static osg::Node* s_defaultModel =0L;
+
+    // instances of one marker model, gathered for bulk placement.
+    struct InstanceBatch
+    {
+        osg::ref_ptr<osg::Node> _model;
+        std::vector<osg::Vec3d> _points;
+        std::vector<float>      _scales;
+    };
 }
 
 //------------------------------------------------------------------------
@@ -69,13 +79,43 @@ SubstituteModelFilter::process(const FeatureList&           features,
     StringExpression  uriEx   = *symbol->url();
     NumericExpression scaleEx = *symbol->scale();
 
-    for( FeatureList::const_iterator f = features.begin(); f != features.end(); ++f )
+    osg::Matrixd rotationMatrix;
+    if ( symbol->orientation().isSet() )
+    {
+        osg::Vec3d hpr = *symbol->orientation();
+        //Rotation in HPR
+        //Apply the rotation            
+        rotationMatrix.makeRotate( 
+            osg::DegreesToRadians(hpr.y()), osg::Vec3(1,0,0),
+            osg::DegreesToRadians(hpr.x()), osg::Vec3(0,0,1),
+            osg::DegreesToRadians(hpr.z()), osg::Vec3(0,1,0) );            
+    }
+
+    // Unless each instance needs its own node (to tag it with a feature ID or
+    // to name it), collect the instances of each model and place them all with
+    // a single InstanceGroup.
+    bool instancing = !context.featureIndex() && _featureNameExpr.empty();
+    std::map< osg::Node*, InstanceBatch > batches;
+
+    // evaluate the per-feature expressions up front, so scripts run in a batch.
+    std::vector<std::string> uris;
+    Feature::eval( uriEx, features, &context, uris );
+
+    std::vector<double> scales;
+    if ( symbol->scale().isSet() )
+        Feature::eval( scaleEx, features, &context, scales );
+
+    std::vector<std::string> names;
+    if ( !_featureNameExpr.empty() )
+        Feature::eval( _featureNameExpr, features, &context, names );
+
+    unsigned n = 0;
+    for( FeatureList::const_iterator f = features.begin(); f != features.end(); ++f, ++n )
     {
         Feature* input = f->get();
 
         // evaluate the marker URI expression:
-        StringExpression uriEx = *symbol->url();
-        URI markerURI( input->eval(uriEx, &context), uriEx.uriContext() );
+        URI markerURI( uris[n], uriEx.uriContext() );
 
         // find the corresponding marker in the cache
         MarkerResource* marker = 0L;
@@ -98,24 +138,12 @@ SubstituteModelFilter::process(const FeatureList&           features,
 
         if ( symbol->scale().isSet() )
         {
-            scale = input->eval( scaleEx, &context );
+            scale = scales[n];
             if ( scale == 0.0 )
                 scale = 1.0;
             scaleMatrix = osg::Matrix::scale( scale, scale, scale );
         }
         
-        osg::Matrixd rotationMatrix;
-        if ( symbol->orientation().isSet() )
-        {
-            osg::Vec3d hpr = *symbol->orientation();
-            //Rotation in HPR
-            //Apply the rotation            
-            rotationMatrix.makeRotate( 
-                osg::DegreesToRadians(hpr.y()), osg::Vec3(1,0,0),
-                osg::DegreesToRadians(hpr.x()), osg::Vec3(0,0,1),
-                osg::DegreesToRadians(hpr.z()), osg::Vec3(0,1,0) );            
-        }
-
         // how that we have a marker source, create a node for it
         std::pair<URI,float> key( markerURI, scale );
         osg::ref_ptr<osg::Node>& model = uniqueModels[key];
@@ -139,7 +167,24 @@ SubstituteModelFilter::process(const FeatureList&           features,
             }
         }
 
-        if ( model.valid() )
+        if ( model.valid() && instancing )
+        {
+            InstanceBatch& batch = batches[model.get()];
+            batch._model = model.get();
+
+            GeometryIterator gi( input->getGeometry(), false );
+            while( gi.hasMore() )
+            {
+                Geometry* geom = gi.next();
+                for( unsigned i=0; i<geom->size(); ++i )
+                {
+                    batch._points.push_back( (*geom)[i] );
+                    batch._scales.push_back( scale );
+                }
+            }
+        }
+
+        else if ( model.valid() )
         {
             GeometryIterator gi( input->getGeometry(), false );
             while( gi.hasMore() )
@@ -175,17 +220,44 @@ SubstituteModelFilter::process(const FeatureList&           features,
                         context.featureIndex()->tagNode( xform, input->getFID() );
 
                     // name the feature if necessary
-                    if ( !_featureNameExpr.empty() )
+                    if ( !names.empty() && !names[n].empty() )
                     {
-                        const std::string& name = input->eval( _featureNameExpr, &context);
-                        if ( !name.empty() )
-                            xform->setName( name );
+                        xform->setName( names[n] );
                     }
                 }
             }
         }
     }
 
+    for( std::map<osg::Node*, InstanceBatch>::iterator b = batches.begin(); b != batches.end(); ++b )
+    {
+        InstanceBatch& batch = b->second;
+
+        // the "rotation" element lets us re-orient each instance to ensure it's pointing up.
+        std::vector<osg::Matrixd> rotations;
+        if ( makeECEF )
+        {
+            ECEF::transformAndGetRotationMatrices( batch._points, context.profile()->getSRS(), batch._points, rotations );
+        }
+
+        InstanceGroup* instances = new InstanceGroup();
+        instances->setDataVariance( osg::Object::STATIC );
+        instances->addChild( batch._model.get() );
+        instances->reserveInstances( batch._points.size() );
+
+        for( unsigned i=0; i<batch._points.size(); ++i )
+        {
+            osg::Matrixd mat = makeECEF ?
+                rotationMatrix * rotations[i] * osg::Matrixd::translate( batch._points[i] ) * _world2local :
+                rotationMatrix * osg::Matrixd::translate( batch._points[i] ) * _world2local;
+
+            // the scale is uniform, so it can be applied after the rotation.
+            instances->addInstance( mat.getTrans(), mat.getRotate(), batch._scales[i] );
+        }
+
+        attachPoint->addChild( instances );
+    }
+
     return true;
 }
 
@@ -212,6 +284,11 @@ struct ClusterVisitor : public osg::NodeVisitor
         NumericExpression scaleEx = *_symbol->scale();
         osg::Matrixd scaleMatrix;
 
+        // evaluate the scales once for all the drawables, so scripts run in a batch.
+        std::vector<double> scales;
+        if ( _symbol->scale().isSet() )
+            Feature::eval( scaleEx, _features, &_cx, scales );
+
         // save the geode's drawables..
         osg::Geode::DrawableList old_drawables = geode.getDrawableList();
 
@@ -234,13 +311,14 @@ struct ClusterVisitor : public osg::NodeVisitor
                 continue;
 
             // go through the list of input features...
-            for( FeatureList::const_iterator j = _features.begin(); j != _features.end(); j++ )
+            unsigned n = 0;
+            for( FeatureList::const_iterator j = _features.begin(); j != _features.end(); j++, n++ )
             {
                 const Feature* feature = j->get();
 
-                if ( _symbol->scale().isSet() )
+                if ( !scales.empty() )
                 {
-                    double scale = feature->eval( scaleEx, &_cx );
+                    double scale = scales[n];
                     scaleMatrix.makeScale( scale, scale, scale );
                 }
 
@@ -335,15 +413,20 @@ SubstituteModelFilter::cluster(const FeatureList&           features,
 {    
     MarkerToFeatures markerToFeatures;
 
+    // resolve the marker URIs for all the features at once, so scripts run in a batch.
+    StringExpression uriEx( *symbol->url() );
+    std::vector<std::string> uris;
+    Feature::eval( uriEx, features, &context, uris );
+
     // first, sort the features into buckets, each bucket corresponding to a
     // unique marker.
-    for (FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+    unsigned n = 0;
+    for (FeatureList::const_iterator i = features.begin(); i != features.end(); ++i, ++n)
     {
         Feature* f = i->get();
 
         // resolve the URI for the marker:
-        StringExpression uriEx( *symbol->url() );
-        URI markerURI( f->eval( uriEx, &context ), uriEx.uriContext() );
+        URI markerURI( uris[n], uriEx.uriContext() );
 
         // find and load the corresponding marker model. We're using the session-level
         // object store to cache models. This is thread-safe sine we are always going
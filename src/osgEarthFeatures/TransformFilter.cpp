@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthFeatures/TransformFilter>
+#include <osgEarthFeatures/GeometryBatch>
 #include <osg/ClusterCullingCallback>
 
 #define LC "[TransformFilter] "
@@ -71,23 +72,6 @@ namespace
         return localToWorld;
     }
 #endif
-
-    void
-    localizeGeometry( Feature* input, const osg::Matrixd& refFrame )
-    {
-        if ( input && input->getGeometry() )
-        {
-            GeometryIterator iter( input->getGeometry() );
-            while( iter.hasMore() )
-            {
-                Geometry* geom = iter.next();
-                for( unsigned int i=0; i<geom->size(); i++ )
-                {
-                    (*geom)[i] = (*geom)[i] * refFrame;
-                }
-            }
-        }
-    }
 }
 
 //---------------------------------------------------------------------------
@@ -164,11 +148,11 @@ TransformFilter::push( FeatureList& input, FilterContext& incx )
 {
     _bbox = osg::BoundingBoxd();
 
-    // first transform all the points into the output SRS, collecting a bounding box as we go:
-    bool ok = true;
-    for( FeatureList::iterator i = input.begin(); i != input.end(); i++ )
-        if ( !push( i->get(), incx ) )
-            ok = false;
+    bool needsSRSXform =
+        _outputSRS.valid() &&
+        ( ! incx.profile()->getSRS()->isEquivalentTo( _outputSRS.get() ) );
+
+    bool needsMatrixXform = !_mat.isIdentity();
 
     FilterContext outcx( incx );
 
@@ -180,22 +164,40 @@ TransformFilter::push( FeatureList& input, FilterContext& incx )
             outcx.profile() = new FeatureProfile( incx.profile()->getExtent().transform( _outputSRS.get() ) );
     }
 
+    // optimize: do nothing if nothing needs doing
+    if ( !needsSRSXform && !_localize && !needsMatrixXform )
+        return outcx;
+
+    // gather all the points into one buffer so that the whole batch goes
+    // through the SRS transformation in a single call.
+    GeometryBatch batch( input );
+
+    // pre-transform the points before doing an SRS transformation.
+    if ( needsMatrixXform )
+        batch.transform( _mat );
+
+    if ( needsSRSXform )
+        batch.transform( incx.profile()->getSRS(), _outputSRS.get() );
+
     // set the reference frame to shift data to the centroid. This will
     // prevent floating point precision errors in the openGL pipeline for
     // properly gridded data.
-    if ( _bbox.valid() && _localize )
+    if ( _localize )
     {
-        // create a suitable reference frame:
-        osg::Matrixd localizer;
-        localizer = osg::Matrixd::translate( -_bbox.center() );
-
-        // localize the geometry relative to the reference frame.
-        for( FeatureList::iterator i = input.begin(); i != input.end(); i++ )
+        _bbox = batch.getBounds();
+        if ( _bbox.valid() )
         {
-            localizeGeometry( i->get(), localizer );
+            // create a suitable reference frame:
+            osg::Matrixd localizer;
+            localizer = osg::Matrixd::translate( -_bbox.center() );
+
+            // localize the geometry relative to the reference frame.
+            batch.transform( localizer );
+            outcx.setReferenceFrame( localizer );
         }
-        outcx.setReferenceFrame( localizer );
     }
 
+    batch.scatter( input );
+
     return outcx;
 }
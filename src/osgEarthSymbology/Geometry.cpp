@@ -261,6 +261,224 @@ Geometry::crop( const Polygon* cropPoly, osg::ref_ptr<Geometry>& output ) const
 #endif // OSGEARTH_HAVE_GEOS
 }
 
+namespace
+{
+    // Liang-Barsky: clips the segment p0-p1 to the box, returning the clipped
+    // endpoints as parameters along the segment. Returns false if it misses.
+    bool clipSegment( const Bounds& b, const osg::Vec3d& p0, const osg::Vec3d& p1, double& t0, double& t1 )
+    {
+        double dx = p1.x() - p0.x();
+        double dy = p1.y() - p0.y();
+        double p[4] = { -dx, dx, -dy, dy };
+        double q[4] = { p0.x() - b.xMin(), b.xMax() - p0.x(), p0.y() - b.yMin(), b.yMax() - p0.y() };
+
+        t0 = 0.0;
+        t1 = 1.0;
+        for( int i=0; i<4; ++i )
+        {
+            if ( p[i] == 0.0 )
+            {
+                // parallel to this edge; reject if outside it.
+                if ( q[i] < 0.0 )
+                    return false;
+            }
+            else
+            {
+                double r = q[i] / p[i];
+                if ( p[i] < 0.0 )
+                {
+                    if ( r > t1 ) return false;
+                    if ( r > t0 ) t0 = r;
+                }
+                else
+                {
+                    if ( r < t0 ) return false;
+                    if ( r < t1 ) t1 = r;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Clips a polyline to the box, appending each surviving run to "output".
+    void clipLine( const Geometry* line, bool closed, const Bounds& b, GeometryCollection& output )
+    {
+        unsigned numSegs = closed ? line->size() : line->size() - 1;
+        osg::ref_ptr<LineString> current;
+
+        for( unsigned i=0; i<numSegs; ++i )
+        {
+            const osg::Vec3d& p0 = (*line)[i];
+            const osg::Vec3d& p1 = (*line)[(i+1) % line->size()];
+
+            double t0, t1;
+            if ( !clipSegment(b, p0, p1, t0, t1) )
+            {
+                current = 0L;
+                continue;
+            }
+
+            // entering the box starts a new run.
+            if ( !current.valid() || t0 > 0.0 )
+            {
+                current = new LineString();
+                output.push_back( current.get() );
+                current->push_back( p0 + (p1-p0)*t0 );
+            }
+
+            current->push_back( t1 < 1.0 ? p0 + (p1-p0)*t1 : p1 );
+
+            // leaving the box ends the run.
+            if ( t1 < 1.0 )
+                current = 0L;
+        }
+    }
+
+    // Sutherland-Hodgman: clips a ring against one edge of the box.
+    // edge: 0=xmin, 1=xmax, 2=ymin, 3=ymax
+    void clipRingToEdge( const std::vector<osg::Vec3d>& input, int edge, double value, std::vector<osg::Vec3d>& output )
+    {
+        output.clear();
+        if ( input.empty() )
+            return;
+
+        int    axis = edge < 2 ? 0 : 1;
+        double sign = (edge % 2) == 0 ? 1.0 : -1.0;
+
+        const osg::Vec3d* prev = &input.back();
+        bool prevIn = sign*((*prev)[axis] - value) >= 0.0;
+
+        for( unsigned i=0; i<input.size(); ++i )
+        {
+            const osg::Vec3d* cur = &input[i];
+            bool curIn = sign*((*cur)[axis] - value) >= 0.0;
+
+            if ( curIn != prevIn )
+            {
+                double t = (value - (*prev)[axis]) / ((*cur)[axis] - (*prev)[axis]);
+                osg::Vec3d x = *prev + (*cur - *prev)*t;
+                x[axis] = value;
+                output.push_back( x );
+            }
+
+            if ( curIn )
+                output.push_back( *cur );
+
+            prev   = cur;
+            prevIn = curIn;
+        }
+    }
+
+    // Clips a ring to the box and stores the result in "output". Returns false
+    // if nothing with area remains.
+    bool clipRing( const Ring* ring, const Bounds& b, Ring* output )
+    {
+        std::vector<osg::Vec3d> a( ring->begin(), ring->end() ), c;
+
+        clipRingToEdge( a, 0, b.xMin(), c );
+        clipRingToEdge( c, 1, b.xMax(), a );
+        clipRingToEdge( a, 2, b.yMin(), c );
+        clipRingToEdge( c, 3, b.yMax(), a );
+
+        output->clear();
+        output->reserve( a.size() );
+        for( unsigned i=0; i<a.size(); ++i )
+        {
+            if ( output->empty() || output->back() != a[i] )
+                output->push_back( a[i] );
+        }
+        while( output->size() > 1 && output->front() == output->back() )
+            output->pop_back();
+
+        return output->size() >= 3;
+    }
+
+    bool boundsDisjoint( const Bounds& a, const Bounds& b )
+    {
+        return
+            a.xMax() < b.xMin() || a.xMin() > b.xMax() ||
+            a.yMax() < b.yMin() || a.yMin() > b.yMax();
+    }
+
+    // Crops a single (non-multi) geometry, appending the results to "output".
+    void cropPart( const Geometry* part, const Bounds& b, GeometryCollection& output )
+    {
+        const Bounds partBounds = part->getBounds();
+        if ( !partBounds.isValid() || boundsDisjoint(partBounds, b) )
+            return;
+
+        if ( b.contains(partBounds) )
+        {
+            output.push_back( part->clone() );
+            return;
+        }
+
+        switch( part->getType() )
+        {
+        case Geometry::TYPE_POINTSET:
+            {
+                osg::ref_ptr<PointSet> points = new PointSet();
+                for( Geometry::const_iterator i = part->begin(); i != part->end(); ++i )
+                {
+                    if ( b.contains(i->x(), i->y()) )
+                        points->push_back( *i );
+                }
+                if ( points->isValid() )
+                    output.push_back( points.get() );
+            }
+            break;
+
+        case Geometry::TYPE_LINESTRING:
+            clipLine( part, false, b, output );
+            break;
+
+        case Geometry::TYPE_RING:
+            // a standalone ring is a closed line; cropping it yields line strings.
+            clipLine( part, true, b, output );
+            break;
+
+        case Geometry::TYPE_POLYGON:
+            {
+                const Polygon* poly = static_cast<const Polygon*>( part );
+                osg::ref_ptr<Polygon> cropped = new Polygon();
+                if ( clipRing(poly, b, cropped.get()) )
+                {
+                    for( RingCollection::const_iterator h = poly->getHoles().begin(); h != poly->getHoles().end(); ++h )
+                    {
+                        osg::ref_ptr<Ring> hole = new Ring();
+                        if ( clipRing(h->get(), b, hole.get()) )
+                            cropped->getHoles().push_back( hole.get() );
+                    }
+                    output.push_back( cropped.get() );
+                }
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+bool
+Geometry::crop( const Bounds& bounds, osg::ref_ptr<Geometry>& output ) const
+{
+    GeometryCollection parts;
+
+    ConstGeometryIterator i( this, false );
+    while( i.hasMore() )
+        cropPart( i.next(), bounds, parts );
+
+    if ( parts.empty() )
+        output = 0L;
+    else if ( parts.size() == 1 )
+        output = parts.front().get();
+    else
+        output = new MultiGeometry( parts );
+
+    return output.valid();
+}
+
 bool
 Geometry::difference( const Polygon* diffPolygon, osg::ref_ptr<Geometry>& output ) const
 {
@@ -0,0 +1,719 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2008-2012 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarthSymbology/PolygonTriangulator>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace osgEarth::Symbology;
+
+#define LC "[PolygonTriangulator] "
+
+using namespace osgEarth;
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    // A vertex in a circular doubly-linked ring, in projected 2D coordinates.
+    struct Node
+    {
+        unsigned i;
+        double   x, y;
+        Node*    prev;
+        Node*    next;
+    };
+
+    // Twice the signed area of triangle pqr; negative means a left (CCW) turn.
+    inline double area( const Node* p, const Node* q, const Node* r )
+    {
+        return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+    }
+
+    inline bool equals( const Node* a, const Node* b )
+    {
+        return a->x == b->x && a->y == b->y;
+    }
+
+    inline bool pointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py)
+    {
+        return
+            (cx - px) * (ay - py) >= (ax - px) * (cy - py) &&
+            (ax - px) * (by - py) >= (bx - px) * (ay - py) &&
+            (bx - px) * (cy - py) >= (cx - px) * (by - py);
+    }
+
+    inline int sign( double v )
+    {
+        return v > 0.0 ? 1 : v < 0.0 ? -1 : 0;
+    }
+
+    // whether q lies within the bounding box of segment pr (assumes collinearity)
+    inline bool onSegment( const Node* p, const Node* q, const Node* r )
+    {
+        return
+            q->x <= std::max(p->x, r->x) && q->x >= std::min(p->x, r->x) &&
+            q->y <= std::max(p->y, r->y) && q->y >= std::min(p->y, r->y);
+    }
+
+    bool intersects( const Node* p1, const Node* q1, const Node* p2, const Node* q2 )
+    {
+        int o1 = sign( area(p1, q1, p2) );
+        int o2 = sign( area(p1, q1, q2) );
+        int o3 = sign( area(p2, q2, p1) );
+        int o4 = sign( area(p2, q2, q1) );
+
+        if ( o1 != o2 && o3 != o4 ) return true;
+        if ( o1 == 0 && onSegment(p1, p2, q1) ) return true;
+        if ( o2 == 0 && onSegment(p1, q2, q1) ) return true;
+        if ( o3 == 0 && onSegment(p2, p1, q2) ) return true;
+        if ( o4 == 0 && onSegment(p2, q1, q2) ) return true;
+        return false;
+    }
+
+    // whether the diagonal ab lies locally inside the polygon at a
+    bool locallyInside( const Node* a, const Node* b )
+    {
+        return area(a->prev, a, a->next) < 0.0 ?
+            area(a, b, a->next) >= 0.0 && area(a, a->prev, b) >= 0.0 :
+            area(a, b, a->prev) < 0.0 || area(a, a->next, b) < 0.0;
+    }
+
+    // whether the sector at m contains the sector at p (both sharing a vertex)
+    bool sectorContainsSector( const Node* m, const Node* p )
+    {
+        return area(m->prev, m, p->prev) < 0.0 && area(p->next, m, m->next) < 0.0;
+    }
+
+    /**
+     * Ear-clipping triangulator working on a pool of linked ring nodes.
+     * Holes are merged into the outer ring by "bridge" edges before clipping.
+     */
+    class EarClipper
+    {
+    public:
+        EarClipper( unsigned capacity, std::vector<unsigned>& output )
+            : _output( output )
+        {
+            // reserve up front so node pointers remain stable.
+            _pool.reserve( capacity );
+        }
+
+        // Builds a ring from projected points; returns a node on the ring or NULL.
+        Node* makeRing( const std::vector<unsigned>& ids, const std::vector<osg::Vec2d>& pts, unsigned first, unsigned count, bool reverse )
+        {
+            Node* last = 0L;
+            for( unsigned k=0; k<count; ++k )
+            {
+                unsigned j = reverse ? first + count - 1 - k : first + k;
+                last = insert( ids[j], pts[j].x(), pts[j].y(), last );
+            }
+
+            if ( last && equals(last, last->next) )
+            {
+                Node* next = last->next;
+                remove( last );
+                last = next;
+            }
+            return last;
+        }
+
+        // Merges the holes into the outer ring. Returns NULL if a hole cannot be bridged.
+        Node* eliminateHoles( Node* outer, std::vector<Node*>& holes )
+        {
+            std::vector<Node*> queue;
+            for( unsigned h=0; h<holes.size(); ++h )
+            {
+                if ( holes[h] && holes[h] != holes[h]->next )
+                    queue.push_back( getLeftmost(holes[h]) );
+            }
+
+            std::sort( queue.begin(), queue.end(), sortByX );
+
+            for( unsigned h=0; h<queue.size(); ++h )
+            {
+                Node* bridge = findHoleBridge( queue[h], outer );
+                if ( !bridge )
+                    return 0L;
+
+                Node* bridgeReverse = split( bridge, queue[h] );
+                filterPoints( bridgeReverse, bridgeReverse->next );
+                outer = filterPoints( bridge, bridge->next );
+            }
+
+            return outer;
+        }
+
+        // Clips ears until the ring is exhausted. Returns false if it gets stuck.
+        bool clip( Node* ear )
+        {
+            int   pass = 0;
+            Node* stop = ear;
+
+            while( ear->prev != ear->next )
+            {
+                Node* prev = ear->prev;
+                Node* next = ear->next;
+
+                if ( isEar(ear) )
+                {
+                    emit( prev, ear, next );
+                    remove( ear );
+
+                    // skipping the next vertex leads to fewer sliver triangles
+                    ear  = next->next;
+                    stop = next->next;
+                    continue;
+                }
+
+                ear = next;
+
+                // went all the way around without finding an ear:
+                if ( ear == stop )
+                {
+                    if ( pass == 0 )
+                    {
+                        // remove collinear and duplicate points and try again.
+                        ear = filterPoints( ear, 0L );
+                    }
+                    else if ( pass == 1 )
+                    {
+                        // clip away small local self-intersections and try again.
+                        ear = cureLocalIntersections( filterPoints(ear, 0L) );
+                    }
+                    else
+                    {
+                        // give up; the caller will fall back on a more robust method.
+                        return false;
+                    }
+                    stop = ear;
+                    ++pass;
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        std::vector<Node>      _pool;
+        std::vector<unsigned>& _output;
+
+        static bool sortByX( const Node* a, const Node* b )
+        {
+            return a->x < b->x;
+        }
+
+        Node* insert( unsigned i, double x, double y, Node* last )
+        {
+            _pool.push_back( Node() );
+            Node* p = &_pool.back();
+            p->i = i;
+            p->x = x;
+            p->y = y;
+
+            if ( !last )
+            {
+                p->prev = p;
+                p->next = p;
+            }
+            else
+            {
+                p->next = last->next;
+                p->prev = last;
+                last->next->prev = p;
+                last->next = p;
+            }
+            return p;
+        }
+
+        void remove( Node* p )
+        {
+            p->next->prev = p->prev;
+            p->prev->next = p->next;
+        }
+
+        void emit( const Node* a, const Node* b, const Node* c )
+        {
+            _output.push_back( a->i );
+            _output.push_back( b->i );
+            _output.push_back( c->i );
+        }
+
+        bool isEar( const Node* ear ) const
+        {
+            const Node* a = ear->prev;
+            const Node* b = ear;
+            const Node* c = ear->next;
+
+            // reflex; can't be an ear
+            if ( area(a, b, c) >= 0.0 )
+                return false;
+
+            // make sure no other reflex point lies within the potential ear.
+            for( const Node* p = c->next; p != a; p = p->next )
+            {
+                if ( !(p->x == a->x && p->y == a->y) &&
+                     pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+                     area(p->prev, p, p->next) >= 0.0 )
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // removes duplicate and collinear points between start and end.
+        Node* filterPoints( Node* start, Node* end )
+        {
+            if ( !end ) end = start;
+
+            Node* p = start;
+            bool again;
+            do
+            {
+                again = false;
+                if ( equals(p, p->next) || area(p->prev, p, p->next) == 0.0 )
+                {
+                    remove( p );
+                    p = end = p->prev;
+                    if ( p == p->next )
+                        break;
+                    again = true;
+                }
+                else
+                {
+                    p = p->next;
+                }
+            }
+            while( again || p != end );
+
+            return end;
+        }
+
+        Node* cureLocalIntersections( Node* start )
+        {
+            Node* p = start;
+            do
+            {
+                Node* a = p->prev;
+                Node* b = p->next->next;
+
+                if ( !equals(a, b) && intersects(a, p, p->next, b) && locallyInside(a, b) && locallyInside(b, a) )
+                {
+                    emit( a, p, b );
+                    remove( p );
+                    remove( p->next );
+                    p = start = b;
+                }
+                p = p->next;
+            }
+            while( p != start );
+
+            return filterPoints( p, 0L );
+        }
+
+        Node* getLeftmost( Node* start ) const
+        {
+            Node* p = start;
+            Node* leftmost = start;
+            do
+            {
+                if ( p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y) )
+                    leftmost = p;
+                p = p->next;
+            }
+            while( p != start );
+            return leftmost;
+        }
+
+        // finds a vertex on the outer ring that is visible from the hole's leftmost vertex.
+        Node* findHoleBridge( Node* hole, Node* outer ) const
+        {
+            Node*  p  = outer;
+            double hx = hole->x;
+            double hy = hole->y;
+            double qx = -DBL_MAX;
+            Node*  m  = 0L;
+
+            if ( equals(hole, p) )
+                return p;
+
+            // cast a ray left from the hole point; find the nearest outer segment it hits.
+            do
+            {
+                if ( equals(hole, p->next) )
+                {
+                    return p->next;
+                }
+                else if ( hy <= p->y && hy >= p->next->y && p->next->y != p->y )
+                {
+                    double x = p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
+                    if ( x <= hx && x > qx )
+                    {
+                        qx = x;
+                        m = p->x < p->next->x ? p : p->next;
+                        if ( x == hx )
+                            return m;
+                    }
+                }
+                p = p->next;
+            }
+            while( p != outer );
+
+            if ( !m )
+                return 0L;
+
+            // if any points lie within the triangle (hole point, ray hit, segment endpoint),
+            // connect to the one with the smallest angle to the ray instead.
+            Node*  stop   = m;
+            double mx     = m->x;
+            double my     = m->y;
+            double tanMin = DBL_MAX;
+
+            p = m;
+            do
+            {
+                if ( hx >= p->x && p->x >= mx && hx != p->x &&
+                     pointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, p->x, p->y) )
+                {
+                    double t = fabs(hy - p->y) / (hx - p->x);
+                    if ( locallyInside(p, hole) &&
+                         (t < tanMin || (t == tanMin && (p->x > m->x || (p->x == m->x && sectorContainsSector(m, p))))) )
+                    {
+                        m = p;
+                        tanMin = t;
+                    }
+                }
+                p = p->next;
+            }
+            while( p != stop );
+
+            return m;
+        }
+
+        // links a and b with a bridge, splitting the ring in two (or merging two rings
+        // into one). Returns the new copy of b.
+        Node* split( Node* a, Node* b )
+        {
+            Node* a2 = insert( a->i, a->x, a->y, 0L );
+            Node* b2 = insert( b->i, b->x, b->y, 0L );
+            Node* an = a->next;
+            Node* bp = b->prev;
+
+            a->next = b;
+            b->prev = a;
+
+            a2->next = an;
+            an->prev = a2;
+
+            b2->next = a2;
+            a2->prev = b2;
+
+            bp->next = b2;
+            b2->prev = bp;
+
+            return b2;
+        }
+    };
+
+    // Newell's method; the result points along the right-hand normal of the ring.
+    osg::Vec3d newellNormal( const osg::Vec3Array& verts, unsigned first, unsigned count )
+    {
+        osg::Vec3d n;
+        for( unsigned k=0; k<count; ++k )
+        {
+            osg::Vec3d c = verts[first + k];
+            osg::Vec3d d = verts[first + (k+1)%count];
+            n.x() += (c.y() - d.y()) * (c.z() + d.z());
+            n.y() += (c.z() - d.z()) * (c.x() + d.x());
+            n.z() += (c.x() - d.x()) * (c.y() + d.y());
+        }
+        return n;
+    }
+
+    // A ring edge in projected coordinates, for the self-intersection test.
+    struct Edge
+    {
+        osg::Vec2d a, b;
+        double     xmin, xmax;
+        bool operator < ( const Edge& rhs ) const { return xmin < rhs.xmin; }
+    };
+
+    inline double orient( const osg::Vec2d& p, const osg::Vec2d& q, const osg::Vec2d& r )
+    {
+        return (q.x() - p.x()) * (r.y() - p.y()) - (q.y() - p.y()) * (r.x() - p.x());
+    }
+
+    // Whether two edges cross at a point interior to both, or overlap along a
+    // collinear stretch of non-zero length. Edges that merely touch (at a shared
+    // vertex, or a vertex on the other edge) are fine for ear clipping.
+    bool crosses( const Edge& e1, const Edge& e2 )
+    {
+        double o1 = orient( e1.a, e1.b, e2.a );
+        double o2 = orient( e1.a, e1.b, e2.b );
+        double o3 = orient( e2.a, e2.b, e1.a );
+        double o4 = orient( e2.a, e2.b, e1.b );
+
+        if ( ((o1 > 0.0 && o2 < 0.0) || (o1 < 0.0 && o2 > 0.0)) &&
+             ((o3 > 0.0 && o4 < 0.0) || (o3 < 0.0 && o4 > 0.0)) )
+            return true;
+
+        if ( o1 == 0.0 && o2 == 0.0 )
+        {
+            // collinear: compare the projections onto e1.
+            osg::Vec2d d = e1.b - e1.a;
+            double t0 = (e2.a - e1.a) * d, t1 = (e2.b - e1.a) * d;
+            double lo = std::max( std::min(t0, t1), 0.0 );
+            double hi = std::min( std::max(t0, t1), d * d );
+            return hi > lo;
+        }
+
+        return false;
+    }
+
+    // Whether any two edges of a set of rings cross. Edges are swept in order
+    // of their minimum x, so only edges with overlapping x ranges are compared.
+    bool hasCrossings( const std::vector<osg::Vec2d>& pts, const std::vector< std::pair<unsigned,unsigned> >& rings )
+    {
+        std::vector<Edge> edges;
+        for( unsigned r=0; r<rings.size(); ++r )
+        {
+            for( unsigned k=0; k<rings[r].second; ++k )
+            {
+                Edge e;
+                e.a = pts[rings[r].first + k];
+                e.b = pts[rings[r].first + (k+1)%rings[r].second];
+                if ( e.a == e.b )
+                    continue;
+                e.xmin = std::min( e.a.x(), e.b.x() );
+                e.xmax = std::max( e.a.x(), e.b.x() );
+                edges.push_back( e );
+            }
+        }
+
+        std::sort( edges.begin(), edges.end() );
+
+        for( unsigned i=0; i<edges.size(); ++i )
+        {
+            const Edge& e1 = edges[i];
+            double ymin = std::min( e1.a.y(), e1.b.y() );
+            double ymax = std::max( e1.a.y(), e1.b.y() );
+
+            for( unsigned j=i+1; j<edges.size() && edges[j].xmin <= e1.xmax; ++j )
+            {
+                const Edge& e2 = edges[j];
+                if ( std::max(e2.a.y(), e2.b.y()) < ymin || std::min(e2.a.y(), e2.b.y()) > ymax )
+                    continue;
+                if ( crosses(e1, e2) )
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // Twice the signed area of a projected ring; positive means CCW.
+    double signedArea( const std::vector<osg::Vec2d>& pts, unsigned first, unsigned count )
+    {
+        double sum = 0.0;
+        for( unsigned k=0; k<count; ++k )
+        {
+            const osg::Vec2d& c = pts[first + k];
+            const osg::Vec2d& d = pts[first + (k+1)%count];
+            sum += c.x()*d.y() - d.x()*c.y();
+        }
+        return sum;
+    }
+}
+
+//------------------------------------------------------------------------
+
+bool
+PolygonTriangulator::triangulate(const osg::Vec3Array&    verts,
+                                 const std::vector<Ring>& rings,
+                                 std::vector<unsigned>&   out_indices,
+                                 osg::Vec3d*              out_normal )
+{
+    if ( rings.empty() )
+        return false;
+
+    unsigned totalVerts = 0;
+    for( unsigned r=0; r<rings.size(); ++r )
+    {
+        if ( rings[r].first + rings[r].second > verts.size() )
+            return false;
+        totalVerts += rings[r].second;
+    }
+
+    const Ring& outer = rings[0];
+    if ( outer.second < 3 )
+        return false;
+
+    // establish the plane of the outer ring. The normal's direction follows the
+    // ring's winding, so the outer ring is always CCW in the projected frame.
+    osg::Vec3d normal = newellNormal( verts, outer.first, outer.second );
+    double len = normal.normalize();
+    if ( !(len > 0.0) )
+        return false;
+
+    osg::Vec3d ref = fabs(normal.z()) < 0.9 ? osg::Vec3d(0,0,1) : osg::Vec3d(1,0,0);
+    osg::Vec3d u = ref ^ normal;
+    u.normalize();
+    osg::Vec3d v = normal ^ u;
+
+    // project all ring points into the plane, relative to the first point
+    // to preserve precision.
+    osg::Vec3d origin = verts[outer.first];
+    std::vector<osg::Vec2d> pts;
+    std::vector<unsigned>   ids;
+    std::vector<unsigned>   offsets;
+    pts.reserve( totalVerts );
+    ids.reserve( totalVerts );
+
+    for( unsigned r=0; r<rings.size(); ++r )
+    {
+        offsets.push_back( pts.size() );
+        for( unsigned k=0; k<rings[r].second; ++k )
+        {
+            unsigned i = rings[r].first + k;
+            osg::Vec3d p = osg::Vec3d(verts[i]) - origin;
+            pts.push_back( osg::Vec2d(p*u, p*v) );
+            ids.push_back( i );
+        }
+    }
+
+    if ( !(signedArea(pts, offsets[0], outer.second) > 0.0) )
+        return false;
+
+    std::vector<unsigned> indices;
+    indices.reserve( 3*totalVerts );
+
+    // the rings to triangulate, in projected point ranges. Skip empty and zero-area holes.
+    std::vector< std::pair<unsigned,unsigned> > used;
+    std::vector<double> areas;
+    used.push_back( std::make_pair(offsets[0], outer.second) );
+    for( unsigned r=1; r<rings.size(); ++r )
+    {
+        if ( rings[r].second < 3 )
+            continue;
+
+        double a = signedArea( pts, offsets[r], rings[r].second );
+        if ( a == 0.0 )
+            continue;
+
+        used.push_back( std::make_pair(offsets[r], rings[r].second) );
+        areas.push_back( a );
+    }
+
+    // ear clipping does not detect crossing edges (it would emit overlapping
+    // triangles), so reject them here and let the caller fall back.
+    if ( hasCrossings(pts, used) )
+        return false;
+
+    EarClipper clipper( totalVerts + 2*rings.size(), indices );
+
+    Node* outerNode = clipper.makeRing( ids, pts, offsets[0], outer.second, false );
+    if ( !outerNode || outerNode == outerNode->next || outerNode->prev == outerNode->next )
+        return false;
+
+    if ( used.size() > 1 )
+    {
+        // holes must run CW; reverse any that don't.
+        std::vector<Node*> holes;
+        for( unsigned h=1; h<used.size(); ++h )
+        {
+            holes.push_back( clipper.makeRing(ids, pts, used[h].first, used[h].second, areas[h-1] > 0.0) );
+        }
+
+        outerNode = clipper.eliminateHoles( outerNode, holes );
+        if ( !outerNode )
+            return false;
+    }
+
+    if ( !clipper.clip(outerNode) )
+        return false;
+
+    out_indices.insert( out_indices.end(), indices.begin(), indices.end() );
+
+    if ( out_normal )
+        *out_normal = normal;
+
+    return true;
+}
+
+
+bool
+PolygonTriangulator::run( osg::Geometry& geom, bool generateNormals )
+{
+    osg::Vec3Array* verts = dynamic_cast<osg::Vec3Array*>( geom.getVertexArray() );
+    if ( !verts || geom.getNumPrimitiveSets() == 0 )
+        return false;
+
+    std::vector<Ring> rings;
+    rings.reserve( geom.getNumPrimitiveSets() );
+
+    for( unsigned p=0; p<geom.getNumPrimitiveSets(); ++p )
+    {
+        const osg::DrawArrays* da = dynamic_cast<const osg::DrawArrays*>( geom.getPrimitiveSet(p) );
+        if ( !da )
+            return false;
+
+        GLenum mode = da->getMode();
+        if ( mode != GL_LINE_LOOP && mode != GL_POLYGON )
+            return false;
+
+        rings.push_back( Ring(da->getFirst(), da->getCount()) );
+    }
+
+    std::vector<unsigned> indices;
+    osg::Vec3d normal;
+    if ( !triangulate(*verts, rings, indices, &normal) || indices.empty() )
+        return false;
+
+    geom.removePrimitiveSet( 0, geom.getNumPrimitiveSets() );
+    geom.addPrimitiveSet( new osg::DrawElementsUInt(GL_TRIANGLES, indices.size(), &indices.front()) );
+
+    if ( generateNormals )
+    {
+        // area-weighted average of the face normals at each vertex. Vertices not
+        // referenced by any triangle get the polygon normal.
+        osg::Vec3Array* normals = new osg::Vec3Array( verts->size() );
+        for( unsigned t=0; t+2<indices.size(); t+=3 )
+        {
+            const osg::Vec3& a = (*verts)[indices[t]];
+            const osg::Vec3& b = (*verts)[indices[t+1]];
+            const osg::Vec3& c = (*verts)[indices[t+2]];
+            osg::Vec3 fn = (b-a) ^ (c-a);
+            (*normals)[indices[t]]   += fn;
+            (*normals)[indices[t+1]] += fn;
+            (*normals)[indices[t+2]] += fn;
+        }
+
+        for( osg::Vec3Array::iterator n = normals->begin(); n != normals->end(); ++n )
+        {
+            if ( n->normalize() <= 0.0f )
+                *n = osg::Vec3(normal);
+        }
+
+        geom.setNormalArray( normals );
+        geom.setNormalBinding( osg::Geometry::BIND_PER_VERTEX );
+    }
+
+    return true;
+}
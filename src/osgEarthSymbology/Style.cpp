@@ -33,7 +33,7 @@ using namespace osgEarth::Symbology;
 Style::Style( const std::string& name ) :
 _name( name )
 {
-    //NOP
+    clearSlots();
 }
 
 Style::Style(const Style& rhs, const osg::CopyOp& op) :
@@ -46,10 +46,12 @@ _uri     ( rhs._uri )
     if ( op.getCopyFlags() == osg::CopyOp::SHALLOW_COPY )
     {
         _symbols = rhs._symbols;
+        std::copy( rhs._slots, rhs._slots + NUM_SYMBOL_SLOTS, _slots );
     }
     else
     {
         _symbols.clear();
+        clearSlots();
         mergeConfig( rhs.getConfig(false) );
     }
 }
@@ -62,6 +64,7 @@ Style::operator = ( const Style& rhs )
     _origData.clear();
     _uri.unset();
     _symbols.clear();
+    clearSlots();
     mergeConfig( rhs.getConfig(false) );
     return *this;
 }
@@ -69,7 +72,10 @@ Style::operator = ( const Style& rhs )
 void Style::addSymbol(Symbol* symbol)
 {
     if ( symbol )
+    {
         _symbols.push_back(symbol);
+        addToSlots(symbol);
+    }
 }
 
 bool Style::removeSymbol(Symbol* symbol)
@@ -79,15 +85,58 @@ bool Style::removeSymbol(Symbol* symbol)
 		return false;
 		
 	_symbols.erase(it);
+	rebuildSlots();
 	
 	return true;
 }
 
 Style::Style( const Config& conf )
 {
+    clearSlots();
     mergeConfig( conf );
 }
 
+void
+Style::clearSlots()
+{
+    for( unsigned i=0; i<NUM_SYMBOL_SLOTS; ++i )
+        _slots[i] = 0L;
+}
+
+namespace
+{
+    template<typename T>
+    void fillSlot( Symbol* symbol, Symbol** slots )
+    {
+        Symbol*& slot = slots[SymbolSlot<T>::index];
+        if ( !slot && dynamic_cast<T*>(symbol) )
+            slot = symbol;
+    }
+}
+
+void
+Style::addToSlots( Symbol* symbol )
+{
+    // a symbol may fill more than one slot if it derives from more than one
+    // symbol type; the first symbol of each type wins, like the list scan.
+    fillSlot<AltitudeSymbol> ( symbol, _slots );
+    fillSlot<ExtrusionSymbol>( symbol, _slots );
+    fillSlot<LineSymbol>     ( symbol, _slots );
+    fillSlot<MarkerSymbol>   ( symbol, _slots );
+    fillSlot<PointSymbol>    ( symbol, _slots );
+    fillSlot<PolygonSymbol>  ( symbol, _slots );
+    fillSlot<SkinSymbol>     ( symbol, _slots );
+    fillSlot<TextSymbol>     ( symbol, _slots );
+}
+
+void
+Style::rebuildSlots()
+{
+    clearSlots();
+    for( SymbolList::const_iterator i = _symbols.begin(); i != _symbols.end(); ++i )
+        addToSlots( i->get() );
+}
+
 Style
 Style::combineWith( const Style& rhs ) const
 {
@@ -255,12 +304,14 @@ void
 StyleSheet::addStyle( const Style& style )
 {
     _styles[ style.getName() ] = style;
+    dirtyCombinedStyles();
 }
 
 void
 StyleSheet::removeStyle( const std::string& name )
 {
     _styles.erase( name );
+    dirtyCombinedStyles();
 }
 
 Style*
@@ -337,6 +388,41 @@ StyleSheet::getDefaultStyle() const
     }
 }
 
+Style
+StyleSheet::getCombinedStyle( const std::string& baseName, const std::string& selectedName ) const
+{
+    // upper limit on the number of cached combinations.
+    static const unsigned MAX_COMBINED_STYLES = 256;
+
+    CombinedStyles::key_type key( baseName, selectedName );
+
+    {
+        Threading::ScopedReadLock shared( _combinedStylesMutex );
+        CombinedStyles::const_iterator i = _combinedStyles.find( key );
+        if ( i != _combinedStyles.end() )
+            return i->second;
+    }
+
+    const Style* base     = getStyle( baseName );
+    const Style* selected = getStyle( selectedName );
+    Style combined = base->combineWith( *selected );
+
+    Threading::ScopedWriteLock exclusive( _combinedStylesMutex );
+
+    if ( _combinedStyles.size() >= MAX_COMBINED_STYLES )
+        _combinedStyles.clear();
+
+    // another thread may have beaten us to it; insert() keeps the existing one.
+    return _combinedStyles.insert( std::make_pair(key, combined) ).first->second;
+}
+
+void
+StyleSheet::dirtyCombinedStyles()
+{
+    Threading::ScopedWriteLock exclusive( _combinedStylesMutex );
+    _combinedStyles.clear();
+}
+
 void
 StyleSheet::addResourceLibrary( ResourceLibrary* lib )
 {
@@ -404,6 +490,8 @@ StyleSheet::mergeConfig( const Config& conf )
 {
     _uriContext = URIContext( conf.referrer() );
 
+    dirtyCombinedStyles();
+
     // read in any resource library references
     ConfigSet libraries = conf.children( "library" );
     for( ConfigSet::iterator i = libraries.begin(); i != libraries.end(); ++i )
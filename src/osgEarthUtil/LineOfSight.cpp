@@ -21,6 +21,7 @@
 #include <osgSim/LineOfSight>
 #include <osgUtil/IntersectionVisitor>
 #include <osgUtil/LineSegmentIntersector>
+#include <osgEarth/DPLineSegmentIntersector>
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
@@ -42,6 +43,32 @@ private:
     LineOfSightNode* _los;
 }; 
 
+// Map extent under a line-of-sight segment, padded a little to account for the
+// difference between the straight world-space line and its map projection.
+static GeoExtent getSegmentExtent( MapNode* mapNode, const osg::Vec3d& start, const osg::Vec3d& end )
+{
+    double xmin = std::min(start.x(), end.x()), xmax = std::max(start.x(), end.x());
+    double ymin = std::min(start.y(), end.y()), ymax = std::max(start.y(), end.y());
+    double pad  = 0.1 * std::max(xmax-xmin, ymax-ymin);
+    return GeoExtent( mapNode->getMapSRS(), xmin-pad, ymin-pad, xmax+pad, ymax+pad );
+}
+
+// Map extent of a circle of the given radius (in meters) around a map point.
+static GeoExtent getRadialExtent( MapNode* mapNode, const osg::Vec3d& center, double radius )
+{
+    const SpatialReference* srs = mapNode->getMapSRS();
+    double dx = radius, dy = radius;
+    if ( srs->isGeographic() )
+    {
+        double r = srs->getEllipsoid()->getRadiusEquator();
+        dy = osg::RadiansToDegrees( radius / r );
+        dx = dy / osg::clampAbove( cos(osg::DegreesToRadians(center.y())), 0.01 );
+    }
+    dx *= 1.1;
+    dy *= 1.1;
+    return GeoExtent( srs, center.x()-dx, center.y()-dy, center.x()+dx, center.y()+dy );
+}
+
 static bool getRelativeWorld(double x, double y, double relativeHeight, MapNode* mapNode, osg::Vec3d& world )
 {
     GeoPoint mapPoint(mapNode->getMapSRS(), x, y);
@@ -61,7 +88,8 @@ static bool getRelativeWorld(double x, double y, double relativeHeight, MapNode*
     osg::Vec3d start = pos + (up * segOffset);
     osg::Vec3d end = pos - (up * segOffset);
     
-    osgUtil::LineSegmentIntersector* i = new osgUtil::LineSegmentIntersector( start, end );
+    DPLineSegmentIntersector* i = new DPLineSegmentIntersector( start, end );
+    i->setIntersectionLimit( osgUtil::Intersector::LIMIT_NEAREST );
     
     osgUtil::IntersectionVisitor iv;    
     iv.setIntersector( i );
@@ -123,7 +151,8 @@ void
 LineOfSightNode::subscribeToTerrain()
 {
     _terrainChangedCallback = new LineOfSightNodeTerrainChangedCallback( this );
-    _mapNode->getTerrain()->addTerrainCallback( _terrainChangedCallback.get() );        
+    _mapNode->getTerrain()->addTerrainCallback(
+        _terrainChangedCallback.get(), 0L, getSegmentExtent(_mapNode.get(), _start, _end) );
 }
 
 LineOfSightNode::~LineOfSightNode()
@@ -158,6 +187,8 @@ LineOfSightNode::setStart(const osg::Vec3d& start)
     {
         _start = start;
         compute(getNode());
+        _mapNode->getTerrain()->setTerrainCallbackExtent(
+            _terrainChangedCallback.get(), getSegmentExtent(_mapNode.get(), _start, _end) );
     }
 }
 
@@ -174,6 +205,8 @@ LineOfSightNode::setEnd(const osg::Vec3d& end)
     {
         _end = end;
         compute(getNode());
+        _mapNode->getTerrain()->setTerrainCallbackExtent(
+            _terrainChangedCallback.get(), getSegmentExtent(_mapNode.get(), _start, _end) );
     }
 }
 
@@ -600,7 +633,8 @@ _terrainOnly( false )
 {
     compute(getNode());
     _terrainChangedCallback = new RadialLineOfSightNodeTerrainChangedCallback( this );
-    _mapNode->getTerrain()->addTerrainCallback( _terrainChangedCallback.get() );        
+    _mapNode->getTerrain()->addTerrainCallback(
+        _terrainChangedCallback.get(), 0L, getRadialExtent(_mapNode.get(), _center, _radius) );
     setNumChildrenRequiringUpdateTraversal( 1 );
 }
 
@@ -638,6 +672,8 @@ RadialLineOfSightNode::setRadius(double radius)
     {
         _radius = osg::clampAbove(radius, 1.0);
         compute(getNode());
+        _mapNode->getTerrain()->setTerrainCallbackExtent(
+            _terrainChangedCallback.get(), getRadialExtent(_mapNode.get(), _center, _radius) );
     }
 }
 
@@ -677,6 +713,8 @@ RadialLineOfSightNode::setCenter(const osg::Vec3d& center)
     {
         _center = center;
         compute(getNode());
+        _mapNode->getTerrain()->setTerrainCallbackExtent(
+            _terrainChangedCallback.get(), getRadialExtent(_mapNode.get(), _center, _radius) );
     }
 }
 
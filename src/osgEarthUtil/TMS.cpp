@@ -403,11 +403,13 @@ TileMap* TileMap::create(const TileSource* tileSource, const Profile* profile)
 
 
 TileMap* 
-TileMapReaderWriter::read( const std::string& location, const osgDB::ReaderWriter::Options* options )
+TileMapReaderWriter::read(const std::string&                  location,
+                          const osgDB::ReaderWriter::Options* options,
+                          const CachePolicy&                  cachePolicy )
 {
     TileMap* tileMap = NULL;
 
-    ReadResult r = URI(location).readString();
+    ReadResult r = URI(location).readString( options, cachePolicy );
     if ( r.failed() )
     {
         OE_WARN << LC << "Failed to read TMS tile map file from " << location << std::endl;
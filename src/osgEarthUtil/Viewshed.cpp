@@ -0,0 +1,425 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2012 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthUtil/Viewshed>
+#include <osgEarth/ElevationQuery>
+#include <osgEarth/TaskService>
+#include <OpenThreads/Thread>
+#include <osg/Timer>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#define LC "[Viewshed] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    // Number of angular sectors in the sweep. This is fixed (rather than tied to the
+    // thread count) so that the result does not depend on the number of threads.
+    const unsigned NUM_SECTORS = 64u;
+
+    const double TWO_PI = 2.0*osg::PI;
+
+    // Converts an east/north offset in meters from the center to map coordinates.
+    osg::Vec3d localToMap( const GeoPoint& center, double east, double north )
+    {
+        const SpatialReference* srs = center.getSRS();
+        if ( srs->isGeographic() )
+        {
+            double r   = srs->getEllipsoid()->getRadiusEquator();
+            double lat = center.y() + osg::RadiansToDegrees( north / r );
+            double lon = center.x() + osg::RadiansToDegrees( east / (r * osg::clampAbove(cos(osg::DegreesToRadians(center.y())), 1e-6)) );
+            return osg::Vec3d( lon, lat, 0.0 );
+        }
+        else
+        {
+            return osg::Vec3d( center.x() + east, center.y() + north, 0.0 );
+        }
+    }
+
+    // State shared by all the sector tasks. Inputs are read-only; each output cell
+    // is written only by the sector that owns it.
+    struct SweepData
+    {
+        unsigned              size;
+        int                   c;             // index of the center row/column
+        double                cellSize;
+        double                maxDist2;      // squared radius, in cells
+        double                targetHeight;
+        std::vector<double>   adj;           // terrain height relative to the observer, curvature applied
+        std::vector<unsigned> perimeter;     // cells on the grid border
+        std::vector<double>   perimeterAngle;
+        std::vector< std::vector<unsigned> > owned;   // cells owned by each sector
+        std::vector<unsigned char> owner;
+        std::vector<unsigned char> touched;
+        std::vector<unsigned char>* visibility;
+        ProgressCallback*     progress;
+
+        bool isCanceled() const { return progress && progress->isCanceled(); }
+
+        double adjAt( int col, int row ) const { return adj[row*size + col]; }
+    };
+
+    // Sweeps all the rays in one angular sector.
+    struct SweepSector
+    {
+        void init( SweepData* data, unsigned sector )
+        {
+            _data   = data;
+            _sector = sector;
+        }
+
+        void execute()
+        {
+            const SweepData& d = *_data;
+            double width  = TWO_PI / (double)NUM_SECTORS;
+            double mid    = width * ((double)_sector + 0.5);
+            double margin = 2.0 / (double)osg::maximum(d.c, 1);
+
+            for( unsigned p = 0; p < d.perimeter.size(); ++p )
+            {
+                // poll for cancelation every so often.
+                if ( (p & 0xFF) == 0 && d.isCanceled() )
+                    return;
+
+                double diff = d.perimeterAngle[p] - mid;
+                while( diff < -osg::PI ) diff += TWO_PI;
+                while( diff >= osg::PI ) diff -= TWO_PI;
+
+                if ( fabs(diff) <= 0.5*width + margin )
+                {
+                    unsigned cell = d.perimeter[p];
+                    trace( (int)(cell % d.size), (int)(cell / d.size), true );
+                }
+            }
+
+            // exact test for any owned cell that no ray happened to cross.
+            const std::vector<unsigned>& cells = d.owned[_sector];
+            for( unsigned i = 0; i < cells.size(); ++i )
+            {
+                if ( (i & 0xFF) == 0 && d.isCanceled() )
+                    return;
+
+                if ( !d.touched[cells[i]] )
+                {
+                    trace( (int)(cells[i] % d.size), (int)(cells[i] / d.size), false );
+                }
+            }
+        }
+
+        // Walks from the center toward (tx,ty). In sweep mode, every owned cell along
+        // the way is classified; otherwise only the end cell is.
+        void trace( int tx, int ty, bool sweep )
+        {
+            SweepData& d = *_data;
+            std::vector<unsigned char>& vis = *d.visibility;
+
+            int dx = tx - d.c;
+            int dy = ty - d.c;
+            int steps = osg::maximum( abs(dx), abs(dy) );
+            if ( steps == 0 )
+                return;
+
+            bool   xMajor   = abs(dx) >= abs(dy);
+            double maxSlope = -DBL_MAX;
+
+            for( int i = 1; i <= steps; ++i )
+            {
+                double fx = (double)d.c + (double)(dx*i)/(double)steps;
+                double fy = (double)d.c + (double)(dy*i)/(double)steps;
+                double gx = fx - (double)d.c, gy = fy - (double)d.c;
+                double dist2 = gx*gx + gy*gy;
+                if ( dist2 > d.maxDist2 )
+                    break;
+
+                int col = (int)floor(fx + 0.5);
+                int row = (int)floor(fy + 0.5);
+
+                bool last = (i == steps);
+                if ( sweep || last )
+                {
+                    unsigned idx = row*d.size + col;
+                    if ( d.owner[idx] == _sector && vis[idx] != ViewshedGrid::OUT_OF_RANGE )
+                    {
+                        double cx = col - d.c, cy = row - d.c;
+                        double cellDist = sqrt(cx*cx + cy*cy) * d.cellSize;
+                        double slope = (d.adj[idx] + d.targetHeight) / cellDist;
+
+                        if ( slope >= maxSlope )
+                            vis[idx] = ViewshedGrid::VISIBLE;
+                        else if ( !sweep || !d.touched[idx] )
+                            vis[idx] = ViewshedGrid::HIDDEN;
+
+                        d.touched[idx] = 1;
+                    }
+                }
+
+                // terrain along the ray, interpolated across the minor axis:
+                double h;
+                if ( xMajor )
+                {
+                    int    r0 = (int)floor(fy);
+                    int    r1 = osg::minimum( r0+1, (int)d.size-1 );
+                    double t  = fy - (double)r0;
+                    int    cc = (int)floor(fx + 0.5);
+                    h = d.adjAt(cc, r0)*(1.0-t) + d.adjAt(cc, r1)*t;
+                }
+                else
+                {
+                    int    c0 = (int)floor(fx);
+                    int    c1 = osg::minimum( c0+1, (int)d.size-1 );
+                    double t  = fx - (double)c0;
+                    int    rr = (int)floor(fy + 0.5);
+                    h = d.adjAt(c0, rr)*(1.0-t) + d.adjAt(c1, rr)*t;
+                }
+
+                double slope = h / (sqrt(dist2) * d.cellSize);
+                if ( slope > maxSlope )
+                    maxSlope = slope;
+            }
+        }
+
+        SweepData* _data;
+        unsigned   _sector;
+    };
+}
+
+//------------------------------------------------------------------------
+
+GeoPoint
+ViewshedGrid::getCellLocation( unsigned col, unsigned row ) const
+{
+    double half = (double)(_size/2);
+    osg::Vec3d p = localToMap(
+        _observer,
+        ((double)col - half) * _cellSize,
+        ((double)row - half) * _cellSize );
+
+    p.z() = getHeight(col, row);
+    return GeoPoint( _observer.getSRS(), p, ALTMODE_ABSOLUTE );
+}
+
+unsigned
+ViewshedGrid::getNumVisible() const
+{
+    unsigned count = 0;
+    for( std::vector<unsigned char>::const_iterator i = _visibility.begin(); i != _visibility.end(); ++i )
+        if ( *i == VISIBLE )
+            ++count;
+    return count;
+}
+
+osg::Image*
+ViewshedGrid::createImage( const osg::Vec4f& visibleColor, const osg::Vec4f& hiddenColor ) const
+{
+    osg::Image* image = new osg::Image();
+    image->allocateImage( _size, _size, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+
+    unsigned char good[4], bad[4];
+    for( unsigned k=0; k<4; ++k )
+    {
+        good[k] = (unsigned char)( osg::clampBetween(visibleColor[k], 0.0f, 1.0f) * 255.0f );
+        bad[k]  = (unsigned char)( osg::clampBetween(hiddenColor[k],  0.0f, 1.0f) * 255.0f );
+    }
+
+    for( unsigned row = 0; row < _size; ++row )
+    {
+        unsigned char* ptr = image->data(0, row);
+        for( unsigned col = 0; col < _size; ++col, ptr += 4 )
+        {
+            unsigned char v = _visibility[row*_size + col];
+            if ( v == VISIBLE )
+                memcpy( ptr, good, 4 );
+            else if ( v == HIDDEN )
+                memcpy( ptr, bad, 4 );
+            else
+                memset( ptr, 0, 4 );
+        }
+    }
+
+    return image;
+}
+
+//------------------------------------------------------------------------
+
+Viewshed::Viewshed( const Map* map ) :
+_map           ( map ),
+_observerHeight( 2.0 ),
+_targetHeight  ( 0.0 ),
+_curvature     ( true ),
+_numThreads    ( 0u )
+{
+    //nop
+}
+
+TaskService*
+Viewshed::getTaskService( unsigned numThreads )
+{
+    Threading::ScopedMutexLock lock( _serviceMutex );
+    osg::ref_ptr<TaskService>& service = _services[numThreads];
+    if ( !service.valid() )
+        service = new TaskService( "Viewshed", numThreads );
+    return service.get();
+}
+
+ViewshedGrid*
+Viewshed::compute(const GeoPoint&    center,
+                  double             radius,
+                  unsigned           numCells,
+                  ProgressCallback*  progress )
+{
+    if ( !_map.valid() || !center.isValid() || radius <= 0.0 )
+        return 0L;
+
+    const SpatialReference* mapSRS = _map->getProfile()->getSRS();
+    GeoPoint mapCenter = center.transform( mapSRS );
+    if ( !mapCenter.isValid() )
+        return 0L;
+
+    osg::Timer_t startTime = osg::Timer::instance()->tick();
+
+    unsigned size = osg::maximum( numCells | 1u, 3u );
+    int      c    = (int)(size/2);
+    double   cellSize = 2.0*radius / (double)size;
+
+    // sample the elevation data onto the local grid.
+    std::vector<osg::Vec3d> points;
+    points.reserve( size*size );
+    for( unsigned row = 0; row < size; ++row )
+    {
+        for( unsigned col = 0; col < size; ++col )
+        {
+            points.push_back( localToMap(mapCenter, ((int)col-c)*cellSize, ((int)row-c)*cellSize) );
+        }
+    }
+
+    double resolution = mapSRS->isGeographic() ?
+        osg::RadiansToDegrees( cellSize / mapSRS->getEllipsoid()->getRadiusEquator() ) :
+        cellSize;
+
+    std::vector<double> heights;
+    heights.reserve( points.size() );
+    ElevationQuery query( _map.get() );
+    query.getElevations( points, mapSRS, heights, resolution );
+
+    if ( heights.size() != points.size() || (progress && progress->isCanceled()) )
+        return 0L;
+
+    osg::ref_ptr<ViewshedGrid> grid = new ViewshedGrid();
+    grid->_size     = size;
+    grid->_cellSize = cellSize;
+    grid->_heights.assign( heights.begin(), heights.end() );
+    grid->_visibility.assign( size*size, (unsigned char)ViewshedGrid::OUT_OF_RANGE );
+
+    double observerZ = heights[c*size + c] + _observerHeight;
+    grid->_observer = GeoPoint( mapSRS, mapCenter.x(), mapCenter.y(), heights[c*size + c], ALTMODE_ABSOLUTE );
+
+    // set up the sweep.
+    SweepData data;
+    data.size         = size;
+    data.c            = c;
+    data.cellSize     = cellSize;
+    data.maxDist2     = (double)c * (double)c;
+    data.targetHeight = _targetHeight;
+    data.visibility   = &grid->_visibility;
+    data.progress     = progress;
+    data.adj.resize( size*size );
+    data.owner.resize( size*size, 0 );
+    data.touched.resize( size*size, 0 );
+    data.owned.resize( NUM_SECTORS );
+
+    double earthRadius = mapSRS->getEllipsoid()->getRadiusEquator();
+    double sectorWidth = TWO_PI / (double)NUM_SECTORS;
+
+    for( unsigned row = 0; row < size; ++row )
+    {
+        for( unsigned col = 0; col < size; ++col )
+        {
+            unsigned idx = row*size + col;
+            double   gx = (int)col - c, gy = (int)row - c;
+            double   dist2 = gx*gx + gy*gy;
+            double   distM = sqrt(dist2) * cellSize;
+
+            data.adj[idx] = heights[idx] - observerZ;
+            if ( _curvature )
+                data.adj[idx] -= (distM*distM) / (2.0*earthRadius);
+
+            if ( dist2 <= data.maxDist2 && idx != (unsigned)(c*size + c) )
+            {
+                double angle = atan2( gy, gx );
+                if ( angle < 0.0 ) angle += TWO_PI;
+                unsigned sector = osg::minimum( (unsigned)(angle / sectorWidth), NUM_SECTORS-1 );
+                data.owner[idx] = (unsigned char)sector;
+                data.owned[sector].push_back( idx );
+                grid->_visibility[idx] = ViewshedGrid::HIDDEN;
+            }
+
+            if ( row == 0 || col == 0 || row == size-1 || col == size-1 )
+            {
+                double angle = atan2( gy, gx );
+                if ( angle < 0.0 ) angle += TWO_PI;
+                data.perimeter.push_back( idx );
+                data.perimeterAngle.push_back( angle );
+            }
+        }
+    }
+
+    // the observer can see its own cell.
+    grid->_visibility[c*size + c] = ViewshedGrid::VISIBLE;
+
+    // run the sectors in parallel.
+    unsigned numThreads = _numThreads > 0 ? _numThreads : (unsigned)osg::maximum( 1, OpenThreads::GetNumberOfProcessors() );
+    if ( numThreads == 1 )
+    {
+        for( unsigned s = 0; s < NUM_SECTORS && !data.isCanceled(); ++s )
+        {
+            SweepSector sector;
+            sector.init( &data, s );
+            sector.execute();
+        }
+    }
+    else
+    {
+        osg::ref_ptr<TaskService> service = getTaskService( numThreads );
+        std::vector< osg::ref_ptr< ParallelTask<SweepSector> > > tasks( NUM_SECTORS );
+        Threading::MultiEvent semaphore( NUM_SECTORS );
+
+        for( unsigned s = 0; s < NUM_SECTORS; ++s )
+        {
+            tasks[s] = new ParallelTask<SweepSector>( &semaphore );
+            tasks[s]->init( &data, s );
+            service->add( tasks[s].get() );
+        }
+
+        semaphore.wait();
+    }
+
+    if ( progress && progress->isCanceled() )
+        return 0L;
+
+    OE_DEBUG << LC << "Computed " << size << "x" << size << " viewshed in "
+        << osg::Timer::instance()->delta_s(startTime, osg::Timer::instance()->tick()) << "s; "
+        << grid->getNumVisible() << " cells visible" << std::endl;
+
+    return grid.release();
+}